@@ -0,0 +1,193 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "analysis.h"
+#include "cache.h"
+#include "debug.h"
+
+static int cancelled(struct analysis *a){
+    if (!atomic_load_explicit(&a->cancel, memory_order_relaxed))
+        return 0;
+
+    DEBUG_PRINTF("analysis cancelled\n");
+    return 1;
+}
+
+/*
+ * Each chunk is summarized and then measured while it is still in cache;
+ * the mapping has everything before it, so the loudness filters always
+ * get their full pre-roll.
+ */
+static int summarize_mapped(struct analysis *a, struct loudness *l){
+    struct waveform *wf = a->waveform;
+    struct audio_track *t = a->track;
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(t->spec);
+    const Uint64 chunk = (Uint64)ANALYSIS_CHUNK_BLOCKS * WAVEFORM_BLOCK_FRAMES;
+
+    for (Uint64 b = 0; b < wf->count[0]; b += ANALYSIS_CHUNK_BLOCKS) {
+        if (cancelled(a))
+            return -1;
+        const Uint64 first = b * WAVEFORM_BLOCK_FRAMES;
+        waveform_summarize(wf, t->buf + first * frame_size, &t->spec, b, b + ANALYSIS_CHUNK_BLOCKS);
+        if (l)
+            loudness_scan(l, t->buf + first * frame_size, first, chunk, first);
+    }
+
+    // the scan faulted in the whole file; dropping it here would drop what
+    // the callback is about to read too, so the played pages are left to
+    // the windowed advice that follows playback (audio_advise_playback)
+    return 0;
+}
+
+/*
+ * A decoder of its own, independent of the one playback drains, feeds
+ * the summary ANALYSIS_DECODE_BLOCKS at a time. Frames the file promised
+ * but the decoder did not deliver are summarized as silence. The tail of
+ * every chunk stays at the front of the buffer as the loudness pre-roll
+ * of the next.
+ */
+static int summarize_decoded(struct analysis *a, struct loudness *l){
+    struct waveform *wf = a->waveform;
+    const SDL_AudioSpec *spec = &a->track->spec;
+    const Uint64 chunk = (Uint64)ANALYSIS_DECODE_BLOCKS * WAVEFORM_BLOCK_FRAMES;
+    const Uint64 preroll = l ? SDL_min(l->preroll, chunk) : 0;
+
+    struct decoder dec;
+    if (decoder_open(&dec, a->path) < 0) {
+        fprintf(stderr, "decoder_open failed: %s\n", SDL_GetError());
+        return -1;
+    }
+    float *buf = malloc((preroll + chunk) * spec->channels * sizeof *buf);
+    if (!buf) {
+        decoder_close(&dec);
+        return -1;
+    }
+    float *pcm = buf + preroll * spec->channels;
+
+    int rc = 0;
+    for (Uint64 b = 0; b < wf->count[0]; b += ANALYSIS_DECODE_BLOCKS) {
+        if (cancelled(a)) {
+            rc = -1;
+            break;
+        }
+
+        Uint64 got = 0;
+        while (got < chunk) {
+            const Uint64 n = decoder_read(&dec, pcm + got * spec->channels, chunk - got);
+            if (n == 0)
+                break;
+            got += n;
+        }
+        SDL_memset(pcm + got * spec->channels, 0, (chunk - got) * spec->channels * sizeof *pcm);
+
+        waveform_summarize(wf, (const Uint8 *)pcm, spec, b, b + ANALYSIS_DECODE_BLOCKS);
+        if (l) {
+            const Uint64 first = b * WAVEFORM_BLOCK_FRAMES;
+            loudness_scan(l, (const Uint8 *)pcm, first, chunk, first ? preroll : 0);
+            SDL_memcpy(buf, pcm + (chunk - preroll) * spec->channels,
+                       preroll * spec->channels * sizeof *buf);
+        }
+    }
+
+    free(buf);
+    decoder_close(&dec);
+    return rc;
+}
+
+// the summary and the loudness of the track, on the calling thread
+static int measure(struct analysis *a){
+    struct waveform *wf = a->waveform;
+    struct audio_track *t = a->track;
+
+    // without the loudness the waveform is still worth having
+    struct loudness loudness;
+    struct loudness *l = &loudness;
+    if (loudness_init(l, wf->frames, &t->spec) < 0) {
+        fprintf(stderr, "loudness_init failed: %s\n", SDL_GetError());
+        l = NULL;
+    }
+
+    const int rc = t->decoded ? summarize_decoded(a, l) : summarize_mapped(a, l);
+    if (rc < 0) {
+        if (l)
+            loudness_free(l);
+        return -1;
+    }
+
+    wf->loudness = (struct loudness_result){ -INFINITY, 0.0f, -INFINITY };
+    if (l) {
+        if (loudness_finish(l, &wf->loudness) < 0)
+            fprintf(stderr, "loudness_finish failed: %s\n", SDL_GetError());
+        loudness_free(l);
+    }
+    audio_track_set_loudness(t, &wf->loudness);
+    return 0;
+}
+
+static void *analysis_main(void *arg){
+    struct analysis *a = arg;
+
+    if (measure(a) < 0) {
+        atomic_store(&a->state, ANALYSIS_FAILED);
+        return NULL;
+    }
+
+    if (waveform_cache_store(a->waveform, a->path, a->track) < 0)
+        fprintf(stderr, "waveform_cache_store failed: %s\n", SDL_GetError());
+
+    atomic_store(&a->state, ANALYSIS_DONE);
+    return NULL;
+}
+
+int analysis_start(struct analysis *a, struct waveform *wf, const char *path, struct audio_track *track){
+    a->waveform = wf;
+    a->track = track;
+    a->path = path;
+    a->joinable = 0;
+    atomic_init(&a->cancel, 0);
+    atomic_init(&a->state, ANALYSIS_RUNNING);
+
+    if (waveform_cache_load(wf, path, track) == 0) {
+        DEBUG_PRINTF("waveform loaded from cache\n");
+        audio_track_set_loudness(track, &wf->loudness);
+        atomic_store(&a->state, ANALYSIS_DONE);
+        return 0;
+    }
+
+    if (waveform_init(wf, track->len, &track->spec) < 0) {
+        atomic_store(&a->state, ANALYSIS_FAILED);
+        return -1;
+    }
+
+    if (pthread_create(&a->thread, NULL, analysis_main, a) != 0) {
+        SDL_SetError("cannot start analysis thread");
+        atomic_store(&a->state, ANALYSIS_FAILED);
+        return -1;
+    }
+    a->joinable = 1;
+    return 0;
+}
+
+void analysis_stop(struct analysis *a){
+    if (!a->joinable)
+        return;
+
+    atomic_store(&a->cancel, 1);
+    pthread_join(a->thread, NULL);
+    a->joinable = 0;
+}
+
+int analysis_run(struct waveform *wf, const char *path, struct audio_track *track){
+    if (waveform_init(wf, track->len, &track->spec) < 0)
+        return -1;
+
+    struct analysis a = { .waveform = wf, .track = track, .path = path };
+    atomic_init(&a.cancel, 0);
+    atomic_init(&a.state, ANALYSIS_RUNNING);
+    if (measure(&a) < 0) {
+        SDL_SetError("cannot analyze %s", path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "audio.h"
+#include "waveform.h"
+
+// level-0 blocks summarized between two publications of `ready`
+#define ANALYSIS_CHUNK_BLOCKS 4096
+
+// level-0 blocks decoded at a time for compressed tracks, ~1.5 s at 44.1 kHz
+#define ANALYSIS_DECODE_BLOCKS 256
+
+typedef enum {
+    ANALYSIS_IDLE = 0,
+    ANALYSIS_RUNNING,
+    ANALYSIS_DONE,
+    ANALYSIS_FAILED
+} analysis_state;
+
+/**
+ * analysis
+ *
+ * Background summary of one track. The worker fills `waveform` in chunks
+ * of ANALYSIS_CHUNK_BLOCKS and publishes each through waveform.ready, so
+ * the UI can draw the finished prefix while the rest is computed. A
+ * decoded track is read through a decoder of its own, ANALYSIS_DECODE_BLOCKS
+ * at a time, so it never holds more than that of PCM. The same chunks
+ * feed the loudness measurement, which ends up in waveform.loudness and,
+ * for normalization, in the track.
+ * - cancel: set by analysis_stop, checked by the worker between chunks
+ * - state:  analysis_state, written by whoever finishes the analysis
+ */
+struct analysis {
+    struct waveform *waveform;
+    struct audio_track *track;
+    const char *path;
+    pthread_t thread;
+    int joinable;
+    _Atomic int cancel;
+    _Atomic int state;
+};
+
+/**
+ * Summarize the track at `path` (already opened as `track`) into `wf`.
+ * A cache hit completes before returning; otherwise a worker thread is
+ * started and the call returns immediately.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int analysis_start(struct analysis *a, struct waveform *wf, const char *path, struct audio_track *track);
+
+/**
+ * Cancel a running analysis and wait for the worker to exit. The summary
+ * keeps whatever prefix was published. Safe to call more than once.
+ */
+void analysis_stop(struct analysis *a);
+
+/**
+ * What analysis_start's worker does, on the calling thread and without
+ * the cache: summarize `track` into `wf` (which is initialized here and
+ * needs waveform_free either way) and measure its loudness. The chunks
+ * still go through the thread pool, so this may run on a pool worker.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int analysis_run(struct waveform *wf, const char *path, struct audio_track *track);
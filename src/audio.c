@@ -0,0 +1,651 @@
+#include <stdlib.h>
+
+#include "audio.h"
+#include "sample.h"
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+/*
+ * One crossfade per sample format, instantiated from SAMPLE_FORMATS. The
+ * gain moves linearly over the fade, sampled at the middle of each frame.
+ */
+static inline __attribute__((always_inline))
+void crossfade_frames(Uint8 *out, const Uint8 *from, const Uint8 *to, int frames, int channels,
+                      float (*load)(const Uint8 *), void (*store)(Uint8 *, float), const int size){
+    const float step = 1.0f / (float)frames;
+
+    if (!from) {
+        for (int i = 0; i < frames; i++) {
+            const float g = ((float)i + 0.5f) * step;
+            for (int c = 0; c < channels; c++, out += size, to += size)
+                store(out, load(to) * g);
+        }
+        return;
+    }
+
+    for (int i = 0; i < frames; i++) {
+        const float g = ((float)i + 0.5f) * step;
+        for (int c = 0; c < channels; c++, out += size, from += size, to += size) {
+            const float a = load(from);
+            store(out, a + (load(to) - a) * g);
+        }
+    }
+}
+
+#define DEFINE_CROSSFADE(name, format)                                                   \
+    static void crossfade_##name(Uint8 *out, const Uint8 *from, const Uint8 *to,         \
+                                 int frames, int channels){                              \
+        crossfade_frames(out, from, to, frames, channels, load_##name, store_##name,     \
+                         SDL_AUDIO_BYTESIZE(format));                                    \
+    }
+
+SAMPLE_FORMATS(DEFINE_CROSSFADE)
+
+static audio_crossfade_fn pick_crossfade(SDL_AudioFormat format){
+#define PICK_CROSSFADE(name, fmt) \
+    if (format == fmt) return crossfade_##name;
+    SAMPLE_FORMATS(PICK_CROSSFADE)
+#undef PICK_CROSSFADE
+
+    return NULL;
+}
+
+// and one mono downmix per format for the spectrum tap
+static inline __attribute__((always_inline))
+void downmix_frames(const Uint8 *p, int frames, int channels, float *out,
+                    float (*load)(const Uint8 *), const int size){
+    const float scale = 1.0f / (float)channels;
+    for (int i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++, p += size)
+            sum += load(p);
+        out[i] = sum * scale;
+    }
+}
+
+#define DEFINE_DOWNMIX(name, format)                                                      \
+    static void downmix_##name(const Uint8 *p, int frames, int channels, float *out){    \
+        downmix_frames(p, frames, channels, out, load_##name, SDL_AUDIO_BYTESIZE(format)); \
+    }
+
+SAMPLE_FORMATS(DEFINE_DOWNMIX)
+
+static audio_downmix_fn pick_downmix(SDL_AudioFormat format){
+#define PICK_DOWNMIX(name, fmt) \
+    if (format == fmt) return downmix_##name;
+    SAMPLE_FORMATS(PICK_DOWNMIX)
+#undef PICK_DOWNMIX
+
+    return NULL;
+}
+
+// stream bytes (f32 when there is a resampler or a DSP chain) as bytes of the tracks' format
+static Uint64 stream_to_track_bytes(const struct audio_buffer *a, Uint64 bytes){
+    if (!a->resampler && !a->dsp)
+        return bytes;
+
+    const Uint64 out_frames = bytes / (sizeof(float) * (Uint64)a->spec.channels);
+    const Uint64 frames = a->resampler ? resampler_in_frames(a->resampler, out_frames) : out_frames;
+    return frames * SDL_AUDIO_FRAMESIZE(a->spec);
+}
+
+// the other way round: what `bytes` of the tracks' format come to in the stream
+static Uint64 track_to_stream_bytes(const struct audio_buffer *a, Uint64 bytes){
+    if (!a->resampler && !a->dsp)
+        return bytes;
+
+    const Uint64 frames = bytes / SDL_AUDIO_FRAMESIZE(a->spec);
+    const Uint64 out_frames = a->resampler ? resampler_out_frames(a->resampler, frames) : frames;
+    return out_frames * sizeof(float) * (Uint64)a->spec.channels;
+}
+
+static void put_resampled(struct audio_buffer *a, SDL_AudioStream *stream, const Uint8 *p, Uint64 bytes){
+    struct resampler *r = a->resampler;
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+
+    for (Uint64 frames = bytes / frame_size; frames > 0; ) {
+        const int n = (frames < RESAMPLE_CHUNK) ? (int)frames : RESAMPLE_CHUNK;
+        const int out = resampler_process(r, p, n);
+        if (a->dsp)
+            dsp_chain_process(a->dsp, r->out, out);
+        SDL_PutAudioStreamData(stream, r->out, out * r->channels * (int)sizeof(float));
+        p += n * frame_size;
+        frames -= n;
+    }
+}
+
+// through the DSP chain at the tracks' rate, a block of f32 at a time
+static void put_processed(struct audio_buffer *a, SDL_AudioStream *stream, const Uint8 *p, Uint64 bytes){
+    struct dsp_chain *c = a->dsp;
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+
+    for (Uint64 frames = bytes / frame_size; frames > 0; ) {
+        const int n = (frames < DSP_BLOCK_FRAMES) ? (int)frames : DSP_BLOCK_FRAMES;
+        const float *out = dsp_chain_run(c, p, n);
+        SDL_PutAudioStreamData(stream, out, n * c->channels * (int)sizeof(float));
+        p += n * frame_size;
+        frames -= n;
+    }
+}
+
+/**
+ * Put `bytes` at `p` into the stream, resampled and processed if need
+ * be, and their mono mix (as they were before processing) into the tap.
+ * The tap is a plain ring: the samples go in first, `written` is
+ * published after them.
+ */
+static void put(struct audio_buffer *a, SDL_AudioStream *stream, const Uint8 *p, Uint64 bytes){
+    if (a->resampler)
+        put_resampled(a, stream, p, bytes);
+    else if (a->dsp)
+        put_processed(a, stream, p, bytes);
+    else
+        SDL_PutAudioStreamData(stream, p, (int)bytes);
+    if (!a->tap || !a->downmix)
+        return;
+
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+    Uint64 frames = bytes / frame_size;
+    Uint64 at = atomic_load_explicit(&a->tap->written, memory_order_relaxed);
+
+    // only the newest frames fit
+    if (frames > SPECTRUM_TAP_FRAMES) {
+        const Uint64 skip = frames - SPECTRUM_TAP_FRAMES;
+        p += skip * frame_size;
+        at += skip;
+        frames = SPECTRUM_TAP_FRAMES;
+    }
+
+    while (frames > 0) {
+        const Uint64 slot = at & (SPECTRUM_TAP_FRAMES - 1);
+        const Uint64 n = (SPECTRUM_TAP_FRAMES - slot < frames) ? SPECTRUM_TAP_FRAMES - slot : frames;
+        a->downmix(p, (int)n, a->spec.channels, a->tap->ring + slot);
+        p += n * frame_size;
+        at += n;
+        frames -= n;
+    }
+    atomic_store_explicit(&a->tap->written, at, memory_order_release);
+}
+
+/*
+ * Where the callback reads a track: straight from the mapping, or from
+ * the decoder's ring when the track is decoded. Either way it gets bytes
+ * of the track's format at `pos`, as many as are there right now and
+ * contiguous (a ring hands out the rest after its wrap on the next peek).
+ */
+static Uint64 track_peek(struct audio_track *t, Uint64 pos, Uint64 want, const Uint8 **p){
+    Uint64 n;
+    if (t->decoded) {
+        const float *f;
+        n = decoder_stream_peek(t->decoded, &f) * SDL_AUDIO_FRAMESIZE(t->spec);
+        *p = (const Uint8 *)f;
+    } else {
+        n = t->len - pos;
+        *p = t->buf + pos;
+    }
+    return (n < want) ? n : want;
+}
+
+static void track_consume(struct audio_track *t, Uint64 bytes){
+    if (t->decoded)
+        decoder_stream_consume(t->decoded, bytes / SDL_AUDIO_FRAMESIZE(t->spec));
+}
+
+// nothing left to play at `pos`; a decoder may end short of the length its file stated
+static int track_done(struct audio_track *t, Uint64 pos){
+    return pos >= t->len || (t->decoded && decoder_stream_ended(t->decoded));
+}
+
+/**
+ * Put the first frames after a seek to `pos`: a crossfade from `from`,
+ * where playback was last heard, or a ramp from silence when that is
+ * unknown, runs past the end of the track or the track is decoded.
+ *
+ * @return bytes put, 0 when fading is off
+ */
+static Uint64 put_seek_fade(struct audio_buffer *a, SDL_AudioStream *stream,
+                            struct audio_track *t, Sint64 from, Uint64 pos){
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(t->spec);
+    const Uint8 *to;
+    const Uint64 frames = track_peek(t, pos, (Uint64)a->fade_frames * frame_size, &to) / frame_size;
+    if (frames == 0 || !a->crossfade)
+        return 0;
+
+    // a decoded track only has what is ahead: it fades in from silence
+    const Uint64 bytes = frames * frame_size;
+    const Uint8 *src = (t->buf && from != NO_SEEK && (Uint64)from + bytes <= t->len) ? t->buf + from : NULL;
+    a->crossfade(a->fade_buf, src, to, (int)frames, t->spec.channels);
+    put(a, stream, a->fade_buf, bytes);
+    track_consume(t, bytes);
+    return bytes;
+}
+
+// silence after the last track, so its tail makes it through the device's conversion
+static void put_silence(struct audio_buffer *a, SDL_AudioStream *stream, int bytes){
+    const int frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+    const int fill = (bytes < AUDIO_FADE_BYTES) ? bytes : AUDIO_FADE_BYTES - AUDIO_FADE_BYTES % frame_size;
+    SDL_memset(a->fade_buf, SDL_GetSilenceValueForFormat(a->spec.format), (size_t)fill);
+
+    while (bytes > 0) {
+        const int n = (bytes < fill) ? bytes : fill;
+        put(a, stream, a->fade_buf, (Uint64)n);
+        bytes -= n;
+    }
+}
+
+/**
+ * clock_sample
+ *
+ * What the callback last published under `seq`, read in one piece.
+ */
+struct clock_sample {
+    const struct audio_track *track;
+    Uint64 pos;
+    Sint64 frame;
+    Uint64 ns;
+    int paused;
+};
+
+static void read_clock(const struct audio_buffer *a, struct clock_sample *c){
+    Uint32 seq;
+    do {
+        seq = atomic_load_explicit(&a->seq, memory_order_acquire);
+        c->track = atomic_load_explicit(&a->playing, memory_order_acquire);
+        c->pos = atomic_load_explicit(&a->pos, memory_order_acquire);
+        c->frame = atomic_load_explicit(&a->clock_frame, memory_order_acquire);
+        c->ns = atomic_load_explicit(&a->clock_ns, memory_order_acquire);
+        c->paused = atomic_load_explicit(&a->clock_paused, memory_order_acquire);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&a->seq, memory_order_relaxed));
+}
+
+// frame heard at `now_ns`, between 0 and what the callback has put
+static Uint64 clock_at(const struct audio_buffer *a, const struct clock_sample *c, Uint64 now_ns){
+    Sint64 frame = c->frame;
+    if (!c->paused && now_ns > c->ns) {
+        // a stalled device cannot play more than was put anyway
+        Uint64 elapsed = now_ns - c->ns;
+        if (elapsed > SDL_NS_PER_SECOND)
+            elapsed = SDL_NS_PER_SECOND;
+        frame += (Sint64)(elapsed * (Uint64)a->spec.freq / SDL_NS_PER_SECOND);
+    }
+
+    const Sint64 put = (Sint64)(c->pos / SDL_AUDIO_FRAMESIZE(a->spec));
+    if (frame > put) frame = put;
+    return (frame > 0) ? (Uint64)frame : 0;
+}
+
+// publish the play position and the clock; only the callback, or the UI holding the stream lock
+static void publish(struct audio_buffer *a, struct audio_track *switched_to, Uint64 pos,
+                    Sint64 clock_frame, Uint64 clock_ns, int paused){
+    atomic_fetch_add_explicit(&a->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (switched_to)
+        atomic_store_explicit(&a->playing, switched_to, memory_order_relaxed);
+    atomic_store_explicit(&a->pos, pos, memory_order_relaxed);
+    atomic_store_explicit(&a->clock_frame, clock_frame, memory_order_relaxed);
+    atomic_store_explicit(&a->clock_ns, clock_ns, memory_order_relaxed);
+    atomic_store_explicit(&a->clock_paused, paused, memory_order_relaxed);
+    atomic_fetch_add_explicit(&a->seq, 1, memory_order_release);
+}
+
+// normalization gain of `t`, unity until its loudness is known
+static float track_gain(const struct audio_buffer *a, const struct audio_track *t){
+    if (!a->normalize || !atomic_load_explicit(&t->measured, memory_order_acquire))
+        return 1.0f;
+    return loudness_gain(&t->loudness, a->target_lufs);
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int audio_track_open(struct audio_track *t, const char *path){
+    atomic_init(&t->measured, 0);
+    if (decoder_handles(path)) {
+        t->decoded = malloc(sizeof *t->decoded);
+        if (!t->decoded) {
+            SDL_OutOfMemory();
+            return -1;
+        }
+        if (decoder_stream_open(t->decoded, path) < 0) {
+            free(t->decoded);
+            t->decoded = NULL;
+            return -1;
+        }
+
+        t->buf = NULL;
+        t->spec = t->decoded->dec.spec;
+        t->frames = t->decoded->dec.frames;
+        t->len = t->frames * SDL_AUDIO_FRAMESIZE(t->spec);
+        return 0;
+    }
+
+    if (wav_open(&t->wav, path) < 0)
+        return -1;
+
+    t->buf = t->wav.data;
+    t->len = t->wav.data_len;
+    t->spec = t->wav.spec;
+    t->frames = t->len / SDL_AUDIO_FRAMESIZE(t->spec);
+    t->decoded = NULL;
+    return 0;
+}
+
+void audio_track_close(struct audio_track *t){
+    if (t->decoded) {
+        decoder_stream_close(t->decoded);
+        free(t->decoded);
+        t->decoded = NULL;
+    }
+    wav_close(&t->wav);
+    t->buf = NULL;
+    t->len = 0;
+    t->frames = 0;
+}
+
+Uint64 audio_track_frame_at(const struct audio_track *t, float fraction){
+    if (!(fraction > 0.0f))
+        return 0;
+    if (fraction >= 1.0f)
+        return t->frames;
+
+    // fraction in 32.32 fixed point (exact for any float this far from 0),
+    // times the length split into halves so that nothing overflows
+    const Uint64 q = (Uint64)((double)fraction * 4294967296.0);
+    return (t->frames >> 32) * q + (((t->frames & 0xFFFFFFFFu) * q) >> 32);
+}
+
+void audio_track_set_loudness(struct audio_track *t, const struct loudness_result *r){
+    t->loudness = *r;
+    atomic_store_explicit(&t->measured, 1, memory_order_release);
+}
+
+void audio_buffer_init(struct audio_buffer *a, struct audio_track *first, struct metrics *metrics){
+    a->spec = first->spec;
+    a->track = first;
+    a->metrics = metrics;
+    atomic_init(&a->playing, first);
+    atomic_init(&a->next, NULL);
+    atomic_init(&a->seq, 0);
+    atomic_init(&a->pos, 0);
+    atomic_init(&a->clock_frame, 0);
+    atomic_init(&a->clock_ns, SDL_GetTicksNS());
+    atomic_init(&a->clock_paused, 0);
+    a->latency_frames = 0;
+    atomic_init(&a->seek_to, NO_SEEK);
+    atomic_init(&a->fade_from, NO_SEEK);
+    atomic_init(&a->seek_ns, 0);
+    atomic_init(&a->at_end, 0);
+    a->fade_frames = 0;
+    a->crossfade = pick_crossfade(first->spec.format);
+    a->tap = NULL;
+    a->downmix = pick_downmix(first->spec.format);
+    a->resampler = NULL;
+    a->dsp = NULL;
+    a->normalize = 0;
+    a->target_lufs = LOUDNESS_TARGET_LUFS;
+    a->fade_pending = 0;
+    a->fade_src = NO_SEEK;
+}
+
+void audio_set_output_latency(struct audio_buffer *a, Uint64 ns){
+    a->latency_frames = ns * (Uint64)a->spec.freq / SDL_NS_PER_SECOND;
+}
+
+void audio_set_tap(struct audio_buffer *a, struct spectrum_tap *tap){
+    a->tap = tap;
+}
+
+void audio_set_resampler(struct audio_buffer *a, struct resampler *r){
+    a->resampler = r;
+}
+
+void audio_set_dsp(struct audio_buffer *a, struct dsp_chain *c){
+    a->dsp = c;
+}
+
+void audio_set_normalize(struct audio_buffer *a, int on, float target_lufs){
+    a->normalize = on;
+    a->target_lufs = target_lufs;
+}
+
+void audio_set_seek_fade(struct audio_buffer *a, int ms){
+    const int frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+    if (ms <= 0 || frame_size <= 0) {
+        a->fade_frames = 0;
+        return;
+    }
+
+    Sint64 frames = (Sint64)a->spec.freq * ms / 1000;
+    if (frames > AUDIO_FADE_BYTES / frame_size)
+        frames = AUDIO_FADE_BYTES / frame_size;
+    a->fade_frames = (int)frames;
+}
+
+void audio_seek(struct audio_buffer *a, SDL_AudioStream *stream, Uint64 frame){
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(a->spec);
+    const Uint64 pos = frame * frame_size;
+
+    // the callback runs with the stream locked, so nothing moves in here
+    SDL_LockAudioStream(stream);
+
+    // a seek the callback has not taken yet was never heard: keep its fade source
+    if (atomic_load_explicit(&a->seek_to, memory_order_relaxed) == NO_SEEK) {
+        const Uint64 played = atomic_load_explicit(&a->pos, memory_order_relaxed);
+        const int queued = SDL_GetAudioStreamQueued(stream);
+        const Uint64 unheard = (queued >= 0) ? stream_to_track_bytes(a, (Uint64)queued) : 0;
+        Sint64 from = NO_SEEK;
+        if (queued >= 0 && played >= unheard) {
+            from = (Sint64)(played - unheard);
+            from -= from % (Sint64)frame_size;
+        }
+        atomic_store_explicit(&a->fade_from, from, memory_order_relaxed);
+    }
+
+    // a decoder can start on the new position before the callback takes it
+    if (a->track->decoded)
+        decoder_stream_seek(a->track->decoded, frame);
+
+    atomic_store_explicit(&a->seek_ns, SDL_GetTicksNS(), memory_order_relaxed);
+    atomic_store_explicit(&a->seek_to, (Sint64)pos, memory_order_release);
+    SDL_ClearAudioStream(stream);
+    // the filter history and the limiter's delay line belong to the queue just dropped
+    if (a->resampler)
+        resampler_reset(a->resampler);
+    if (a->dsp)
+        dsp_chain_reset(a->dsp);
+
+    SDL_UnlockAudioStream(stream);
+}
+
+int audio_queue_next(struct audio_buffer *a, struct audio_track *t){
+    if (t->spec.format != a->spec.format || t->spec.channels != a->spec.channels
+        || t->spec.freq != a->spec.freq) {
+        SDL_SetError("track %d needs a %d Hz, %d channel stream", t->index, t->spec.freq, t->spec.channels);
+        return -1;
+    }
+
+    atomic_store_explicit(&a->next, t, memory_order_release);
+    return 0;
+}
+
+const struct audio_track *audio_now_playing(const struct audio_buffer *a, Uint64 *frame){
+    struct clock_sample c;
+    read_clock(a, &c);
+
+    Uint64 p = c.pos;
+    Sint64 pending = atomic_load_explicit(&a->seek_to, memory_order_acquire);
+    if (pending != NO_SEEK)
+        p = (Uint64)pending;
+
+    if (frame) *frame = p / SDL_AUDIO_FRAMESIZE(c.track->spec);
+    return c.track;
+}
+
+const struct audio_track *audio_now_heard(const struct audio_buffer *a, Uint64 *frame){
+    struct clock_sample c;
+    read_clock(a, &c);
+
+    Uint64 f = clock_at(a, &c, SDL_GetTicksNS());
+    Sint64 pending = atomic_load_explicit(&a->seek_to, memory_order_acquire);
+    if (pending != NO_SEEK)
+        f = (Uint64)pending / SDL_AUDIO_FRAMESIZE(c.track->spec);
+
+    if (frame) *frame = f;
+    return c.track;
+}
+
+void audio_clock_pause(struct audio_buffer *a, SDL_AudioStream *stream, int paused){
+    // no callback runs while the stream is locked, so nothing else publishes
+    SDL_LockAudioStream(stream);
+
+    struct clock_sample c;
+    read_clock(a, &c);
+    const Uint64 now = SDL_GetTicksNS();
+    const Uint64 frame = clock_at(a, &c, now);
+    publish(a, NULL, c.pos, (Sint64)frame, now, paused);
+
+    SDL_UnlockAudioStream(stream);
+}
+
+void audio_advise_playback(struct audio_buffer *a){
+    Uint64 frame;
+    const struct audio_track *playing = audio_now_playing(a, &frame);
+
+    // skip the odd call that catches a gapless switch halfway
+    struct audio_track *t = atomic_load_explicit(&a->playing, memory_order_acquire);
+    if (t != playing || t->decoded)
+        return;
+    wav_advise_playback(&t->wav, frame * SDL_AUDIO_FRAMESIZE(t->spec));
+}
+
+Uint64 audio_position(const struct audio_buffer *a){
+    Uint64 frame;
+    audio_now_playing(a, &frame);
+    return frame;
+}
+
+audio_track_time calculate_audio_track_time(const struct audio_buffer *a){
+    audio_track_time t = {0, 0, 0, 0, 0};
+
+    Uint64 frame;
+    const struct audio_track *track = audio_now_heard(a, &frame);
+    if (track->spec.freq <= 0 || track->frames == 0)
+        return t;
+
+    // straight from the frame counts, exact at any length
+    if (frame > track->frames) frame = track->frames;
+    const Uint64 freq = (Uint64)track->spec.freq;
+    t.total_sec = (int)(track->frames / freq);
+    t.elapsed_sec = (int)(frame / freq);
+    t.remaining_sec = t.total_sec - t.elapsed_sec;
+    t.total_ms = track->frames / freq * 1000 + track->frames % freq * 1000 / freq;
+    t.elapsed_ms = frame / freq * 1000 + frame % freq * 1000 / freq;
+    return t;
+}
+
+void audio_callback(
+    void *userdata,
+    SDL_AudioStream *stream,
+    int additional_amount,
+    int total_amount
+){
+    struct audio_buffer *audio = userdata;
+    struct metrics *metrics = audio->metrics;
+
+    const Uint64 start_ns = SDL_GetTicksNS();
+    if (metrics->last_callback_ns)
+        metrics_record(&metrics->interval, start_ns - metrics->last_callback_ns);
+    metrics->last_callback_ns = start_ns;
+
+    struct audio_track *track = audio->track;
+    if (audio->dsp)
+        dsp_chain_set_gain(audio->dsp, track_gain(audio, track));
+    Sint64 seek = atomic_exchange_explicit(&audio->seek_to, NO_SEEK, memory_order_acquire);
+    Uint64 pos = (seek != NO_SEEK)
+        ? (Uint64)seek
+        : atomic_load_explicit(&audio->pos, memory_order_relaxed);
+    if (pos > track->len) pos = track->len;
+
+    // what SDL asked for, in the stream's bytes, before it becomes the tracks'
+    const int requested = (additional_amount > 0) ? additional_amount : 0;
+
+    // whole frames of the tracks' format, so every put ends on a frame boundary
+    const int frame_size = SDL_AUDIO_FRAMESIZE(audio->spec);
+    if (additional_amount > 0) {
+        const Uint64 wanted = stream_to_track_bytes(audio, (Uint64)additional_amount);
+        additional_amount = (int)((wanted + frame_size - 1) / frame_size * frame_size);
+    }
+
+    Uint64 supplied = 0;
+    int switched = 0;
+
+    if (seek != NO_SEEK) {
+        pos -= pos % frame_size;
+        if (track->decoded)
+            decoder_stream_seek(track->decoded, pos / frame_size);
+        audio->fade_src = atomic_exchange_explicit(&audio->fade_from, NO_SEEK, memory_order_relaxed);
+        audio->fade_pending = 1;
+    }
+
+    // the seek lands once there is audio at the new position
+    const Uint8 *p;
+    if (audio->fade_pending && (track_peek(track, pos, 1, &p) > 0 || track_done(track, pos))) {
+        const Uint64 n = put_seek_fade(audio, stream, track, audio->fade_src, pos);
+        pos += n;
+        supplied += n;
+        additional_amount -= (int)n;
+        audio->fade_pending = 0;
+        metrics_record(&metrics->seek,
+                       SDL_GetTicksNS() - atomic_load_explicit(&audio->seek_ns, memory_order_relaxed));
+    }
+    while (additional_amount > 0 && !audio->fade_pending){
+        if (track_done(track, pos)) {
+            // gapless: carry on with the next track inside the same callback
+            struct audio_track *next = atomic_exchange_explicit(&audio->next, NULL, memory_order_acquire);
+            if (!next)
+                break;
+            track = next;
+            pos = 0;
+            switched = 1;
+            if (audio->dsp)
+                dsp_chain_set_gain(audio->dsp, track_gain(audio, track));
+            continue;
+        }
+
+        // one put for as much of the request as this track has ready
+        const Uint64 n = track_peek(track, pos, (Uint64)additional_amount, &p);
+        if (n == 0)
+            break;
+        put(audio, stream, p, n);
+        track_consume(track, n);
+        pos += n;
+        supplied += n;
+        additional_amount -= (int)n;
+    }
+    const int done = track_done(track, pos);
+    atomic_store_explicit(&audio->at_end, additional_amount > 0 && done, memory_order_relaxed);
+    // short while the track still had data: it was not there in time
+    if (additional_amount > 0 && !done && !audio->fade_pending)
+        metrics_add(&metrics->underruns, 1);
+    if (additional_amount > 0)
+        put_silence(audio, stream, additional_amount);
+
+    if (switched)
+        audio->track = track;
+
+    // heard now: what was put, less what the stream and the output still hold
+    const int queued = SDL_GetAudioStreamQueued(stream);
+    const Uint64 unheard = (queued > 0) ? stream_to_track_bytes(audio, (Uint64)queued) / frame_size : 0;
+    const Sint64 heard = (Sint64)(pos / frame_size) - (Sint64)unheard - (Sint64)audio->latency_frames;
+    publish(audio, switched ? track : NULL, pos, heard, SDL_GetTicksNS(),
+            atomic_load_explicit(&audio->clock_paused, memory_order_relaxed));
+
+    metrics_add(&metrics->callbacks, 1);
+    metrics_add(&metrics->bytes_requested, requested);
+    metrics_add(&metrics->bytes_supplied, track_to_stream_bytes(audio, supplied));
+    metrics_record(&metrics->callback, SDL_GetTicksNS() - start_ns);
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+#include "decoder.h"
+#include "dsp.h"
+#include "loudness.h"
+#include "metrics.h"
+#include "resample.h"
+#include "spectrum.h"
+#include "wav.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define NO_SEEK (-1)
+
+// room for the crossfade after a seek, ~40 ms of 48 kHz stereo f32
+#define AUDIO_FADE_BYTES 16384
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * audio_track
+ *
+ * One mapped or decoded file, immutable while it can be played except
+ * for its loudness, which the analysis may find while it plays:
+ * - index:          position in the playlist
+ * - buf, len, spec: PCM data; buf aliases the data chunk of the mapped
+ *                   file, nothing is copied
+ * - frames:         length in frames, what positions outside the
+ *                   callback are counted in
+ * - decoded:        for compressed files, the decoder streaming them
+ *                   (buf is NULL then; len is what the file states)
+ * - loudness:       the analysis' measurement, valid once `measured` is
+ *                   set (release, see audio_track_set_loudness)
+ */
+struct audio_track {
+    int index;
+    const Uint8 *buf;
+    Uint64 len;
+    Uint64 frames;
+    SDL_AudioSpec spec;
+    struct wav_file wav;
+    struct decoder_stream *decoded;
+    struct loudness_result loudness;
+    _Atomic int measured;
+};
+
+// mix `frames` frames from `from` into `to` (or fade `to` in from silence when `from` is NULL)
+typedef void (*audio_crossfade_fn)(Uint8 *out, const Uint8 *from, const Uint8 *to,
+                                   int frames, int channels);
+
+// mono mix of `frames` interleaved frames at `p`, one float per frame in `out`
+typedef void (*audio_downmix_fn)(const Uint8 *p, int frames, int channels, float *out);
+
+/**
+ * audio_buffer
+ *
+ * Shared between the UI thread (producer of seeks and of the next track)
+ * and audio_callback (consumer) without locks:
+ * - spec:      format of the stream; every track played must match it
+ * - track:     playing track, only touched by audio_callback
+ * - playing:   `track` published for the UI, together with `pos` and the
+ *              clock under `seq` (odd while the callback publishes them)
+ * - next:      track to continue with at the end of `track`, or NULL; the
+ *              UI stores it, the callback takes it with an exchange
+ * - pos:       play position in bytes within `playing`: what the callback
+ *              has put so far, ahead of what is heard
+ * - clock_frame, clock_ns: frame of `playing` that was being heard at
+ *              clock_ns, i.e. `pos` less what the stream and the output
+ *              still held when the callback returned (negative right after
+ *              a gapless switch, while the old track's end is still heard)
+ * - clock_paused: the clock stands still at clock_frame (audio_clock_pause)
+ * - latency_frames: what the output holds past the stream (device buffer,
+ *              DSP look-ahead) in frames of the tracks' format
+ * - seek_to:   pending seek in bytes or NO_SEEK; the UI stores it, the
+ *              callback takes it with an exchange, latest request wins
+ * - fade_from: where playback was last heard when the seek was made, the
+ *              start of the crossfade; NO_SEEK ramps up from silence
+ * - seek_ns:   when the pending seek was requested, for the seek metric
+ * - fade_frames, crossfade, fade_buf: length, kernel and scratch of the
+ *              crossfade (fade_buf also holds the end-of-stream silence),
+ *              only touched by audio_callback once playing
+ * - tap, downmix: where the callback copies the mono mix of everything it
+ *              puts (NULL for none), and the kernel doing the mixing
+ * - resampler: converts what the callback puts to the stream's rate, or
+ *              NULL when the stream takes the tracks' own format
+ * - dsp:       processes what the callback puts, after the resampler, or
+ *              NULL for none
+ * - normalize, target_lufs: have `dsp` scale every measured track to
+ *              `target_lufs`; the callback hands it the playing track's gain
+ * - fade_pending, fade_src: a seek the callback took whose crossfade is
+ *              not put yet, because a decoded track had nothing at the new
+ *              position, and where that crossfade starts
+ * - at_end:    the last callback ran out of data with no next track
+ * - metrics:   where the callback records its timing and byte counts
+ *
+ * Positions and lengths in here are always in bytes of the tracks' format;
+ * only the stream's side of the callback (its request, what is queued) is
+ * in f32 frames when there is a resampler or a DSP chain. The API takes
+ * and returns 64-bit frame positions.
+ */
+struct audio_buffer{
+    SDL_AudioSpec spec;
+    struct audio_track *track;
+    _Atomic(struct audio_track *) playing;
+    _Atomic(struct audio_track *) next;
+    _Atomic Uint32 seq;
+    _Atomic Uint64 pos;
+    _Atomic Sint64 clock_frame;
+    _Atomic Uint64 clock_ns;
+    _Atomic int clock_paused;
+    Uint64 latency_frames;
+    _Atomic Sint64 seek_to;
+    _Atomic Sint64 fade_from;
+    _Atomic Uint64 seek_ns;
+    _Atomic int at_end;
+    struct metrics *metrics;
+    int fade_frames;
+    audio_crossfade_fn crossfade;
+    Uint8 fade_buf[AUDIO_FADE_BYTES];
+    struct spectrum_tap *tap;
+    audio_downmix_fn downmix;
+    struct resampler *resampler;
+    struct dsp_chain *dsp;
+    int normalize;
+    float target_lufs;
+    int fade_pending;
+    Sint64 fade_src;
+};
+
+/**
+ * audio_track_time
+ *
+ * Snapshot of playback timing, at what is being heard:
+ * - elapsed_sec:   seconds played since the start (0..total_sec)
+ * - remaining_sec: seconds left until the end (0..total_sec), typically for countdown UI
+ * - total_sec:     total duration in seconds
+ * - elapsed_ms, total_ms: the same in milliseconds, for smooth cursors
+ */
+typedef struct audio_track_time {
+    int elapsed_sec;
+    int remaining_sec;
+    int total_sec;
+    Uint64 elapsed_ms;
+    Uint64 total_ms;
+} audio_track_time;
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Map and parse the WAV file at `path`, or start decoding it when it is
+ * in a compressed format (see decoder_handles).
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int audio_track_open(struct audio_track *t, const char *path);
+
+void audio_track_close(struct audio_track *t);
+
+/**
+ * Frame at `fraction` (0..1, clamped) of `t`, rounded down, computed in
+ * integers so that it is exact for tracks of any length.
+ */
+Uint64 audio_track_frame_at(const struct audio_track *t, float fraction);
+
+/**
+ * Publish what the analysis measured of `t`; from the next callback on
+ * it is played at its normalization gain. Call once per open track.
+ */
+void audio_track_set_loudness(struct audio_track *t, const struct loudness_result *r);
+
+/**
+ * Get `a` ready to play `first` from the start, in its format. Only call
+ * while no stream is pulling from `a`. `metrics` must outlive the buffer.
+ */
+void audio_buffer_init(struct audio_buffer *a, struct audio_track *first, struct metrics *metrics);
+
+/**
+ * Crossfade the first `ms` milliseconds after a seek (0 for a hard cut),
+ * clamped to what fits AUDIO_FADE_BYTES. Same rules as audio_buffer_init.
+ */
+void audio_set_seek_fade(struct audio_buffer *a, int ms);
+
+// copy what is played to `tap` (NULL to stop); same rules as audio_buffer_init
+void audio_set_tap(struct audio_buffer *a, struct spectrum_tap *tap);
+
+/**
+ * Resample everything with `r` (NULL for none) before it goes into the
+ * stream, which must then take f32 at r->out_rate. Same rules as
+ * audio_buffer_init; `r` must outlive the stream.
+ */
+void audio_set_resampler(struct audio_buffer *a, struct resampler *r);
+
+/**
+ * Run everything through `c` (NULL for none) on its way into the stream,
+ * which must then take f32 at the rate `c` was set up for. Same rules as
+ * audio_set_resampler.
+ */
+void audio_set_dsp(struct audio_buffer *a, struct dsp_chain *c);
+
+/**
+ * Bring every track to `target_lufs` once its loudness is measured, or
+ * leave all at unity when `on` is 0. The gain is applied by the DSP chain,
+ * so without one this has no effect. Same rules as audio_buffer_init.
+ */
+void audio_set_normalize(struct audio_buffer *a, int on, float target_lufs);
+
+/**
+ * Everything put into the stream takes `ns` more to be heard once it
+ * leaves the stream (the device buffer, a DSP chain's look-ahead); the
+ * playback clock holds it back by that much. Same rules as
+ * audio_buffer_init.
+ */
+void audio_set_output_latency(struct audio_buffer *a, Uint64 ns);
+
+/**
+ * Stop the playback clock where it is (`paused` 1) or let it run again
+ * from there (0), as the device of `stream` is paused or resumed. Call
+ * it before resuming and after pausing, so no callback runs in between.
+ */
+void audio_clock_pause(struct audio_buffer *a, SDL_AudioStream *stream, int paused);
+
+/**
+ * Jump to frame `frame` of the playing track.
+ * Drops what `stream` still has queued so the jump is heard right away,
+ * and lets the callback crossfade from the last audible position. Waits
+ * at most for one callback to finish, the stream's lock is held meanwhile.
+ */
+void audio_seek(struct audio_buffer *a, SDL_AudioStream *stream, Uint64 frame);
+
+/**
+ * Queue `t` to follow the playing track without a gap. Replaces a track
+ * queued before that the callback has not started yet.
+ *
+ * @return 0 on success, -1 if `t` is not in the stream's format
+ */
+int audio_queue_next(struct audio_buffer *a, struct audio_track *t);
+
+/**
+ * Track the UI should show and the frame in it: a seek that the
+ * callback has not picked up yet (e.g. while paused) wins over the last
+ * published play position.
+ */
+const struct audio_track *audio_now_playing(const struct audio_buffer *a, Uint64 *frame);
+
+/**
+ * Track being heard and the frame of it reaching the listener right now:
+ * the clock the last callback left, advanced by the high-resolution timer
+ * since, but never past what has been put. A pending seek wins, as for
+ * audio_now_playing.
+ */
+const struct audio_track *audio_now_heard(const struct audio_buffer *a, Uint64 *frame);
+
+/**
+ * Pass the published play position on to wav_advise_playback, so pages
+ * ahead are prefetched and those played are dropped. madvise() is a
+ * syscall and may block, so this is for the UI thread, never the
+ * callback; once per frame is plenty.
+ */
+void audio_advise_playback(struct audio_buffer *a);
+
+Uint64 audio_position(const struct audio_buffer *a);
+
+audio_track_time calculate_audio_track_time(const struct audio_buffer *a);
+
+/**
+ * SDL_AudioStreamCallback feeding the stream from a struct audio_buffer
+ * passed as `userdata`: puts exactly the request (rounded up to a frame),
+ * moving on to the queued next track in the same callback when the
+ * playing one ends and padding with silence after the last one, or for
+ * as long as a decoder falls behind. Runs on SDL's audio thread: never
+ * waits on the UI or a decoder.
+ */
+void audio_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
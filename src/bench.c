@@ -0,0 +1,1208 @@
+/**
+ * Headless benchmark of the load / analysis / playback path.
+ *
+ * Generates synthetic WAVs (mono and stereo, s16 and f32, 1 minute up to
+ * 3 hours), times every stage `--reps` times on each and prints one JSON
+ * document with mean, stddev, min and max per stage. Runs on SDL's dummy
+ * drivers, so it needs neither a display nor a sound card:
+ *
+ *   make bench
+ *   build/bench --reps=10 --max-minutes=10 --out=bench.json
+ *
+ * Scratch files go to $TMPDIR (default /tmp) and are removed after their
+ * case; the 3 hour f32 stereo case needs about 4 GiB there.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <SDL3/SDL.h>
+
+#include "audio.h"
+#include "decoder.h"
+#include "dsp.h"
+#include "fft.h"
+#include "kernels.h"
+#include "loudness.h"
+#include "metrics.h"
+#include "mixer.h"
+#include "pool.h"
+#include "resample.h"
+#include "spectrum.h"
+#include "waveform.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define BENCH_RATE 44100
+#define BENCH_DEFAULT_REPS 5
+// bars the player draws in a default window, as windows for calculate_rms
+#define BENCH_BARS 266
+// what SDL asks a callback for at ~1024 frames per device buffer
+#define BENCH_PULL_FRAMES 1024
+#define BENCH_TRACK_TIME_CALLS 1000000
+// spectrum analyses timed per rep, one callback pull apart
+#define BENCH_SPECTRUM_UPDATES 100
+// the resampler stages convert the start of each track to BENCH_DEVICE_RATE
+#define BENCH_RESAMPLE_SECONDS 30
+#define BENCH_DEVICE_RATE 48000
+// mixer stress: callbacks timed per voice count, and the most voices tried
+#define BENCH_MIXER_CALLBACKS 16
+#define BENCH_MIXER_MAX_VOICES 65536
+// files given with --decode
+#define BENCH_MAX_DECODE 16
+// samples the kernel checks run on: enough one-sample windows for several pool jobs
+#define BENCH_CHECK_SAMPLES (1 << 18)
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+struct bench_case {
+    const char *format_name;
+    SDL_AudioFormat format;
+    int channels;
+    int minutes;
+};
+
+/**
+ * bench_stats
+ *
+ * Summary of `reps` timings of one stage, in nanoseconds per `unit`.
+ */
+struct bench_stats {
+    double mean;
+    double stddev;
+    double min;
+    double max;
+};
+
+// =============================================================================
+// Globals
+// =============================================================================
+
+static const struct { const char *name; SDL_AudioFormat format; int channels; } layouts[] = {
+    { "s16", SDL_AUDIO_S16LE, 1 },
+    { "s16", SDL_AUDIO_S16LE, 2 },
+    { "f32", SDL_AUDIO_F32LE, 1 },
+    { "f32", SDL_AUDIO_F32LE, 2 },
+};
+
+static const int durations_min[] = { 1, 10, 60, 180 };
+
+static int reps = BENCH_DEFAULT_REPS;
+static int max_minutes = 180;
+static FILE *out = NULL;
+static int results = 0;
+
+// keeps the optimizer from dropping timed calls whose result is unused
+static volatile Uint64 sink;
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static Uint64 now_ns(void){
+    static double scale = 0.0;
+    if (scale == 0.0)
+        scale = 1e9 / (double)SDL_GetPerformanceFrequency();
+    return (Uint64)((double)SDL_GetPerformanceCounter() * scale);
+}
+
+static struct bench_stats stats_of(const double *v, int n){
+    struct bench_stats s = { 0.0, 0.0, v[0], v[0] };
+    for (int i = 0; i < n; i++) {
+        s.mean += v[i];
+        if (v[i] < s.min) s.min = v[i];
+        if (v[i] > s.max) s.max = v[i];
+    }
+    s.mean /= n;
+
+    for (int i = 0; i < n; i++)
+        s.stddev += (v[i] - s.mean) * (v[i] - s.mean);
+    s.stddev = (n > 1) ? sqrt(s.stddev / (n - 1)) : 0.0;
+    return s;
+}
+
+static void put16(Uint8 *p, Uint16 v){ p[0] = v; p[1] = v >> 8; }
+static void put32(Uint8 *p, Uint32 v){ p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+/**
+ * Write `frames` frames of a 440 Hz tone under a little noise, with the
+ * level swelling over a few seconds so the waveform is not flat.
+ */
+static int write_wav(const char *path, const struct bench_case *c, Uint64 frames){
+    const int sample_size = SDL_AUDIO_BITSIZE(c->format) / 8;
+    const int frame_size = sample_size * c->channels;
+    const Uint64 data_len = frames * frame_size;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        SDL_SetError("cannot create %s", path);
+        return -1;
+    }
+
+    Uint8 h[44];
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, (Uint32)(data_len + 36 > 0xffffffffu ? 0xffffffffu : data_len + 36));
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, SDL_AUDIO_ISFLOAT(c->format) ? 3 : 1);
+    put16(h + 22, c->channels);
+    put32(h + 24, BENCH_RATE);
+    put32(h + 28, BENCH_RATE * frame_size);
+    put16(h + 32, frame_size);
+    put16(h + 34, sample_size * 8);
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, (Uint32)(data_len > 0xffffffffu ? 0xffffffffu : data_len));
+
+    static Uint8 block[1 << 16];
+    const Uint64 block_frames = sizeof block / frame_size;
+    Uint32 seed = 0x12345678u;
+    int ok = fwrite(h, sizeof h, 1, f) == 1;
+
+    for (Uint64 i = 0; ok && i < frames; i += block_frames) {
+        const Uint64 n = (frames - i < block_frames) ? frames - i : block_frames;
+        Uint8 *p = block;
+        for (Uint64 j = 0; j < n; j++) {
+            const double t = (double)(i + j) / BENCH_RATE;
+            const double level = 0.5 + 0.4 * sin(t * 0.7);
+            for (int ch = 0; ch < c->channels; ch++) {
+                seed = seed * 1664525u + 1013904223u;
+                const float noise = ((Sint32)seed >> 8) * (1.0f / 8388608.0f);
+                const float x = (float)(level * sin(t * 2.0 * SDL_PI_D * 440.0 + ch)) * 0.9f + noise * 0.05f;
+
+                if (SDL_AUDIO_ISFLOAT(c->format)) {
+                    Uint32 bits;
+                    memcpy(&bits, &x, sizeof bits);
+                    put32(p, bits);
+                } else {
+                    put16(p, (Uint16)(Sint16)(x * 32767.0f));
+                }
+                p += sample_size;
+            }
+        }
+        ok = fwrite(block, frame_size, n, f) == n;
+    }
+
+    if (fclose(f) != 0 || !ok) {
+        remove(path);
+        SDL_SetError("cannot write %s", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void report(const struct bench_case *c, Uint64 bytes, const char *stage,
+                   const char *unit, const double *ns){
+    const struct bench_stats s = stats_of(ns, reps);
+
+    fprintf(out, "%s    {\"format\": \"%s\", \"channels\": %d, \"rate\": %d, \"minutes\": %d, "
+                 "\"bytes\": %llu, \"stage\": \"%s\", \"unit\": \"%s\", \"reps\": %d, "
+                 "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f}",
+            results++ ? ",\n" : "", c->format_name, c->channels, BENCH_RATE, c->minutes,
+            (unsigned long long)bytes, stage, unit, reps, s.mean, s.stddev, s.min, s.max);
+    fprintf(stderr, "  %-28s %14.3f us/%-8s +- %.3f\n", stage, s.mean / 1e3, unit, s.stddev / 1e3);
+}
+
+// =============================================================================
+// Checks
+// =============================================================================
+
+/*
+ * Fill `v` with edge-case pattern `pattern`: a run of -32768 (the one
+ * input whose square pair overflows a signed 32-bit lane), full-scale
+ * alternation, or noise.
+ */
+static void check_pattern(int16_t *v, Uint64 n, int pattern){
+    Uint32 seed = 0x2545f491u;
+    for (Uint64 i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        switch (pattern) {
+        case 0:  v[i] = -32768; break;
+        case 1:  v[i] = (i & 1) ? 32767 : -32768; break;
+        default: v[i] = (int16_t)(seed >> 16); break;
+        }
+    }
+}
+
+static int stats_equal(const struct s16_stats *a, const struct s16_stats *b){
+    return a->min == b->min && a->max == b->max && a->sumsq == b->sumsq;
+}
+
+// every kernel against the scalar one on lengths 0..80, so every tail shorter than a vector comes up, and long runs
+static int check_stats(const struct s16_kernel *k, int kernels, const int16_t *v, int pattern){
+    static const Uint64 long_runs[] = { 4099, 65537 };
+
+    for (Uint64 len = 0; len < 80 + SDL_arraysize(long_runs); len++) {
+        const Uint64 n = (len < 80) ? len : long_runs[len - 80];
+        for (int offset = 0; offset < 2; offset++) {
+            struct s16_stats ref, ref_lr[2];
+            s16_stats_scalar(v + offset, n, &ref);
+            s16_stats_stereo_scalar(v + offset, n / 2, ref_lr);
+
+            for (int i = 1; i < kernels; i++) {
+                struct s16_stats got, got_lr[2];
+                k[i].mono(v + offset, n, &got);
+                k[i].stereo(v + offset, n / 2, got_lr);
+                if (!stats_equal(&got, &ref) || !stats_equal(&got_lr[0], &ref_lr[0])
+                    || !stats_equal(&got_lr[1], &ref_lr[1])) {
+                    SDL_SetError("%s s16 kernel differs from scalar: pattern %d, %llu samples at +%d",
+                                 k[i].isa, pattern, (unsigned long long)n, offset);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// calculate_rms, windows spread over the pool, against a double-precision sum of squares
+static int check_rms(const int16_t *v, int pattern){
+    static const int windows[] = { 1, 7, 37, 4099 };
+
+    for (size_t w = 0; w < SDL_arraysize(windows); w++) {
+        const int count = BENCH_CHECK_SAMPLES / windows[w];
+        float *rms = calculate_rms(v, count, windows[w]);
+        if (!rms) {
+            SDL_OutOfMemory();
+            return -1;
+        }
+
+        for (int i = 0; i < count; i++) {
+            double sumsq = 0.0;
+            for (int j = 0; j < windows[w]; j++) {
+                const double x = v[(Uint64)i * windows[w] + j];
+                sumsq += x * x;
+            }
+            const float ref = (float)(sqrt(sumsq / windows[w]) / 32767.0);
+            if (rms[i] != ref) {
+                SDL_SetError("calculate_rms differs from the reference: pattern %d, window %d of %d samples",
+                             pattern, i, windows[w]);
+                free(rms);
+                return -1;
+            }
+        }
+        free(rms);
+    }
+    return 0;
+}
+
+/**
+ * Check every FFT kernel this CPU runs against fft_forward_scalar on
+ * SPECTRUM_FFT_SIZE-point transforms of an impulse, an off-bin sine and
+ * noise, at FFT_KERNEL_TOLERANCE of the reference's largest bin.
+ *
+ * @return 0 when everything matches, -1 on the first mismatch (see SDL_GetError)
+ */
+static int check_fft(void){
+    static const char *const inputs[] = { "impulse", "sine", "noise" };
+    const int n = SPECTRUM_FFT_SIZE;
+    struct fft_kernel k[FFT_MAX_KERNELS];
+    const int kernels = fft_kernels(k);
+
+    struct fft f;
+    if (fft_init(&f, n) < 0)
+        return -1;
+    float *buf = malloc(5 * (size_t)n * sizeof *buf);
+    if (!buf) {
+        fft_free(&f);
+        SDL_OutOfMemory();
+        return -1;
+    }
+    float *x = buf, *ref_re = buf + n, *ref_im = buf + 2 * n, *re = buf + 3 * n, *im = buf + 4 * n;
+
+    int rc = 0;
+    for (int input = 0; input < (int)SDL_arraysize(inputs) && rc == 0; input++) {
+        Uint32 seed = 0x9e3779b9u;
+        for (int i = 0; i < n; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            switch (input) {
+            case 0:  x[i] = (i == 0) ? 1.0f : 0.0f; break;
+            case 1:  x[i] = (float)sin(2.0 * SDL_PI_D * 1000.37 * i / n); break;
+            default: x[i] = ((Sint32)seed >> 8) * (1.0f / 8388608.0f); break;
+            }
+        }
+        memcpy(ref_re, x, (size_t)n * sizeof *x);
+        memset(ref_im, 0, (size_t)n * sizeof *ref_im);
+        fft_forward_scalar(&f, ref_re, ref_im);
+
+        for (int j = 1; j < kernels && rc == 0; j++) {
+            memcpy(re, x, (size_t)n * sizeof *x);
+            memset(im, 0, (size_t)n * sizeof *im);
+            fft_forward_with(&f, &k[j], re, im);
+
+            double peak = 0.0, error = 0.0;
+            for (int i = 0; i < n; i++) {
+                const double mag = hypot(ref_re[i], ref_im[i]);
+                const double diff = hypot(re[i] - ref_re[i], im[i] - ref_im[i]);
+                if (mag > peak) peak = mag;
+                if (diff > error) error = diff;
+            }
+            if (error > FFT_KERNEL_TOLERANCE * peak) {
+                SDL_SetError("%s FFT differs from scalar on %s: %g of the largest bin, %g allowed",
+                             k[j].isa, inputs[input], error / peak, (double)FFT_KERNEL_TOLERANCE);
+                rc = -1;
+            }
+        }
+    }
+
+    free(buf);
+    fft_free(&f);
+    return rc;
+}
+
+/**
+ * Check every resampler dot kernel this CPU runs against the scalar one
+ * on the filter banks of every quality for BENCH_RATE -> BENCH_DEVICE_RATE:
+ * each phase against noise, a full-scale square and DC, from an aligned
+ * and a misaligned start, at RESAMPLE_KERNEL_TOLERANCE of the sum of the
+ * products' magnitudes.
+ *
+ * @return 0 when everything matches, -1 on the first mismatch (see SDL_GetError)
+ */
+static int check_resample(void){
+    static const char *const inputs[] = { "noise", "square", "dc" };
+    struct resample_kernel k[RESAMPLE_MAX_KERNELS];
+    const int kernels = resample_kernels(k);
+
+    // the best quality's taps, plus one for the misaligned start
+    float x[64 + 1];
+    const int max_taps = (int)SDL_arraysize(x) - 1;
+    int rc = 0;
+    for (resample_quality q = RESAMPLE_FAST; q <= RESAMPLE_BEST && rc == 0; q++) {
+        struct resampler r;
+        if (resampler_init(&r, SDL_AUDIO_F32, 1, BENCH_RATE, BENCH_DEVICE_RATE, q) < 0)
+            return -1;
+        if (r.taps > max_taps) {
+            SDL_SetError("check_resample has no room for %d taps", r.taps);
+            resampler_free(&r);
+            return -1;
+        }
+
+        for (int input = 0; input < (int)SDL_arraysize(inputs) && rc == 0; input++) {
+            Uint32 seed = 0x9e3779b9u;
+            for (int i = 0; i <= max_taps; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                switch (input) {
+                case 0:  x[i] = ((Sint32)seed >> 8) * (1.0f / 8388608.0f); break;
+                case 1:  x[i] = (i & 1) ? 1.0f : -1.0f; break;
+                default: x[i] = 1.0f; break;
+                }
+            }
+
+            for (int p = 0; p < r.up && rc == 0; p++) {
+                const float *c = r.bank + (size_t)p * r.taps;
+                for (int offset = 0; offset < 2 && rc == 0; offset++) {
+                    double scale = 0.0;
+                    for (int i = 0; i < r.taps; i++)
+                        scale += fabs((double)c[i] * x[offset + i]);
+                    const float ref = k[0].dot(c, x + offset, r.taps);
+
+                    for (int j = 1; j < kernels && rc == 0; j++) {
+                        const double error = fabs(k[j].dot(c, x + offset, r.taps) - ref);
+                        if (error > RESAMPLE_KERNEL_TOLERANCE * scale) {
+                            SDL_SetError("%s dot product differs from scalar: %s quality, %s, phase %d, offset %d: %g, %g allowed",
+                                         k[j].isa, resample_quality_name(q), inputs[input], p, offset,
+                                         error / scale, (double)RESAMPLE_KERNEL_TOLERANCE);
+                            rc = -1;
+                        }
+                    }
+                }
+            }
+        }
+        resampler_free(&r);
+    }
+    return rc;
+}
+
+/**
+ * Check the s16 kernels at the tolerances their headers state: every
+ * kernel this CPU runs matches s16_stats_scalar exactly, mono and stereo,
+ * from an aligned and a misaligned start; calculate_rms matches the
+ * double-precision reference bit for bit (waveform.h), with enough
+ * windows to be split over several pool jobs.
+ *
+ * @return 0 when everything matches, -1 on the first mismatch (see SDL_GetError)
+ */
+static int check_kernels(void){
+    struct s16_kernel k[S16_MAX_KERNELS];
+    const int kernels = s16_kernels(k);
+
+    int16_t *v = malloc((BENCH_CHECK_SAMPLES + 1) * sizeof *v);
+    if (!v) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    int rc = 0;
+    for (int pattern = 0; pattern < 3 && rc == 0; pattern++) {
+        check_pattern(v, BENCH_CHECK_SAMPLES + 1, pattern);
+        rc = (check_stats(k, kernels, v, pattern) < 0 || check_rms(v, pattern) < 0) ? -1 : 0;
+    }
+
+    free(v);
+    return rc;
+}
+
+/**
+ * Check every mixer kernel this CPU runs against the scalar one: the mix
+ * of mono, stereo and 3-channel voices of every length up to a block past
+ * a few odd tails, at a steady gain and on ramps up, down and apart, into
+ * a sum that already holds something, at MIXER_KERNEL_TOLERANCE of the
+ * reference's largest sample; and the s16 loader, exactly, on the s16
+ * check patterns from an aligned and a misaligned start.
+ *
+ * @return 0 when everything matches, -1 on the first mismatch (see SDL_GetError)
+ */
+static int check_mixer(void){
+    static const float ramps[][4] = {
+        { 0.8f, 0.8f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f / MIXER_BLOCK_FRAMES, 1.0f / MIXER_BLOCK_FRAMES },
+        { 1.0f, 0.5f, -1.0f / MIXER_BLOCK_FRAMES, -0.5f / MIXER_BLOCK_FRAMES },
+        { 0.2f, 1.3f, 1.1f / MIXER_BLOCK_FRAMES, -1.3f / MIXER_BLOCK_FRAMES },
+    };
+    const int max_channels = 3, n = MIXER_BLOCK_FRAMES * max_channels;
+    struct mixer_kernel k[MIXER_MAX_KERNELS];
+    const int kernels = mixer_kernels(k);
+
+    float *buf = malloc((size_t)(n + 4 * MIXER_BLOCK_FRAMES * MIXER_CHANNELS) * sizeof *buf);
+    int16_t *v = malloc((size_t)(n + 1) * sizeof *v);
+    if (!buf || !v) {
+        free(buf); free(v);
+        SDL_OutOfMemory();
+        return -1;
+    }
+    float *src = buf, *base = buf + n, *ref = base + MIXER_BLOCK_FRAMES * MIXER_CHANNELS;
+    float *got = ref + MIXER_BLOCK_FRAMES * MIXER_CHANNELS;
+    float *ref_load = got, *got_load = got + MIXER_BLOCK_FRAMES * MIXER_CHANNELS;
+
+    Uint32 seed = 0x9e3779b9u;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        src[i] = ((Sint32)seed >> 8) * (1.0f / 8388608.0f);
+    }
+    for (int i = 0; i < MIXER_BLOCK_FRAMES * MIXER_CHANNELS; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        base[i] = ((Sint32)seed >> 9) * (1.0f / 8388608.0f);
+    }
+
+    int rc = 0;
+    for (int j = 1; j < kernels && rc == 0; j++) {
+        for (int stride = 1; stride <= max_channels && rc == 0; stride++) {
+            for (int r = 0; r < (int)SDL_arraysize(ramps) && rc == 0; r++) {
+                for (int frames = 0; frames <= MIXER_BLOCK_FRAMES && rc == 0;
+                     frames += (frames < 16 || frames >= MIXER_BLOCK_FRAMES - 8) ? 1 : 37) {
+                    const size_t bytes = (size_t)frames * MIXER_CHANNELS * sizeof *ref;
+                    memcpy(ref, base, bytes);
+                    memcpy(got, base, bytes);
+                    k[0].mix(ref, src, frames, stride, ramps[r][0], ramps[r][1], ramps[r][2], ramps[r][3]);
+                    k[j].mix(got, src, frames, stride, ramps[r][0], ramps[r][1], ramps[r][2], ramps[r][3]);
+
+                    double peak = 0.0, error = 0.0;
+                    for (int i = 0; i < frames * MIXER_CHANNELS; i++) {
+                        if (fabs(ref[i]) > peak) peak = fabs(ref[i]);
+                        if (fabs(got[i] - ref[i]) > error) error = fabs(got[i] - ref[i]);
+                    }
+                    if (error > MIXER_KERNEL_TOLERANCE * peak) {
+                        SDL_SetError("%s mix differs from scalar: %d channels, %d frames, ramp %d: %g of the largest sample, %g allowed",
+                                     k[j].isa, stride, frames, r, error / peak, (double)MIXER_KERNEL_TOLERANCE);
+                        rc = -1;
+                    }
+                }
+            }
+        }
+
+        for (int pattern = 0; pattern < 3 && rc == 0; pattern++) {
+            check_pattern(v, (Uint64)n + 1, pattern);
+            for (int channels = 1; channels <= 2 && rc == 0; channels++) {
+                for (int offset = 0; offset < 2 && rc == 0; offset++) {
+                    const Uint8 *p = (const Uint8 *)(v + offset);
+                    const int frames = MIXER_BLOCK_FRAMES - 1 - offset;
+                    k[0].load_s16le(p, frames, channels, ref_load);
+                    k[j].load_s16le(p, frames, channels, got_load);
+                    if (memcmp(ref_load, got_load, (size_t)frames * channels * sizeof *ref_load) != 0) {
+                        SDL_SetError("%s s16 loader differs from scalar: pattern %d, %d channels, offset %d",
+                                     k[j].isa, pattern, channels, offset);
+                        rc = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    free(v);
+    free(buf);
+    return rc;
+}
+
+/**
+ * Check the limiter against a brute-force reference: the lowest gain
+ * wanted over the last lookahead + 1 frames, released, averaged over the
+ * last lookahead frames and applied to the frame leaving the delay line.
+ * The signals are loud peaks decaying above the ceiling, so the wanted
+ * gain rises for far longer than a window, and bursts of noise. The
+ * chain must follow the reference to 1e-5, and the reference must stay
+ * under the ceiling without the limiter's final clamp.
+ *
+ * @return 0 when everything matches, -1 on the first mismatch (see SDL_GetError)
+ */
+static int check_limiter(void){
+    static const char *const inputs[] = { "decay", "bursts" };
+    const int channels = 2, frames = BENCH_DEVICE_RATE;
+
+    struct dsp_params params;
+    dsp_params_default(&params);
+    struct dsp_chain c;
+    if (dsp_chain_init(&c, SDL_AUDIO_F32, channels, BENCH_DEVICE_RATE, &params, NULL) < 0)
+        return -1;
+    const struct dsp_limiter *l = &c.limiter;
+    const int look = l->lookahead;
+
+    float *x = malloc((size_t)frames * channels * sizeof *x);
+    float *y = malloc((size_t)frames * channels * sizeof *y);
+    float *want = malloc((size_t)frames * sizeof *want);
+    float *env = malloc((size_t)frames * sizeof *env);
+    if (!x || !y || !want || !env) {
+        free(x); free(y); free(want); free(env);
+        dsp_chain_free(&c);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    int rc = 0;
+    for (int input = 0; input < (int)SDL_arraysize(inputs) && rc == 0; input++) {
+        Uint32 seed = 0x6c078965u;
+        for (int i = 0; i < frames; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            const float noise = ((Sint32)seed >> 8) * (1.0f / 8388608.0f);
+            const float v = (input == 0)
+                ? 8.0f * expf(-i / 2000.0f) * ((i & 1) ? 1.0f : -1.0f)
+                : (((i / 300) % 3 == 0) ? 6.0f : 0.3f) * noise;
+            x[2 * i] = v;
+            x[2 * i + 1] = -0.5f * v;
+
+            const float peak = fabsf(v);
+            want[i] = (peak > l->ceiling) ? l->ceiling / peak : 1.0f;
+        }
+
+        // the chain starts over on every input
+        dsp_chain_free(&c);
+        if (dsp_chain_init(&c, SDL_AUDIO_F32, channels, BENCH_DEVICE_RATE, &params, NULL) < 0) {
+            rc = -1;
+            break;
+        }
+        memcpy(y, x, (size_t)frames * channels * sizeof *y);
+        for (int i = 0; i < frames; i += DSP_BLOCK_FRAMES)
+            dsp_chain_process(&c, y + (size_t)i * channels,
+                              (frames - i < DSP_BLOCK_FRAMES) ? frames - i : DSP_BLOCK_FRAMES);
+
+        float e = 1.0f;
+        for (int i = 0; i < frames && rc == 0; i++) {
+            float m = want[i];
+            for (int j = (i > look) ? i - look : 0; j < i; j++)
+                m = (want[j] < m) ? want[j] : m;
+            e = (m < e) ? m : m - (m - e) * l->release;
+            env[i] = e;
+
+            double sum = 0.0;
+            for (int j = i - look + 1; j <= i; j++)
+                sum += (j >= 0) ? env[j] : 1.0f;
+            const int from = i - look;
+            for (int ch = 0; ch < channels && rc == 0; ch++) {
+                const double ref = (from >= 0) ? x[from * channels + ch] * (sum / look) : 0.0;
+                const double got = y[i * channels + ch];
+                if (fabs(ref) > l->ceiling * (1.0 + 1e-5) || fabs(got - ref) > 1e-5) {
+                    SDL_SetError("limiter on %s at frame %d: %g, reference %g, ceiling %g",
+                                 inputs[input], i, got, ref, (double)l->ceiling);
+                    rc = -1;
+                }
+            }
+        }
+    }
+
+    free(x); free(y); free(want); free(env);
+    dsp_chain_free(&c);
+    return rc;
+}
+
+// =============================================================================
+// Stages
+// =============================================================================
+
+/*
+ * 44.1 -> 48 kHz over the first BENCH_RESAMPLE_SECONDS of the track, once
+ * per in-house quality and once through SDL_AudioStream, in ns per second
+ * of audio.
+ */
+static int bench_resample(const struct bench_case *c, const struct audio_track *track, double *ns){
+    const int frame_size = SDL_AUDIO_FRAMESIZE(track->spec);
+    Uint64 frames = (Uint64)BENCH_RESAMPLE_SECONDS * track->spec.freq;
+    if (frames > track->len / frame_size)
+        frames = track->len / frame_size;
+    const double seconds = (double)frames / track->spec.freq;
+
+    for (int q = RESAMPLE_FAST; q <= RESAMPLE_BEST; q++) {
+        struct resampler rs;
+        if (resampler_init(&rs, track->spec.format, track->spec.channels,
+                           track->spec.freq, BENCH_DEVICE_RATE, q) < 0)
+            return -1;
+
+        for (int r = 0; r < reps; r++) {
+            const Uint64 t0 = now_ns();
+            for (Uint64 f = 0; f < frames; f += RESAMPLE_CHUNK) {
+                const int n = (frames - f < RESAMPLE_CHUNK) ? (int)(frames - f) : RESAMPLE_CHUNK;
+                if (resampler_process(&rs, track->buf + f * frame_size, n) > 0)
+                    sink += (Uint64)(rs.out[0] * 1000.0f);
+            }
+            ns[r] = (double)(now_ns() - t0) / seconds;
+        }
+
+        char stage[64];
+        snprintf(stage, sizeof stage, "resample_%s", resample_quality_name(q));
+        report(c, track->len, stage, "second", ns);
+        resampler_free(&rs);
+    }
+
+    const SDL_AudioSpec dst = { SDL_AUDIO_F32, track->spec.channels, BENCH_DEVICE_RATE };
+    SDL_AudioStream *stream = SDL_CreateAudioStream(&track->spec, &dst);
+    const int pull = BENCH_PULL_FRAMES * frame_size;
+    Uint8 *drain = malloc(4 * pull);
+    if (!stream || !drain) {
+        if (stream) SDL_DestroyAudioStream(stream);
+        free(drain);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    for (int r = 0; r < reps; r++) {
+        SDL_ClearAudioStream(stream);
+        const Uint64 t0 = now_ns();
+        for (Uint64 f = 0; f < frames; f += BENCH_PULL_FRAMES) {
+            const Uint64 n = (frames - f < BENCH_PULL_FRAMES) ? frames - f : BENCH_PULL_FRAMES;
+            SDL_PutAudioStreamData(stream, track->buf + f * frame_size, (int)(n * frame_size));
+            while (SDL_GetAudioStreamData(stream, drain, 4 * pull) > 0)
+                ;
+        }
+        ns[r] = (double)(now_ns() - t0) / seconds;
+    }
+    report(c, track->len, "sdl_resample", "second", ns);
+
+    SDL_DestroyAudioStream(stream);
+    free(drain);
+    return 0;
+}
+
+/*
+ * The DSP chain over the same stretch of the track, set up for
+ * BENCH_DEVICE_RATE: the equalizer with 1, 2, 4 ... DSP_MAX_BANDS bands
+ * and the limiter on its own, in ns per DSP_BLOCK_FRAMES block as the
+ * chain records them in its metrics.
+ */
+static int bench_dsp(const struct bench_case *c, const struct audio_track *track, double *ns){
+    const int frame_size = SDL_AUDIO_FRAMESIZE(track->spec);
+    Uint64 frames = (Uint64)BENCH_RESAMPLE_SECONDS * track->spec.freq;
+    if (frames > track->len / frame_size)
+        frames = track->len / frame_size;
+
+    struct dsp_params params;
+    dsp_params_default(&params);
+    for (int b = 0; b < DSP_MAX_BANDS; b++) {
+        // spread from 40 Hz to 20 kHz, alternately boosting and cutting
+        params.band[b] = (struct dsp_band){
+            DSP_PEAK, 40.0f * powf(2.0f, b * 9.0f / (DSP_MAX_BANDS - 1)), (b & 1) ? -3.0f : 3.0f, 1.0f,
+        };
+    }
+
+    for (int bands = 1; bands <= 2 * DSP_MAX_BANDS; bands *= 2) {
+        // one pass past the last band count: the limiter alone
+        const int limiter = bands > DSP_MAX_BANDS;
+        params.bands = limiter ? 0 : bands;
+        params.eq_on = !limiter;
+        params.limiter_on = limiter;
+
+        for (int r = 0; r < reps; r++) {
+            struct metrics metrics;
+            struct dsp_chain chain;
+            metrics_init(&metrics);
+            if (dsp_chain_init(&chain, track->spec.format, track->spec.channels, BENCH_DEVICE_RATE,
+                               &params, &metrics) < 0)
+                return -1;
+
+            for (Uint64 f = 0; f < frames; f += DSP_BLOCK_FRAMES) {
+                const int n = (frames - f < DSP_BLOCK_FRAMES) ? (int)(frames - f) : DSP_BLOCK_FRAMES;
+                sink += (Uint64)(dsp_chain_run(&chain, track->buf + f * frame_size, n)[0] * 1000.0f);
+            }
+            ns[r] = (double)metrics_mean(limiter ? &metrics.dsp_limiter : &metrics.dsp_eq);
+            dsp_chain_free(&chain);
+        }
+
+        char stage[64];
+        if (limiter)
+            snprintf(stage, sizeof stage, "dsp_limiter");
+        else
+            snprintf(stage, sizeof stage, "dsp_eq_%d", bands);
+        report(c, track->len, stage, "block", ns);
+    }
+
+    fprintf(stderr, "  (a %d-frame block lasts %.1f us at %d Hz)\n", DSP_BLOCK_FRAMES,
+            DSP_BLOCK_FRAMES * 1e6 / BENCH_DEVICE_RATE, BENCH_DEVICE_RATE);
+    return 0;
+}
+
+/*
+ * Bring the mixer to `n` looping voices of `voice`, spread over the track
+ * and across the stereo field. Voices are taken from the lowest free slot,
+ * so those playing are always 0 .. *playing - 1.
+ */
+static void mixer_voices(struct mixer *m, struct audio_track *voice, int *playing, int n, float *mix){
+    while (*playing < n) {
+        const int v = mixer_play(m, voice, 1.0f / n, (*playing % 17) / 8.0f - 1.0f, 1);
+        if (v < 0)
+            break;
+        mixer_seek(m, v, (Uint64)*playing * 104729 % voice->frames);
+        (*playing)++;
+    }
+    if (*playing > n) {
+        while (*playing > n)
+            mixer_stop(m, --(*playing));
+        mixer_render(m, mix, MIXER_BLOCK_FRAMES);
+    }
+}
+
+// slowest of BENCH_MIXER_CALLBACKS callbacks' worth of mixing, in ns; the total in *sum
+static double mixer_worst(struct mixer *m, float *mix, double *sum){
+    double worst = 0.0;
+    *sum = 0.0;
+    for (int i = 0; i < BENCH_MIXER_CALLBACKS; i++) {
+        const Uint64 t0 = now_ns();
+        mixer_render(m, mix, BENCH_PULL_FRAMES);
+        const double t = (double)(now_ns() - t0);
+        sink += (Uint64)(mix[0] * 1000.0f);
+        *sum += t;
+        if (t > worst)
+            worst = t;
+    }
+    return worst;
+}
+
+/*
+ * How many voices of this case's samples the mixer keeps up with at
+ * BENCH_DEVICE_RATE: every BENCH_PULL_FRAMES callback has to be mixed in
+ * the time the device takes to play it. The count doubles until the
+ * slowest of BENCH_MIXER_CALLBACKS callbacks misses that deadline, then is
+ * bisected. The samples are declared at the mixer's rate, which changes
+ * nothing about the cost; it depends on the format and channels, not on
+ * the length, so only the shortest tracks run this.
+ */
+static int bench_mixer(const struct bench_case *c, const struct audio_track *track, double *ns){
+    if (c->minutes != durations_min[0])
+        return 0;
+
+    struct audio_track voice;
+    SDL_zero(voice);
+    voice.buf = track->buf;
+    voice.len = track->len;
+    voice.frames = track->frames;
+    voice.spec = track->spec;
+    voice.spec.freq = BENCH_DEVICE_RATE;
+
+    struct mixer mixer, *m = &mixer;
+    if (mixer_init(m, BENCH_DEVICE_RATE, BENCH_MIXER_MAX_VOICES) < 0)
+        return -1;
+    float *mix = malloc((size_t)BENCH_PULL_FRAMES * MIXER_CHANNELS * sizeof *mix);
+    if (!mix) {
+        mixer_free(m);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    const double deadline = BENCH_PULL_FRAMES * 1e9 / BENCH_DEVICE_RATE;
+    int playing = 0, fits = 0, misses = 0;
+    double sum;
+    for (int n = 16; n <= BENCH_MIXER_MAX_VOICES; n *= 2) {
+        mixer_voices(m, &voice, &playing, n, mix);
+        if (mixer_worst(m, mix, &sum) > deadline) {
+            misses = n;
+            break;
+        }
+        fits = n;
+    }
+    while (misses && misses - fits > 1) {
+        const int n = fits + (misses - fits) / 2;
+        mixer_voices(m, &voice, &playing, n, mix);
+        if (mixer_worst(m, mix, &sum) > deadline)
+            misses = n;
+        else
+            fits = n;
+    }
+
+    mixer_voices(m, &voice, &playing, fits ? fits : 1, mix);
+    double worst = 0.0;
+    for (int r = 0; r < reps; r++) {
+        const double w = mixer_worst(m, mix, &sum);
+        ns[r] = sum / BENCH_MIXER_CALLBACKS;
+        if (w > worst)
+            worst = w;
+    }
+    report(c, track->len, "mixer_callback", "callback", ns);
+
+    fprintf(out, "%s    {\"format\": \"%s\", \"channels\": %d, \"rate\": %d, \"minutes\": %d, "
+                 "\"stage\": \"mixer_max_voices\", \"voices\": %d, \"capped\": %s, "
+                 "\"deadline_ns\": %.1f, \"worst_ns\": %.1f}",
+            results++ ? ",\n" : "", c->format_name, c->channels, BENCH_DEVICE_RATE, c->minutes,
+            playing, misses ? "false" : "true", deadline, worst);
+    fprintf(stderr, "  %-28s %14d voices   (%d-frame callbacks at %d Hz, %.3f us per voice)\n",
+            "mixer_max_voices", playing, BENCH_PULL_FRAMES, BENCH_DEVICE_RATE,
+            ns[0] / playing / 1e3);
+
+    mixer_free(m);
+    free(mix);
+    return 0;
+}
+
+static int bench_case(const struct bench_case *c, const char *path){
+    double *ns = calloc(reps, sizeof *ns);
+    if (!ns) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    struct metrics metrics;
+    struct audio_track track;
+    struct audio_buffer a;
+    SDL_zero(track);
+    SDL_zero(a);
+    metrics_init(&metrics);
+
+    // audio_track_open + audio_buffer_init: open, parse and map the file
+    for (int r = 0; r < reps; r++) {
+        const Uint64 t0 = now_ns();
+        if (audio_track_open(&track, path) < 0) {
+            free(ns);
+            return -1;
+        }
+        audio_buffer_init(&a, &track, &metrics);
+        ns[r] = (double)(now_ns() - t0);
+        if (r + 1 < reps)
+            audio_track_close(&track);
+    }
+    report(c, track.len, "audio_buffer_init", "call", ns);
+
+    // the one pass over the samples the player makes for its waveform
+    for (int r = 0; r < reps; r++) {
+        struct waveform wf;
+        const Uint64 t0 = now_ns();
+        if (waveform_build(&wf, track.buf, track.len, &track.spec) < 0) {
+            audio_track_close(&track);
+            free(ns);
+            return -1;
+        }
+        ns[r] = (double)(now_ns() - t0);
+        waveform_free(&wf);
+    }
+    report(c, track.len, "waveform_build", "track", ns);
+
+    // what the analysis adds to that pass for normalization
+    for (int r = 0; r < reps; r++) {
+        struct loudness l;
+        struct loudness_result result;
+        const Uint64 t0 = now_ns();
+        if (loudness_init(&l, track.len / SDL_AUDIO_FRAMESIZE(track.spec), &track.spec) < 0) {
+            audio_track_close(&track);
+            free(ns);
+            return -1;
+        }
+        loudness_scan(&l, track.buf, 0, l.frames, 0);
+        const int rc = loudness_finish(&l, &result);
+        ns[r] = (double)(now_ns() - t0);
+        loudness_free(&l);
+        if (rc < 0) {
+            audio_track_close(&track);
+            free(ns);
+            return -1;
+        }
+    }
+    report(c, track.len, "loudness_scan", "track", ns);
+
+    // calculate_rms / calculate_peaks only take interleaved s16
+    if (c->format == SDL_AUDIO_S16LE) {
+        const Uint64 samples = track.len / sizeof(int16_t);
+        const int window = (int)(samples / BENCH_BARS);
+
+        for (int r = 0; r < reps; r++) {
+            const Uint64 t0 = now_ns();
+            float *rms = calculate_rms((const int16_t *)track.buf, BENCH_BARS, window);
+            ns[r] = (double)(now_ns() - t0);
+            sink += rms ? (Uint64)(rms[0] * 1000.0f) : 0;
+            free(rms);
+        }
+        report(c, track.len, "calculate_rms", "track", ns);
+
+        for (int r = 0; r < reps; r++) {
+            const Uint64 t0 = now_ns();
+            float *peaks = calculate_peaks((const int16_t *)track.buf, BENCH_BARS, window);
+            ns[r] = (double)(now_ns() - t0);
+            sink += peaks ? (Uint64)(peaks[0] * 1000.0f) : 0;
+            free(peaks);
+        }
+        report(c, track.len, "calculate_peaks", "track", ns);
+    }
+
+    // calculate_audio_track_time, once per UI frame in the player
+    const int frame_size = SDL_AUDIO_FRAMESIZE(track.spec);
+    for (int r = 0; r < reps; r++) {
+        const Uint64 t0 = now_ns();
+        for (int i = 0; i < BENCH_TRACK_TIME_CALLS; i++) {
+            atomic_store_explicit(&a.pos, (Uint64)i * frame_size % track.len, memory_order_relaxed);
+            sink += calculate_audio_track_time(&a).elapsed_sec;
+        }
+        ns[r] = (double)(now_ns() - t0) / BENCH_TRACK_TIME_CALLS;
+    }
+    report(c, track.len, "calculate_audio_track_time", "call", ns);
+
+    // audio_callback: pull the whole track through a stream like the device would
+    SDL_AudioStream *stream = SDL_CreateAudioStream(&track.spec, &track.spec);
+    const int pull = BENCH_PULL_FRAMES * frame_size;
+    Uint8 *drain = malloc(2 * pull);
+    if (!stream || !drain) {
+        if (stream) SDL_DestroyAudioStream(stream);
+        free(drain);
+        audio_track_close(&track);
+        free(ns);
+        return -1;
+    }
+
+    Uint64 callbacks = 0;
+    for (int r = 0; r < reps; r++) {
+        audio_buffer_init(&a, &track, &metrics);
+        SDL_ClearAudioStream(stream);
+        callbacks = 0;
+
+        const Uint64 t0 = now_ns();
+        for (;;) {
+            const Uint64 before = atomic_load_explicit(&a.pos, memory_order_relaxed);
+            audio_callback(&a, stream, pull, pull);
+            callbacks++;
+            while (SDL_GetAudioStreamData(stream, drain, 2 * pull) > 0)
+                ;
+            if (atomic_load_explicit(&a.pos, memory_order_relaxed) == before)
+                break;
+        }
+        ns[r] = (double)(now_ns() - t0) / callbacks;
+    }
+    report(c, track.len, "audio_callback", "callback", ns);
+
+    // spectrum_update on what the callback taps, once per display frame in the player
+    struct spectrum *spectrum = malloc(sizeof *spectrum);
+    if (!spectrum || spectrum_init(spectrum, &metrics) < 0) {
+        free(spectrum);
+        SDL_DestroyAudioStream(stream);
+        free(drain);
+        audio_track_close(&track);
+        free(ns);
+        return -1;
+    }
+    spectrum_set_freq(spectrum, track.spec.freq);
+
+    audio_buffer_init(&a, &track, &metrics);
+    audio_set_tap(&a, &spectrum->tap);
+    for (int r = 0; r < reps; r++) {
+        double spent = 0.0;
+        for (int i = 0; i < BENCH_SPECTRUM_UPDATES; i++) {
+            audio_callback(&a, stream, pull, pull);
+            while (SDL_GetAudioStreamData(stream, drain, 2 * pull) > 0)
+                ;
+
+            const Uint64 t0 = now_ns();
+            sink += spectrum_update(spectrum);
+            spent += (double)(now_ns() - t0);
+        }
+        ns[r] = spent / BENCH_SPECTRUM_UPDATES;
+    }
+    report(c, track.len, "spectrum_update", "update", ns);
+
+    int rc = bench_resample(c, &track, ns);
+    if (rc == 0)
+        rc = bench_dsp(c, &track, ns);
+    if (rc == 0)
+        rc = bench_mixer(c, &track, ns);
+
+    spectrum_free(spectrum);
+    free(spectrum);
+    SDL_DestroyAudioStream(stream);
+    free(drain);
+    audio_track_close(&track);
+    free(ns);
+    return rc;
+}
+
+/**
+ * Decode `path` (FLAC, MP3, Ogg Vorbis) start to end through its backend,
+ * in ns per second of audio, then seek to a few points and read a chunk
+ * at each, in ns per seek. A seek that reads nothing fails the stage.
+ */
+static int bench_decode(const char *path){
+    float *chunk = NULL;
+    double *ns = malloc(reps * sizeof *ns), *seek_ns = malloc(reps * sizeof *seek_ns);
+    struct decoder d;
+    Uint64 frames = 0;
+    SDL_AudioSpec spec = { 0 };
+    if (!ns || !seek_ns) {
+        free(ns);
+        free(seek_ns);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    int rc = 0;
+    for (int r = 0; r < reps && rc == 0; r++) {
+        const Uint64 t0 = now_ns();
+        if (decoder_open(&d, path) < 0) {
+            rc = -1;
+            break;
+        }
+        spec = d.spec;
+        if (!chunk && !(chunk = malloc((size_t)DECODER_CHUNK_FRAMES * spec.channels * sizeof *chunk))) {
+            decoder_close(&d);
+            SDL_OutOfMemory();
+            rc = -1;
+            break;
+        }
+
+        Uint64 n, total = 0;
+        while ((n = decoder_read(&d, chunk, DECODER_CHUNK_FRAMES)) > 0)
+            total += n;
+        frames = total;
+        ns[r] = (double)(now_ns() - t0) * spec.freq / (total ? total : 1);
+
+        // back to the middle, near the start and near the end
+        const Uint64 points[] = { total / 2, total / 97, total - total / 13 };
+        const Uint64 t1 = now_ns();
+        for (size_t i = 0; i < SDL_arraysize(points) && rc == 0; i++) {
+            if (decoder_seek(&d, points[i]) < 0) {
+                rc = -1;
+            } else if (decoder_read(&d, chunk, DECODER_CHUNK_FRAMES) == 0) {
+                SDL_SetError("%s: nothing to read after a seek to frame %llu", path,
+                             (unsigned long long)points[i]);
+                rc = -1;
+            }
+        }
+        seek_ns[r] = (double)(now_ns() - t1) / SDL_arraysize(points);
+        decoder_close(&d);
+    }
+
+    if (rc == 0) {
+        const char *ext = strrchr(path, '.');
+        const struct bench_stats s = stats_of(ns, reps), k = stats_of(seek_ns, reps);
+        fprintf(out, "%s    {\"file\": \"%s\", \"format\": \"%s\", \"channels\": %d, \"rate\": %d, "
+                     "\"frames\": %llu, \"stage\": \"decode\", \"unit\": \"second\", \"reps\": %d, "
+                     "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f, "
+                     "\"seek_mean_ns\": %.1f, \"seek_max_ns\": %.1f}",
+                results++ ? ",\n" : "", path, ext ? ext + 1 : "", spec.channels, spec.freq,
+                (unsigned long long)frames, reps, s.mean, s.stddev, s.min, s.max, k.mean, k.max);
+        fprintf(stderr, "  %-28s %14.3f us/%-8s +- %.3f\n", "decode", s.mean / 1e3, "second", s.stddev / 1e3);
+        fprintf(stderr, "  %-28s %14.3f us/%-8s +- %.3f\n", "decode_seek", k.mean / 1e3, "seek", k.stddev / 1e3);
+    }
+
+    free(chunk);
+    free(ns);
+    free(seek_ns);
+    return rc;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char **argv){
+    const char *out_path = NULL;
+    const char *decode[BENCH_MAX_DECODE];
+    int decodes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--reps=", 7) == 0)
+            reps = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--max-minutes=", 14) == 0)
+            max_minutes = atoi(argv[i] + 14);
+        else if (strncmp(argv[i], "--out=", 6) == 0)
+            out_path = argv[i] + 6;
+        else if (strncmp(argv[i], "--decode=", 9) == 0 && decodes < BENCH_MAX_DECODE)
+            decode[decodes++] = argv[i] + 9;
+        else {
+            fprintf(stderr, "Usage: %s [--reps=N] [--max-minutes=N] [--out=results.json] [--decode=FILE]...\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    if (!SDL_Init(SDL_INIT_AUDIO)) {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // a kernel that disagrees with its reference is not worth timing
+    if (check_kernels() < 0 || check_fft() < 0 || check_resample() < 0 || check_mixer() < 0 || check_limiter() < 0) {
+        fprintf(stderr, "check failed: %s\n", SDL_GetError());
+        pool_shutdown();
+        SDL_Quit();
+        return 1;
+    }
+
+    out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "cannot write %s\n", out_path);
+        SDL_Quit();
+        return 1;
+    }
+
+    const char *tmpdir = getenv("TMPDIR");
+    if (!tmpdir || !tmpdir[0]) tmpdir = "/tmp";
+
+    fprintf(out, "{\n  \"threads\": %d,\n  \"kernel\": \"%s\",\n  \"fft_kernel\": \"%s\",\n"
+            "  \"resample_kernel\": \"%s\",\n  \"dsp_kernel\": \"%s\",\n  \"mixer_kernel\": \"%s\",\n"
+            "  \"decoders\": \"%s\",\n  \"reps\": %d,\n  \"results\": [\n",
+            pool_threads(), kernels_isa(), fft_isa(), resample_isa(), dsp_isa(), mixer_isa(),
+            decoder_backends(), reps);
+
+    int failed = 0;
+    for (int i = 0; i < decodes; i++) {
+        fprintf(stderr, "%s\n", decode[i]);
+        if (bench_decode(decode[i]) < 0) {
+            fprintf(stderr, "  failed: %s\n", SDL_GetError());
+            failed = 1;
+        }
+    }
+    for (size_t d = 0; d < SDL_arraysize(durations_min); d++) {
+        if (durations_min[d] > max_minutes)
+            continue;
+
+        for (size_t l = 0; l < SDL_arraysize(layouts); l++) {
+            const struct bench_case c = {
+                layouts[l].name, layouts[l].format, layouts[l].channels, durations_min[d],
+            };
+            char path[512];
+            snprintf(path, sizeof path, "%s/bench-%s-%dch-%dmin.wav", tmpdir, c.format_name, c.channels, c.minutes);
+
+            fprintf(stderr, "%s %dch %d min\n", c.format_name, c.channels, c.minutes);
+            if (write_wav(path, &c, (Uint64)c.minutes * 60 * BENCH_RATE) < 0 || bench_case(&c, path) < 0) {
+                fprintf(stderr, "  failed: %s\n", SDL_GetError());
+                failed = 1;
+            }
+            remove(path);
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    pool_shutdown();
+    SDL_Quit();
+    return failed;
+}
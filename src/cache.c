@@ -0,0 +1,267 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define CACHE_MAGIC "WFCACHE"
+#define CACHE_VERSION 3
+#define CACHE_ENDIAN 0x01020304u
+#define CACHE_DIR_NAME "sdl3-audio-player"
+#define CACHE_ALIGN 16
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * cache_header
+ *
+ * Start of a cache entry, written in host byte order (`endian` catches a
+ * cache shared with a machine of the other order). It is followed by the
+ * NUL-terminated track path, padding up to CACHE_ALIGN, and the bins of
+ * every level back to back. The track's loudness rides along in the
+ * header, it was measured in the same pass.
+ */
+struct cache_header {
+    char magic[8];
+    Uint32 version;
+    Uint32 endian;
+    Uint64 file_size;
+    Sint64 mtime_sec;
+    Sint64 mtime_nsec;
+    Uint64 header_hash;
+    Uint64 frames;
+    Uint32 block_frames;
+    Uint32 bin_size;
+    Uint32 channels;
+    Uint32 levels;
+    Uint32 path_len;
+    struct loudness_result loudness;
+    Uint64 count[WAVEFORM_MAX_LEVELS];
+};
+
+struct cache_key {
+    char path[PATH_MAX];
+    Uint64 file_size;
+    Sint64 mtime_sec;
+    Sint64 mtime_nsec;
+    Uint64 header_hash;
+};
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static Uint64 fnv1a(const void *data, size_t len){
+    const Uint8 *p = data;
+    Uint64 h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static int make_key(const char *path, const struct audio_track *t, struct cache_key *key){
+    struct stat st;
+    if (!realpath(path, key->path) || stat(key->path, &st) < 0) {
+        SDL_SetError("cannot resolve %s", path);
+        return -1;
+    }
+
+    key->file_size = (Uint64)st.st_size;
+    key->mtime_sec = st.st_mtim.tv_sec;
+    key->mtime_nsec = st.st_mtim.tv_nsec;
+    // everything up to the PCM: RIFF header, fmt and any metadata chunks;
+    // a decoded file only has what its decoder made of it
+    if (t->wav.map)
+        key->header_hash = fnv1a(t->wav.map, (size_t)(t->wav.data - (const Uint8 *)t->wav.map));
+    else
+        key->header_hash = fnv1a(&t->spec, sizeof t->spec) ^ t->len;
+    return 0;
+}
+
+static int cache_dir(char *out, size_t n){
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg && xdg[0] == '/')
+        snprintf(out, n, "%s/%s", xdg, CACHE_DIR_NAME);
+    else if (home)
+        snprintf(out, n, "%s/.cache/%s", home, CACHE_DIR_NAME);
+    else {
+        SDL_SetError("neither XDG_CACHE_HOME nor HOME is set");
+        return -1;
+    }
+    return 0;
+}
+
+static int entry_path(const struct cache_key *key, char *out, size_t n){
+    char dir[PATH_MAX];
+    if (cache_dir(dir, sizeof dir) < 0)
+        return -1;
+
+    snprintf(out, n, "%s/%016llx.wfc", dir,
+             (unsigned long long)fnv1a(key->path, SDL_strlen(key->path)));
+    return 0;
+}
+
+// mkdir -p for the cache directory
+static int ensure_cache_dir(void){
+    char dir[PATH_MAX];
+    if (cache_dir(dir, sizeof dir) < 0)
+        return -1;
+
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(dir, 0755);
+        *p = '/';
+    }
+    if (mkdir(dir, 0755) < 0 && access(dir, W_OK) < 0) {
+        SDL_SetError("cannot create cache directory %s", dir);
+        return -1;
+    }
+    return 0;
+}
+
+static size_t bins_offset(Uint32 path_len){
+    size_t off = sizeof(struct cache_header) + path_len;
+    return (off + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int waveform_cache_load(struct waveform *wf, const char *path, const struct audio_track *t){
+    struct cache_key key;
+    char entry[PATH_MAX];
+    if (make_key(path, t, &key) < 0 || entry_path(&key, entry, sizeof entry) < 0)
+        return -1;
+
+    int fd = open(entry, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct cache_header)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const struct cache_header *h = map;
+    const size_t path_len = SDL_strlen(key.path) + 1;
+
+    int valid = SDL_memcmp(h->magic, CACHE_MAGIC, sizeof h->magic) == 0
+        && h->version == CACHE_VERSION
+        && h->endian == CACHE_ENDIAN
+        && h->block_frames == WAVEFORM_BLOCK_FRAMES
+        && h->bin_size == sizeof(struct waveform_bin)
+        && h->channels >= 1 && h->channels <= WAVEFORM_MAX_CHANNELS
+        && h->levels <= WAVEFORM_MAX_LEVELS
+        && h->file_size == key.file_size
+        && h->mtime_sec == key.mtime_sec
+        && h->mtime_nsec == key.mtime_nsec
+        && h->header_hash == key.header_hash
+        && h->path_len == path_len
+        && bins_offset(h->path_len) <= (size_t)st.st_size
+        && SDL_memcmp((const char *)(h + 1), key.path, path_len) == 0;
+
+    Uint64 expected = bins_offset(h->path_len);
+    for (Uint32 l = 0; valid && l < h->levels; l++)
+        expected += h->count[l] * h->channels * sizeof(struct waveform_bin);
+
+    if (!valid || expected != (Uint64)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    SDL_zerop(wf);
+    wf->frames = h->frames;
+    wf->channels = (int)h->channels;
+    wf->levels = (int)h->levels;
+    wf->map = map;
+    wf->map_len = (size_t)st.st_size;
+    wf->loudness = h->loudness;
+    atomic_store(&wf->ready, h->frames);
+
+    Uint8 *bins = (Uint8 *)map + bins_offset(h->path_len);
+    for (int l = 0; l < wf->levels; l++) {
+        wf->count[l] = h->count[l];
+        wf->bins[l] = (struct waveform_bin *)bins;
+        bins += h->count[l] * h->channels * sizeof(struct waveform_bin);
+    }
+    return 0;
+}
+
+int waveform_cache_store(const struct waveform *wf, const char *path, const struct audio_track *t){
+    struct cache_key key;
+    char entry[PATH_MAX], tmp[PATH_MAX + 32];
+    if (make_key(path, t, &key) < 0 || entry_path(&key, entry, sizeof entry) < 0)
+        return -1;
+    if (ensure_cache_dir() < 0)
+        return -1;
+
+    struct cache_header h;
+    SDL_zero(h);
+    SDL_memcpy(h.magic, CACHE_MAGIC, sizeof h.magic);
+    h.version = CACHE_VERSION;
+    h.endian = CACHE_ENDIAN;
+    h.file_size = key.file_size;
+    h.mtime_sec = key.mtime_sec;
+    h.mtime_nsec = key.mtime_nsec;
+    h.header_hash = key.header_hash;
+    h.frames = wf->frames;
+    h.block_frames = WAVEFORM_BLOCK_FRAMES;
+    h.bin_size = sizeof(struct waveform_bin);
+    h.channels = (Uint32)wf->channels;
+    h.levels = (Uint32)wf->levels;
+    h.path_len = (Uint32)SDL_strlen(key.path) + 1;
+    h.loudness = wf->loudness;
+    for (int l = 0; l < wf->levels; l++)
+        h.count[l] = wf->count[l];
+
+    // pool threads may store the same entry at once: each gets its own file, the last rename wins
+    snprintf(tmp, sizeof tmp, "%s.XXXXXX", entry);
+    const int fd = mkstemp(tmp);
+    FILE *f = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if (!f) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp);
+        }
+        SDL_SetError("cannot write %s", tmp);
+        return -1;
+    }
+
+    static const Uint8 padding[CACHE_ALIGN];
+    const size_t pad = bins_offset(h.path_len) - sizeof h - h.path_len;
+
+    int ok = fwrite(&h, sizeof h, 1, f) == 1
+        && fwrite(key.path, h.path_len, 1, f) == 1
+        && fwrite(padding, 1, pad, f) == pad;
+    for (int l = 0; ok && l < wf->levels; l++)
+        ok = fwrite(wf->bins[l], sizeof(struct waveform_bin) * wf->channels, wf->count[l], f) == wf->count[l];
+
+    if (fclose(f) != 0 || !ok || rename(tmp, entry) < 0) {
+        unlink(tmp);
+        SDL_SetError("cannot write cache entry %s", entry);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "audio.h"
+#include "waveform.h"
+
+/**
+ * Sidecar cache of waveform summaries, one file per track under
+ * $XDG_CACHE_HOME/sdl3-audio-player (~/.cache/sdl3-audio-player).
+ *
+ * An entry is keyed by the track's absolute path, size, mtime and a hash
+ * of its RIFF header (of the decoded format and length for compressed
+ * files), and is versioned so that a format change simply turns every
+ * old entry into a miss.
+ */
+
+/**
+ * Map the cached summary of `path` into `wf`. Validation only reads the
+ * entry header; the bins are used straight from the mapping.
+ *
+ * @return 0 on a hit, -1 on a miss or a stale/corrupt entry
+ */
+int waveform_cache_load(struct waveform *wf, const char *path, const struct audio_track *t);
+
+/**
+ * Write `wf` as the cache entry of `path`. The entry is written to a
+ * temporary file and renamed into place, so readers never see half of it.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int waveform_cache_store(const struct waveform *wf, const char *path, const struct audio_track *t);
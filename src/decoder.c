@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * The decoders are single-file libraries, picked up from the include path
+ * (third_party/ in the Makefile) when present; they are not shipped with
+ * the tree. A backend whose file is missing is not built in: opening such
+ * a file fails with where to put it, and decoder_backends() lists what is.
+ */
+#if __has_include("dr_flac.h")
+  #define DR_FLAC_IMPLEMENTATION
+  #include "dr_flac.h"
+  #define HAVE_DR_FLAC 1
+#endif
+
+#if __has_include("dr_mp3.h")
+  #define DR_MP3_IMPLEMENTATION
+  #include "dr_mp3.h"
+  #define HAVE_DR_MP3 1
+#endif
+
+#if __has_include("stb_vorbis.c")
+  #include "stb_vorbis.c"
+  #define HAVE_STB_VORBIS 1
+#endif
+
+#include "decoder.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// MP3 has no index of its own: one seek point per this many seconds
+#define DECODER_MP3_SEEK_SECONDS 2
+#define DECODER_MP3_MAX_SEEK_POINTS 8192
+
+// how long the worker sleeps with a full ring before it looks again
+#define DECODER_IDLE_MS 50
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * decoder_backend
+ *
+ * One vendored decoder; the functions are NULL when its file was not
+ * found at build time:
+ * - header:     the file to drop into third_party/ to build it in
+ * - extensions: file name suffixes it is picked for
+ */
+struct decoder_backend {
+    const char *name;
+    const char *header;
+    const char *extensions[3];
+    int (*open)(struct decoder *d, const char *path);
+    Uint64 (*read)(struct decoder *d, float *out, Uint64 frames);
+    int (*seek)(struct decoder *d, Uint64 frame);
+    void (*close)(struct decoder *d);
+};
+
+// =============================================================================
+// Backends
+// =============================================================================
+
+#ifdef HAVE_DR_FLAC
+
+// dr_flac seeks through the file's SEEKTABLE block when it has one
+static int flac_open(struct decoder *d, const char *path){
+    drflac *flac = drflac_open_file(path, NULL);
+    if (!flac) {
+        SDL_SetError("cannot decode %s as FLAC", path);
+        return -1;
+    }
+
+    d->handle = flac;
+    d->spec = (SDL_AudioSpec){ SDL_AUDIO_F32, flac->channels, (int)flac->sampleRate };
+    d->frames = flac->totalPCMFrameCount;
+    return 0;
+}
+
+static Uint64 flac_read(struct decoder *d, float *out, Uint64 frames){
+    return drflac_read_pcm_frames_f32(d->handle, frames, out);
+}
+
+static int flac_seek(struct decoder *d, Uint64 frame){
+    if (!drflac_seek_to_pcm_frame(d->handle, frame)) {
+        SDL_SetError("FLAC seek to frame %llu failed", (unsigned long long)frame);
+        return -1;
+    }
+    return 0;
+}
+
+static void flac_close(struct decoder *d){
+    drflac_close(d->handle);
+}
+
+  #define FLAC_BACKEND flac_open, flac_read, flac_seek, flac_close
+#else
+  #define FLAC_BACKEND NULL, NULL, NULL, NULL
+#endif
+
+#ifdef HAVE_DR_MP3
+
+static int mp3_open(struct decoder *d, const char *path){
+    drmp3 *mp3 = malloc(sizeof *mp3);
+    if (!mp3) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    if (!drmp3_init_file(mp3, path, NULL)) {
+        free(mp3);
+        SDL_SetError("cannot decode %s as MP3", path);
+        return -1;
+    }
+
+    d->handle = mp3;
+    d->spec = (SDL_AudioSpec){ SDL_AUDIO_F32, (int)mp3->channels, (int)mp3->sampleRate };
+    d->frames = drmp3_get_pcm_frame_count(mp3);
+
+    // both scans rewind to frame 0; without the table a seek decodes from the start
+    drmp3_uint32 points = (drmp3_uint32)(d->frames / ((Uint64)mp3->sampleRate * DECODER_MP3_SEEK_SECONDS)) + 1;
+    if (points > DECODER_MP3_MAX_SEEK_POINTS)
+        points = DECODER_MP3_MAX_SEEK_POINTS;
+    drmp3_seek_point *table = malloc(points * sizeof *table);
+    if (table && drmp3_calculate_seek_points(mp3, &points, table)
+        && drmp3_bind_seek_table(mp3, points, table))
+        d->seek_table = table;
+    else
+        free(table);
+    return 0;
+}
+
+static Uint64 mp3_read(struct decoder *d, float *out, Uint64 frames){
+    return drmp3_read_pcm_frames_f32(d->handle, frames, out);
+}
+
+static int mp3_seek(struct decoder *d, Uint64 frame){
+    if (!drmp3_seek_to_pcm_frame(d->handle, frame)) {
+        SDL_SetError("MP3 seek to frame %llu failed", (unsigned long long)frame);
+        return -1;
+    }
+    return 0;
+}
+
+static void mp3_close(struct decoder *d){
+    drmp3_uninit(d->handle);
+    free(d->handle);
+}
+
+  #define MP3_BACKEND mp3_open, mp3_read, mp3_seek, mp3_close
+#else
+  #define MP3_BACKEND NULL, NULL, NULL, NULL
+#endif
+
+#ifdef HAVE_STB_VORBIS
+
+// stb_vorbis bisects on the pages' granule positions, Ogg's own seek index
+static int vorbis_open(struct decoder *d, const char *path){
+    int error = 0;
+    stb_vorbis *vorbis = stb_vorbis_open_filename(path, &error, NULL);
+    if (!vorbis) {
+        SDL_SetError("cannot decode %s as Ogg Vorbis (error %d)", path, error);
+        return -1;
+    }
+
+    const stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+    d->handle = vorbis;
+    d->spec = (SDL_AudioSpec){ SDL_AUDIO_F32, info.channels, (int)info.sample_rate };
+    d->frames = stb_vorbis_stream_length_in_samples(vorbis);
+    return 0;
+}
+
+static Uint64 vorbis_read(struct decoder *d, float *out, Uint64 frames){
+    const int channels = d->spec.channels;
+    return (Uint64)stb_vorbis_get_samples_float_interleaved(d->handle, channels, out,
+                                                            (int)frames * channels);
+}
+
+static int vorbis_seek(struct decoder *d, Uint64 frame){
+    if (!stb_vorbis_seek(d->handle, (unsigned int)frame)) {
+        SDL_SetError("Vorbis seek to frame %llu failed", (unsigned long long)frame);
+        return -1;
+    }
+    return 0;
+}
+
+static void vorbis_close(struct decoder *d){
+    stb_vorbis_close(d->handle);
+}
+
+  #define VORBIS_BACKEND vorbis_open, vorbis_read, vorbis_seek, vorbis_close
+#else
+  #define VORBIS_BACKEND NULL, NULL, NULL, NULL
+#endif
+
+static const struct decoder_backend backends[] = {
+    { "FLAC",   "dr_flac.h",    { ".flac" },         FLAC_BACKEND },
+    { "MP3",    "dr_mp3.h",     { ".mp3" },          MP3_BACKEND },
+    { "Vorbis", "stb_vorbis.c", { ".ogg", ".oga" },  VORBIS_BACKEND },
+};
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static const struct decoder_backend *backend_for(const char *path){
+    const size_t n = SDL_strlen(path);
+
+    for (size_t b = 0; b < SDL_arraysize(backends); b++) {
+        for (int e = 0; e < 3 && backends[b].extensions[e]; e++) {
+            const size_t m = SDL_strlen(backends[b].extensions[e]);
+            if (n >= m && SDL_strcasecmp(path + n - m, backends[b].extensions[e]) == 0)
+                return &backends[b];
+        }
+    }
+    return NULL;
+}
+
+static void *stream_main(void *arg){
+    struct decoder_stream *s = arg;
+    const int channels = s->dec.spec.channels;
+    const Uint64 mask = s->cap - 1;
+    Uint32 gen = 0;
+
+    while (!atomic_load_explicit(&s->stopping, memory_order_relaxed)) {
+        // a seek replaces whatever the ring holds
+        const Uint32 want = atomic_load_explicit(&s->want_gen, memory_order_acquire);
+        if (want != gen) {
+            const Uint64 frame = atomic_load_explicit(&s->want_frame, memory_order_relaxed);
+            const int failed = decoder_seek(&s->dec, frame) < 0;
+            if (failed)
+                fprintf(stderr, "decoder_seek failed: %s\n", SDL_GetError());
+
+            atomic_store_explicit(&s->written, 0, memory_order_relaxed);
+            atomic_store_explicit(&s->ended, failed, memory_order_relaxed);
+            gen = want;
+            atomic_store_explicit(&s->gen, gen, memory_order_release);
+            continue;
+        }
+
+        const Uint64 written = atomic_load_explicit(&s->written, memory_order_relaxed);
+        const Uint64 read = atomic_load_explicit(&s->read, memory_order_acquire);
+        const Uint64 used = (read < written) ? written - read : 0;
+        if (atomic_load_explicit(&s->ended, memory_order_relaxed) || s->cap - used < DECODER_CHUNK_FRAMES) {
+            SDL_WaitSemaphoreTimeout(s->wake, DECODER_IDLE_MS);
+            continue;
+        }
+
+        // up to the end of the ring; the next round continues at its start
+        const Uint64 slot = written & mask;
+        Uint64 n = s->cap - used;
+        if (n > s->cap - slot) n = s->cap - slot;
+        if (n > DECODER_CHUNK_FRAMES) n = DECODER_CHUNK_FRAMES;
+
+        const Uint64 got = decoder_read(&s->dec, s->ring + slot * channels, n);
+        if (got == 0) {
+            atomic_store_explicit(&s->ended, 1, memory_order_release);
+            continue;
+        }
+        atomic_store_explicit(&s->written, written + got, memory_order_release);
+    }
+    return NULL;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int decoder_handles(const char *path){
+    return backend_for(path) != NULL;
+}
+
+int decoder_open(struct decoder *d, const char *path){
+    SDL_zerop(d);
+
+    const struct decoder_backend *b = backend_for(path);
+    if (!b) {
+        SDL_SetError("no decoder for %s", path);
+        return -1;
+    }
+    if (!b->open) {
+        SDL_SetError("%s support was not built in (needs third_party/%s)", b->name, b->header);
+        return -1;
+    }
+    if (b->open(d, path) < 0)
+        return -1;
+    d->backend = b;
+
+    if (d->spec.channels < 1 || d->spec.freq <= 0) {
+        SDL_SetError("%s: %d channels at %d Hz", path, d->spec.channels, d->spec.freq);
+        decoder_close(d);
+        return -1;
+    }
+    return 0;
+}
+
+void decoder_close(struct decoder *d){
+    if (d->backend)
+        d->backend->close(d);
+    free(d->seek_table);
+    SDL_zerop(d);
+}
+
+Uint64 decoder_read(struct decoder *d, float *out, Uint64 frames){
+    return d->backend->read(d, out, frames);
+}
+
+int decoder_seek(struct decoder *d, Uint64 frame){
+    return d->backend->seek(d, frame);
+}
+
+const char *decoder_backends(void){
+    static char names[64];
+    if (names[0] == '\0') {
+        for (size_t b = 0; b < SDL_arraysize(backends); b++) {
+            if (!backends[b].open) continue;
+            if (names[0]) SDL_strlcat(names, " ", sizeof names);
+            SDL_strlcat(names, backends[b].name, sizeof names);
+        }
+    }
+    return names;
+}
+
+int decoder_stream_open(struct decoder_stream *s, const char *path){
+    SDL_zerop(s);
+    atomic_init(&s->read, 0);
+    atomic_init(&s->written, 0);
+    atomic_init(&s->want_gen, 0);
+    atomic_init(&s->want_frame, 0);
+    atomic_init(&s->gen, 0);
+    atomic_init(&s->ended, 0);
+    atomic_init(&s->stopping, 0);
+
+    if (decoder_open(&s->dec, path) < 0)
+        return -1;
+
+    s->cap = DECODER_CHUNK_FRAMES;
+    while (s->cap < (Uint64)s->dec.spec.freq * DECODER_RING_SECONDS)
+        s->cap *= 2;
+    s->ring = malloc(s->cap * s->dec.spec.channels * sizeof *s->ring);
+    s->wake = SDL_CreateSemaphore(0);
+    if (!s->ring || !s->wake) {
+        decoder_stream_close(s);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    if (pthread_create(&s->thread, NULL, stream_main, s) != 0) {
+        decoder_stream_close(s);
+        SDL_SetError("cannot start decoder thread");
+        return -1;
+    }
+    s->joinable = 1;
+    return 0;
+}
+
+void decoder_stream_close(struct decoder_stream *s){
+    if (s->joinable) {
+        atomic_store(&s->stopping, 1);
+        SDL_SignalSemaphore(s->wake);
+        pthread_join(s->thread, NULL);
+        s->joinable = 0;
+    }
+
+    if (s->wake)
+        SDL_DestroySemaphore(s->wake);
+    free(s->ring);
+    decoder_close(&s->dec);
+    s->wake = NULL;
+    s->ring = NULL;
+}
+
+void decoder_stream_seek(struct decoder_stream *s, Uint64 frame){
+    const Uint64 read = atomic_load_explicit(&s->read, memory_order_relaxed);
+    if (s->base + read == frame)
+        return;
+
+    s->base = frame;
+    atomic_store_explicit(&s->read, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->want_frame, frame, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->want_gen, 1, memory_order_release);
+    SDL_SignalSemaphore(s->wake);
+}
+
+Uint64 decoder_stream_peek(struct decoder_stream *s, const float **p){
+    if (atomic_load_explicit(&s->gen, memory_order_acquire)
+        != atomic_load_explicit(&s->want_gen, memory_order_relaxed))
+        return 0;
+
+    const Uint64 written = atomic_load_explicit(&s->written, memory_order_acquire);
+    const Uint64 read = atomic_load_explicit(&s->read, memory_order_relaxed);
+    const Uint64 slot = read & (s->cap - 1);
+
+    Uint64 n = written - read;
+    if (n > s->cap - slot) n = s->cap - slot;
+    *p = s->ring + slot * s->dec.spec.channels;
+    return n;
+}
+
+void decoder_stream_consume(struct decoder_stream *s, Uint64 frames){
+    const Uint64 read = atomic_load_explicit(&s->read, memory_order_relaxed);
+    atomic_store_explicit(&s->read, read + frames, memory_order_release);
+    SDL_SignalSemaphore(s->wake);
+}
+
+int decoder_stream_ended(struct decoder_stream *s){
+    if (atomic_load_explicit(&s->gen, memory_order_acquire)
+        != atomic_load_explicit(&s->want_gen, memory_order_relaxed))
+        return 0;
+    if (!atomic_load_explicit(&s->ended, memory_order_acquire))
+        return 0;
+
+    return atomic_load_explicit(&s->read, memory_order_relaxed)
+        == atomic_load_explicit(&s->written, memory_order_relaxed);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// PCM a decoder_stream buffers ahead, rounded up to a power of two frames
+#define DECODER_RING_SECONDS 2
+
+// frames decoded per read, the step in which the ring refills
+#define DECODER_CHUNK_FRAMES 4096
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+struct decoder_backend;
+
+/**
+ * decoder
+ *
+ * One compressed file opened through a vendored single-header decoder,
+ * used by one thread at a time:
+ * - spec:       what decoder_read produces, always interleaved f32
+ * - frames:     length of the track as the file states it
+ * - seek_table: seek points the backend was given, if it takes them
+ */
+struct decoder {
+    const struct decoder_backend *backend;
+    void *handle;
+    void *seek_table;
+    SDL_AudioSpec spec;
+    Uint64 frames;
+};
+
+/**
+ * decoder_stream
+ *
+ * A decoder on a worker thread of its own, filling a ring of PCM that
+ * the audio callback drains. Memory is fixed at DECODER_RING_SECONDS of
+ * PCM whatever the track length. One producer (the worker) and one
+ * consumer (the callback, or whoever holds the stream's lock), no locks:
+ * - ring, cap:   `cap` frames (a power of two) of interleaved f32
+ * - base:        track frame the consumer's last seek went to (consumer only)
+ * - read:        frames consumed since `base`, published by the consumer
+ * - written:     frames decoded since the seek in `gen`, published by the
+ *                worker after the samples
+ * - want_gen, want_frame: seek requests; the consumer stores the frame
+ *                and then bumps the generation with release semantics
+ * - gen:         request the ring holds data for; the consumer reads
+ *                nothing while it differs from want_gen
+ * - ended:       the decoder ran out for `gen`, published after `written`
+ * - wake:        posted by the consumer after every read and seek, the
+ *                worker sleeps on it while the ring is full
+ */
+struct decoder_stream {
+    struct decoder dec;
+    float *ring;
+    Uint64 cap;
+    Uint64 base;
+    _Atomic Uint64 read;
+    _Atomic Uint64 written;
+    _Atomic Uint32 want_gen;
+    _Atomic Uint64 want_frame;
+    _Atomic Uint32 gen;
+    _Atomic int ended;
+    SDL_Semaphore *wake;
+    pthread_t thread;
+    int joinable;
+    _Atomic int stopping;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+// 1 if `path` has the extension of a compressed format (whether or not it was built in)
+int decoder_handles(const char *path);
+
+/**
+ * Open `path` with the backend for its extension, at frame 0.
+ *
+ * @return 0 on success, -1 on failure or when the backend was not built
+ *         in (see SDL_GetError)
+ */
+int decoder_open(struct decoder *d, const char *path);
+
+void decoder_close(struct decoder *d);
+
+/**
+ * Decode up to `frames` frames into `out`.
+ *
+ * @return frames decoded, 0 at the end of the track
+ */
+Uint64 decoder_read(struct decoder *d, float *out, Uint64 frames);
+
+/**
+ * Continue decoding at `frame`.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int decoder_seek(struct decoder *d, Uint64 frame);
+
+// names of the backends built in, e.g. "FLAC MP3 Vorbis", "" for none
+const char *decoder_backends(void);
+
+/**
+ * Open `path` and start decoding it from frame 0 into a fresh ring.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int decoder_stream_open(struct decoder_stream *s, const char *path);
+
+// stop the worker and free the ring; safe to call more than once
+void decoder_stream_close(struct decoder_stream *s);
+
+/**
+ * Consumer side. None of these wait: a seek only posts the request, and
+ * peek hands out whatever is decoded at the read position right now.
+ */
+void decoder_stream_seek(struct decoder_stream *s, Uint64 frame);
+
+// frames readable at the read position, contiguous at *p
+Uint64 decoder_stream_peek(struct decoder_stream *s, const float **p);
+
+void decoder_stream_consume(struct decoder_stream *s, Uint64 frames);
+
+// 1 once everything up to the end of the track has been consumed
+int decoder_stream_ended(struct decoder_stream *s);
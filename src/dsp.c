@@ -0,0 +1,517 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "dsp.h"
+#include "sample.h"
+
+// filter state below this decays into denormals, which are slow on most FPUs
+#define DSP_DENORMAL 1e-15f
+
+typedef void (*eq_fn)(struct dsp_eq *eq, float *buf, int frames, int channels);
+
+static void eq_scalar(struct dsp_eq *eq, float *buf, int frames, int channels);
+
+static eq_fn eq_impl = eq_scalar;
+static const char *isa = "scalar";
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// Kernels
+// =============================================================================
+
+/*
+ * The cascade runs band by band over the whole block: a biquad's output
+ * depends on its previous one, so the parallelism is across channels, not
+ * frames. Coefficients and state then stay in registers for a block.
+ */
+static void eq_scalar(struct dsp_eq *eq, float *buf, int frames, int channels){
+    for (int b = 0; b < eq->bands; b++) {
+        const struct dsp_biquad k = eq->coef[b];
+        float *z1 = eq->z1[b], *z2 = eq->z2[b];
+
+        float *p = buf;
+        for (int i = 0; i < frames; i++) {
+            for (int c = 0; c < channels; c++, p++) {
+                const float x = *p;
+                const float y = k.b0 * x + z1[c];
+                z1[c] = k.b1 * x - k.a1 * y + z2[c];
+                z2[c] = k.b2 * x - k.a2 * y;
+                *p = y;
+            }
+        }
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+#define SSE2_INLINE static inline __attribute__((target("sse2"), always_inline))
+
+// the first `lanes` (4, 2 or 1) channels of a frame, the other lanes zero
+SSE2_INLINE __m128 load_lanes(const float *p, const int lanes){
+    if (lanes == 4)
+        return _mm_loadu_ps(p);
+    if (lanes == 2)
+        return _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p));
+    return _mm_load_ss(p);
+}
+
+SSE2_INLINE void store_lanes(float *p, __m128 v, const int lanes){
+    if (lanes == 4)
+        _mm_storeu_ps(p, v);
+    else if (lanes == 2)
+        _mm_storel_epi64((__m128i *)p, _mm_castps_si128(v));
+    else
+        _mm_store_ss(p, v);
+}
+
+// one band over `lanes` adjacent channels of every frame, starting at `p`
+SSE2_INLINE void biquad_lanes(const struct dsp_biquad *k, float *z1, float *z2, float *p,
+                              int frames, int channels, const int lanes){
+    const __m128 b0 = _mm_set1_ps(k->b0), b1 = _mm_set1_ps(k->b1), b2 = _mm_set1_ps(k->b2);
+    const __m128 a1 = _mm_set1_ps(k->a1), a2 = _mm_set1_ps(k->a2);
+    __m128 s1 = load_lanes(z1, lanes), s2 = load_lanes(z2, lanes);
+
+    for (int i = 0; i < frames; i++, p += channels) {
+        const __m128 x = load_lanes(p, lanes);
+        const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+        s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+        s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+        store_lanes(p, y, lanes);
+    }
+    store_lanes(z1, s1, lanes);
+    store_lanes(z2, s2, lanes);
+}
+
+/*
+ * Channels go into lanes four, then two, then one at a time: a stereo
+ * frame is one 64-bit load. Wider vectors would only add idle lanes for
+ * the layouts that matter, hence no AVX variant.
+ */
+__attribute__((target("sse2")))
+static void eq_sse2(struct dsp_eq *eq, float *buf, int frames, int channels){
+    for (int b = 0; b < eq->bands; b++) {
+        const struct dsp_biquad *k = &eq->coef[b];
+        int c = 0;
+        for (; c + 4 <= channels; c += 4)
+            biquad_lanes(k, eq->z1[b] + c, eq->z2[b] + c, buf + c, frames, channels, 4);
+        if (c + 2 <= channels) {
+            biquad_lanes(k, eq->z1[b] + c, eq->z2[b] + c, buf + c, frames, channels, 2);
+            c += 2;
+        }
+        if (c < channels)
+            biquad_lanes(k, eq->z1[b] + c, eq->z2[b] + c, buf + c, frames, channels, 1);
+    }
+}
+
+#endif
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2()) {
+        eq_impl = eq_sse2;
+        isa = "sse2";
+    }
+#endif
+}
+
+// one interleaved loader per sample format, instantiated from SAMPLE_FORMATS
+static inline __attribute__((always_inline))
+void load_interleaved(const Uint8 *p, int frames, int channels, float *out,
+                      float (*load)(const Uint8 *), const int size){
+    for (int i = 0; i < frames * channels; i++, p += size)
+        out[i] = load(p);
+}
+
+#define DEFINE_LOAD_INTERLEAVED(name, format)                                                  \
+    static void load_interleaved_##name(const Uint8 *p, int frames, int channels, float *out){ \
+        load_interleaved(p, frames, channels, out, load_##name, SDL_AUDIO_BYTESIZE(format));  \
+    }
+
+SAMPLE_FORMATS(DEFINE_LOAD_INTERLEAVED)
+
+static dsp_load_fn pick_load(SDL_AudioFormat format){
+#define PICK_LOAD_INTERLEAVED(name, fmt) \
+    if (format == fmt) return load_interleaved_##name;
+    SAMPLE_FORMATS(PICK_LOAD_INTERLEAVED)
+#undef PICK_LOAD_INTERLEAVED
+
+    return NULL;
+}
+
+// =============================================================================
+// Stages
+// =============================================================================
+
+// first, so the limiter catches what a boost pushes over the ceiling
+static void process_gain(struct dsp_chain *c, float *buf, int frames){
+    const int channels = c->channels;
+    const float from = c->gain, to = c->gain_target;
+    if (from == to) {
+        if (to != 1.0f)
+            for (int i = 0; i < frames * channels; i++)
+                buf[i] *= to;
+        return;
+    }
+
+    const float step = (to - from) / frames;
+    for (int i = 0; i < frames; i++, buf += channels) {
+        const float g = from + step * (i + 1);
+        for (int ch = 0; ch < channels; ch++)
+            buf[ch] *= g;
+    }
+    c->gain = to;
+}
+
+static void process_eq(struct dsp_chain *c, float *buf, int frames){
+    struct dsp_eq *eq = &c->eq;
+    if (eq->bands == 0)
+        return;
+
+    eq_impl(eq, buf, frames, c->channels);
+
+    // once per block is enough: decaying from here to a denormal takes far longer
+    for (int b = 0; b < eq->bands; b++)
+        for (int ch = 0; ch < c->channels; ch++) {
+            if (fabsf(eq->z1[b][ch]) < DSP_DENORMAL) eq->z1[b][ch] = 0.0f;
+            if (fabsf(eq->z2[b][ch]) < DSP_DENORMAL) eq->z2[b][ch] = 0.0f;
+        }
+}
+
+/*
+ * The output of frame n is input n - lookahead times the mean released
+ * gain of frames n - lookahead + 1 .. n. Each of those is at most the
+ * minimum gain wanted over a window of lookahead + 1 frames reaching back
+ * to the frame coming out, so the mean is too: the peak fits under the
+ * ceiling. The final clamp only catches rounding.
+ */
+static void process_limiter(struct dsp_chain *c, float *buf, int frames){
+    struct dsp_limiter *l = &c->limiter;
+    const int channels = c->channels, look = l->lookahead, window = look + 1;
+    const float ceiling = l->ceiling, release = l->release;
+    const double scale = 1.0 / look;
+
+    // a running sum drifts, so every block starts it over
+    double sum = 0.0;
+    for (int i = 0; i < look; i++)
+        sum += l->box[i];
+
+    for (int i = 0; i < frames; i++, buf += channels) {
+        float peak = 0.0f;
+        for (int ch = 0; ch < channels; ch++) {
+            const float v = fabsf(buf[ch]);
+            peak = (v > peak) ? v : peak;
+        }
+        const float want = (peak > ceiling) ? ceiling / peak : 1.0f;
+
+        // sliding minimum: drop what fell out of the window, then what `want`
+        // undercuts; what is left spans at most window - 1 frames, so it fits
+        while (l->min_count > 0 && l->now - l->min_time[l->min_head] >= (Uint32)window) {
+            if (++l->min_head == window) l->min_head = 0;
+            l->min_count--;
+        }
+        while (l->min_count > 0) {
+            int back = l->min_head + l->min_count - 1;
+            if (back >= window) back -= window;
+            if (l->min_gain[back] < want)
+                break;
+            l->min_count--;
+        }
+        int slot = l->min_head + l->min_count;
+        if (slot >= window) slot -= window;
+        l->min_gain[slot] = want;
+        l->min_time[slot] = l->now;
+        l->min_count++;
+
+        // instant attack (the look-ahead is the attack), exponential release
+        const float m = l->min_gain[l->min_head];
+        l->env = (m < l->env) ? m : m - (m - l->env) * release;
+
+        sum += l->env - l->box[l->box_pos];
+        l->box[l->box_pos] = l->env;
+        if (++l->box_pos == look) l->box_pos = 0;
+        const float gain = (float)(sum * scale);
+
+        float *d = l->delay + (size_t)l->delay_pos * channels;
+        for (int ch = 0; ch < channels; ch++) {
+            const float y = d[ch] * gain;
+            d[ch] = buf[ch];
+            buf[ch] = (y > ceiling) ? ceiling : (y < -ceiling) ? -ceiling : y;
+        }
+        if (++l->delay_pos == look) l->delay_pos = 0;
+        l->now++;
+    }
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+// RBJ audio EQ cookbook, normalized by a0
+static struct dsp_biquad design_band(const struct dsp_band *band, int freq){
+    const double f = fmin(band->freq, 0.49 * freq);
+    const double a = pow(10.0, band->gain_db / 40.0);
+    const double w0 = 2.0 * SDL_PI_D * f / freq;
+    const double cw = cos(w0);
+    const double alpha = sin(w0) / (2.0 * band->q);
+    const double sa = 2.0 * sqrt(a) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band->type) {
+    case DSP_LOW_SHELF:
+        b0 = a * ((a + 1) - (a - 1) * cw + sa);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cw);
+        b2 = a * ((a + 1) - (a - 1) * cw - sa);
+        a0 = (a + 1) + (a - 1) * cw + sa;
+        a1 = -2 * ((a - 1) + (a + 1) * cw);
+        a2 = (a + 1) + (a - 1) * cw - sa;
+        break;
+    case DSP_HIGH_SHELF:
+        b0 = a * ((a + 1) + (a - 1) * cw + sa);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cw);
+        b2 = a * ((a + 1) + (a - 1) * cw - sa);
+        a0 = (a + 1) - (a - 1) * cw + sa;
+        a1 = 2 * ((a - 1) - (a + 1) * cw);
+        a2 = (a + 1) - (a - 1) * cw - sa;
+        break;
+    default:
+        b0 = 1 + alpha * a;
+        b1 = -2 * cw;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cw;
+        a2 = 1 - alpha / a;
+        break;
+    }
+
+    return (struct dsp_biquad){
+        (float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0), (float)(a2 / a0),
+    };
+}
+
+/*
+ * Bring the stages in line with `p`. Bands that keep running keep their
+ * state, so moving a gain does not click; bands that start do so from rest.
+ */
+static void configure(struct dsp_chain *c, const struct dsp_params *p){
+    struct dsp_eq *eq = &c->eq;
+    const int bands = p->eq_on ? p->bands : 0;
+    for (int b = 0; b < bands; b++) {
+        eq->coef[b] = design_band(&p->band[b], c->freq);
+        if (b >= eq->bands) {
+            SDL_zeroa(eq->z1[b]);
+            SDL_zeroa(eq->z2[b]);
+        }
+    }
+    eq->bands = bands;
+
+    struct dsp_limiter *l = &c->limiter;
+    l->ceiling = p->limiter_on ? powf(10.0f, p->ceiling_db / 20.0f) : INFINITY;
+    l->release = (p->release_ms > 0.0f) ? expf(-1000.0f / (p->release_ms * (float)c->freq)) : 0.0f;
+}
+
+// take what the UI published last, unless it is writing right now
+static void apply_params(struct dsp_chain *c){
+    const Uint32 seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    if (seq == c->applied || (seq & 1))
+        return;
+
+    struct dsp_params p;
+    SDL_memcpy(&p, &c->published, sizeof p);
+    atomic_thread_fence(memory_order_acquire);
+    if (seq != atomic_load_explicit(&c->seq, memory_order_relaxed))
+        return;
+
+    c->applied = seq;
+    configure(c, &p);
+}
+
+static int parse_band(const char **s, struct dsp_band *b){
+    char *end;
+
+    b->type = DSP_PEAK;
+    if (**s == 'L' || **s == 'l')
+        b->type = DSP_LOW_SHELF;
+    else if (**s == 'H' || **s == 'h')
+        b->type = DSP_HIGH_SHELF;
+    if (b->type != DSP_PEAK)
+        (*s)++;
+    b->q = (b->type == DSP_PEAK) ? 1.0f : 0.707f;
+
+    b->freq = strtof(*s, &end);
+    if (end == *s || *end != ':' || b->freq <= 0.0f)
+        return -1;
+    *s = end + 1;
+
+    b->gain_db = strtof(*s, &end);
+    if (end == *s)
+        return -1;
+    *s = end;
+
+    if (**s == ':') {
+        (*s)++;
+        b->q = strtof(*s, &end);
+        if (end == *s || b->q <= 0.0f)
+            return -1;
+        *s = end;
+    }
+    return 0;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+void dsp_params_default(struct dsp_params *p){
+    SDL_zerop(p);
+    p->limiter_on = 1;
+    p->ceiling_db = DSP_CEILING_DB;
+    p->release_ms = DSP_RELEASE_MS;
+}
+
+int dsp_parse_eq(struct dsp_params *p, const char *spec){
+    struct dsp_band band[DSP_MAX_BANDS];
+    int bands = 0;
+    const char *s = spec;
+
+    while (*s) {
+        if (bands == DSP_MAX_BANDS) {
+            SDL_SetError("more than %d EQ bands", DSP_MAX_BANDS);
+            return -1;
+        }
+        if (parse_band(&s, &band[bands]) < 0 || (*s && *s != ',')) {
+            SDL_SetError("bad EQ band at \"%s\" (want [L|H]FREQ:GAIN_DB[:Q])", s);
+            return -1;
+        }
+        bands++;
+        if (*s == ',')
+            s++;
+    }
+    if (bands == 0) {
+        SDL_SetError("no EQ bands in \"%s\"", spec);
+        return -1;
+    }
+
+    SDL_memcpy(p->band, band, bands * sizeof *band);
+    p->bands = bands;
+    p->eq_on = 1;
+    return 0;
+}
+
+int dsp_chain_init(struct dsp_chain *c, SDL_AudioFormat format, int channels, int freq,
+                   const struct dsp_params *params, struct metrics *metrics){
+    SDL_zerop(c);
+    pthread_once(&dispatch_once, dispatch);
+
+    c->load = pick_load(format);
+    if (channels < 1 || channels > DSP_MAX_CHANNELS || freq <= 0 || !c->load) {
+        SDL_SetError("no DSP for %d channels at %d Hz", channels, freq);
+        return -1;
+    }
+    c->channels = channels;
+    c->freq = freq;
+
+    struct dsp_limiter *l = &c->limiter;
+    l->lookahead = (int)((Sint64)freq * DSP_LOOKAHEAD_MS / 1000);
+    if (l->lookahead < 1)
+        l->lookahead = 1;
+    l->delay = calloc((size_t)l->lookahead * channels, sizeof *l->delay);
+    l->min_gain = malloc((size_t)(l->lookahead + 1) * sizeof *l->min_gain);
+    l->min_time = malloc((size_t)(l->lookahead + 1) * sizeof *l->min_time);
+    l->box = malloc((size_t)l->lookahead * sizeof *l->box);
+    c->scratch = malloc((size_t)DSP_BLOCK_FRAMES * channels * sizeof *c->scratch);
+    if (!l->delay || !l->min_gain || !l->min_time || !l->box || !c->scratch) {
+        dsp_chain_free(c);
+        SDL_OutOfMemory();
+        return -1;
+    }
+    dsp_chain_reset(c);
+
+    c->gain = c->gain_target = 1.0f;
+
+    c->stages[c->count++] = (struct dsp_stage){ "gain", process_gain, NULL };
+    c->stages[c->count++] = (struct dsp_stage){ "eq", process_eq, metrics ? &metrics->dsp_eq : NULL };
+    c->stages[c->count++] = (struct dsp_stage){ "limiter", process_limiter,
+                                                metrics ? &metrics->dsp_limiter : NULL };
+
+    c->published = *params;
+    atomic_init(&c->seq, 0);
+    c->applied = 0;
+    configure(c, params);
+    return 0;
+}
+
+void dsp_chain_reset(struct dsp_chain *c){
+    struct dsp_eq *eq = &c->eq;
+    SDL_zeroa(eq->z1);
+    SDL_zeroa(eq->z2);
+
+    struct dsp_limiter *l = &c->limiter;
+    SDL_memset(l->delay, 0, (size_t)l->lookahead * c->channels * sizeof *l->delay);
+    l->delay_pos = 0;
+    l->min_head = 0;
+    l->min_count = 0;
+    for (int i = 0; i < l->lookahead; i++)
+        l->box[i] = 1.0f;
+    l->box_pos = 0;
+    l->env = 1.0f;
+}
+
+void dsp_chain_free(struct dsp_chain *c){
+    struct dsp_limiter *l = &c->limiter;
+    free(l->delay);
+    free(l->min_gain);
+    free(l->min_time);
+    free(l->box);
+    free(c->scratch);
+    l->delay = l->min_gain = l->box = c->scratch = NULL;
+    l->min_time = NULL;
+}
+
+void dsp_chain_set(struct dsp_chain *c, const struct dsp_params *params){
+    // same sequence lock as the spectrum's bands, but the reader never retries
+    atomic_fetch_add_explicit(&c->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    SDL_memcpy(&c->published, params, sizeof *params);
+    atomic_fetch_add_explicit(&c->seq, 1, memory_order_release);
+}
+
+void dsp_chain_set_gain(struct dsp_chain *c, float gain){
+    c->gain_target = gain;
+}
+
+void dsp_chain_process(struct dsp_chain *c, float *buf, int frames){
+    apply_params(c);
+
+    for (int s = 0; s < c->count; s++) {
+        const struct dsp_stage *stage = &c->stages[s];
+        if (!stage->cost) {
+            stage->process(c, buf, frames);
+            continue;
+        }
+
+        const Uint64 start_ns = SDL_GetTicksNS();
+        stage->process(c, buf, frames);
+        metrics_record(stage->cost, SDL_GetTicksNS() - start_ns);
+    }
+}
+
+const float *dsp_chain_run(struct dsp_chain *c, const Uint8 *p, int frames){
+    c->load(p, frames, c->channels, c->scratch);
+    dsp_chain_process(c, c->scratch, frames);
+    return c->scratch;
+}
+
+int dsp_chain_latency(const struct dsp_chain *c){
+    return c->limiter.lookahead;
+}
+
+const char *dsp_isa(void){
+    pthread_once(&dispatch_once, dispatch);
+    return isa;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+#include "metrics.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define DSP_MAX_BANDS 16
+
+#define DSP_MAX_CHANNELS 8
+
+#define DSP_MAX_STAGES 4
+
+// frames converted and processed at a time when the stream is not resampled
+#define DSP_BLOCK_FRAMES 512
+
+// how far the limiter looks ahead, which is also the delay it adds
+#define DSP_LOOKAHEAD_MS 2
+
+#define DSP_CEILING_DB (-1.0f)
+#define DSP_RELEASE_MS 100.0f
+
+typedef enum {
+    DSP_PEAK = 0,
+    DSP_LOW_SHELF,
+    DSP_HIGH_SHELF
+} dsp_band_type;
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * dsp_band
+ *
+ * One band of the equalizer, RBJ cookbook style:
+ * - freq:    center (peak) or corner (shelves) frequency in Hz
+ * - gain_db: boost or cut at `freq`
+ * - q:       bandwidth of a peak, slope of a shelf (0.707 is maximally steep
+ *            without overshoot)
+ */
+struct dsp_band {
+    dsp_band_type type;
+    float freq;
+    float gain_db;
+    float q;
+};
+
+/**
+ * dsp_params
+ *
+ * Everything the UI can change while playing; published as a whole with
+ * dsp_chain_set:
+ * - bands, band: the equalizer, applied in order while `eq_on`
+ * - ceiling_db:  highest peak the limiter lets through while `limiter_on`
+ * - release_ms:  time the limiter's gain takes to recover by ~63%
+ */
+struct dsp_params {
+    int bands;
+    struct dsp_band band[DSP_MAX_BANDS];
+    int eq_on;
+    int limiter_on;
+    float ceiling_db;
+    float release_ms;
+};
+
+// transposed direct form II, normalized so a0 = 1
+struct dsp_biquad {
+    float b0, b1, b2;
+    float a1, a2;
+};
+
+/**
+ * dsp_eq
+ *
+ * Cascade of `bands` biquads. The filter state is kept per band and
+ * channel, so the kernels run one band over a whole block at a time with
+ * the channels of a frame side by side in the lanes of a vector.
+ */
+struct dsp_eq {
+    int bands;
+    struct dsp_biquad coef[DSP_MAX_BANDS];
+    float z1[DSP_MAX_BANDS][DSP_MAX_CHANNELS];
+    float z2[DSP_MAX_BANDS][DSP_MAX_CHANNELS];
+};
+
+/**
+ * dsp_limiter
+ *
+ * Look-ahead peak limiter with a gain linked across channels. Every frame
+ * asks for the gain that keeps its peak under `ceiling`; the lowest such
+ * gain of the next `lookahead` + 1 frames, released exponentially and then
+ * averaged over `lookahead` frames, is applied to the frame leaving the
+ * delay line. The gain has thus reached a peak's level by the time that
+ * peak comes out, without a step:
+ * - ceiling:    linear, INFINITY while off (the delay line keeps running so
+ *               toggling changes neither the latency nor the position)
+ * - release:    per-frame coefficient of the gain's recovery
+ * - delay:      `lookahead` interleaved frames, oldest at `delay_pos`
+ * - min_gain, min_time, min_head, min_count: the sliding minimum, a
+ *               monotonic queue over a ring of `lookahead` + 1 entries
+ * - box, box_pos: the released gains of the last `lookahead` frames
+ * - env:        the released gain of the last frame
+ * - now:        frames processed, the time base of `min_time`
+ */
+struct dsp_limiter {
+    float ceiling;
+    float release;
+    int lookahead;
+    float *delay;
+    int delay_pos;
+    float *min_gain;
+    Uint32 *min_time;
+    int min_head;
+    int min_count;
+    float *box;
+    int box_pos;
+    float env;
+    Uint32 now;
+};
+
+struct dsp_chain;
+
+typedef void (*dsp_process_fn)(struct dsp_chain *c, float *buf, int frames);
+
+// interleaved f32 of `frames` interleaved frames of some format at `p`
+typedef void (*dsp_load_fn)(const Uint8 *p, int frames, int channels, float *out);
+
+/**
+ * dsp_stage
+ *
+ * One step of the chain, run in place on interleaved f32 blocks:
+ * - cost: where its time per block is recorded, or NULL
+ */
+struct dsp_stage {
+    const char *name;
+    dsp_process_fn process;
+    struct metrics_histogram *cost;
+};
+
+/**
+ * dsp_chain
+ *
+ * The processing between the tracks and the stream, owned by the audio
+ * callback once playing. The UI changes it only through dsp_chain_set:
+ * - stages:    run in order on every block
+ * - load:      converts the tracks' format for dsp_chain_run
+ * - scratch:   DSP_BLOCK_FRAMES frames of f32 for dsp_chain_run
+ * - published: parameters written by the UI under `seq` (odd while it
+ *              writes); the callback applies them at the start of a block
+ *              and just tries again on the next one when it catches a write
+ * - applied:   `seq` of the parameters in effect (callback only)
+ * - gain, gain_target: the track's normalization gain, and the one it
+ *              ramps to over the next block (callback only)
+ *
+ * Processing never allocates or waits.
+ */
+struct dsp_chain {
+    int channels;
+    int freq;
+    struct dsp_stage stages[DSP_MAX_STAGES];
+    int count;
+    struct dsp_eq eq;
+    struct dsp_limiter limiter;
+    dsp_load_fn load;
+    float *scratch;
+    struct dsp_params published;
+    _Atomic Uint32 seq;
+    Uint32 applied;
+    float gain;
+    float gain_target;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+// flat EQ with no bands, limiter on at DSP_CEILING_DB
+void dsp_params_default(struct dsp_params *p);
+
+/**
+ * Replace the bands of `p` with those in `spec`, a comma separated list of
+ * FREQ:GAIN_DB[:Q] peaks, where an L or H before FREQ makes the band a low
+ * or high shelf instead, e.g. "L120:3,2500:-2:1.4,H9000:2".
+ *
+ * @return 0 on success, -1 if `spec` does not parse (see SDL_GetError)
+ */
+int dsp_parse_eq(struct dsp_params *p, const char *spec);
+
+/**
+ * Set up `c` for `channels` channels of `format` at `freq` Hz with
+ * `params`. Stage costs go to `metrics` unless it is NULL.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int dsp_chain_init(struct dsp_chain *c, SDL_AudioFormat format, int channels, int freq,
+                   const struct dsp_params *params, struct metrics *metrics);
+
+void dsp_chain_free(struct dsp_chain *c);
+
+// empty the EQ's filter state and the limiter's delay line and gain history (callback, or with the stream locked)
+void dsp_chain_reset(struct dsp_chain *c);
+
+// publish `params` to the callback (one writer at a time)
+void dsp_chain_set(struct dsp_chain *c, const struct dsp_params *params);
+
+// scale by `gain` from the next block on, ramping there over that block (callback only)
+void dsp_chain_set_gain(struct dsp_chain *c, float gain);
+
+// run the stages on `frames` interleaved f32 frames at `buf`, in place
+void dsp_chain_process(struct dsp_chain *c, float *buf, int frames);
+
+/**
+ * Convert `frames` (at most DSP_BLOCK_FRAMES) frames of the chain's format
+ * at `p` and run the stages on them.
+ *
+ * @return the processed frames, valid until the next call
+ */
+const float *dsp_chain_run(struct dsp_chain *c, const Uint8 *p, int frames);
+
+// frames the chain delays its input by
+int dsp_chain_latency(const struct dsp_chain *c);
+
+// name of the kernel the equalizer dispatches to
+const char *dsp_isa(void);
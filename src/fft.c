@@ -0,0 +1,212 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "fft.h"
+
+/*
+ * One pass over all blocks of size 2h: x[k] + w*x[k+h] and x[k] - w*x[k+h]
+ * for the h twiddles w of the stage.
+ */
+typedef void (*fft_stage_fn)(float *re, float *im, const float *wr, const float *wi, int n, int h);
+
+static void stage_scalar(float *re, float *im, const float *wr, const float *wi, int n, int h);
+
+static fft_stage_fn stage_impl = stage_scalar;
+static int stage_width = 1;
+static const char *isa = "scalar";
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// Scalar
+// =============================================================================
+
+static void stage_scalar(float *re, float *im, const float *wr, const float *wi, int n, int h){
+    for (int k = 0; k < n; k += 2 * h) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + h, *bi = ai + h;
+        for (int j = 0; j < h; j++) {
+            const float tr = br[j] * wr[j] - bi[j] * wi[j];
+            const float ti = br[j] * wi[j] + bi[j] * wr[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+
+// =============================================================================
+// x86
+// =============================================================================
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * Split arrays make every butterfly lane independent: the vector kernels
+ * are the scalar loop four or eight j at a time, no shuffles needed. They
+ * are only used for stages with h of at least one vector.
+ */
+
+__attribute__((target("sse2")))
+static void stage_sse2(float *re, float *im, const float *wr, const float *wi, int n, int h){
+    for (int k = 0; k < n; k += 2 * h) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + h, *bi = ai + h;
+        for (int j = 0; j < h; j += 4) {
+            const __m128 xr = _mm_loadu_ps(br + j), xi = _mm_loadu_ps(bi + j);
+            const __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+            const __m128 yr = _mm_loadu_ps(ar + j), yi = _mm_loadu_ps(ai + j);
+            _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void stage_avx2(float *re, float *im, const float *wr, const float *wi, int n, int h){
+    for (int k = 0; k < n; k += 2 * h) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + h, *bi = ai + h;
+        for (int j = 0; j < h; j += 8) {
+            const __m256 xr = _mm256_loadu_ps(br + j), xi = _mm256_loadu_ps(bi + j);
+            const __m256 cr = _mm256_loadu_ps(wr + j), ci = _mm256_loadu_ps(wi + j);
+            const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, cr), _mm256_mul_ps(xi, ci));
+            const __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, ci), _mm256_mul_ps(xi, cr));
+            const __m256 yr = _mm256_loadu_ps(ar + j), yi = _mm256_loadu_ps(ai + j);
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(yr, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(yi, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(yr, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(yi, ti));
+        }
+    }
+}
+
+#endif
+
+// =============================================================================
+// Dispatch
+// =============================================================================
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasAVX2()) {
+        stage_impl = stage_avx2;
+        stage_width = 8;
+        isa = "avx2";
+    } else if (SDL_HasSSE2()) {
+        stage_impl = stage_sse2;
+        stage_width = 4;
+        isa = "sse2";
+    }
+#endif
+}
+
+static void bit_reverse(const struct fft *f, float *re, float *im){
+    for (int i = 0; i < f->n; i++) {
+        const Uint32 j = f->bitrev[i];
+        if (j > (Uint32)i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int fft_init(struct fft *f, int n){
+    SDL_zerop(f);
+    if (n < 2 || (n & (n - 1)) != 0) {
+        SDL_SetError("FFT size %d is not a power of two", n);
+        return -1;
+    }
+
+    f->n = n;
+    f->tw_re = malloc((size_t)(n - 1) * sizeof *f->tw_re);
+    f->tw_im = malloc((size_t)(n - 1) * sizeof *f->tw_im);
+    f->bitrev = malloc((size_t)n * sizeof *f->bitrev);
+    if (!f->tw_re || !f->tw_im || !f->bitrev) {
+        fft_free(f);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    for (int h = 1; h < n; h *= 2) {
+        for (int j = 0; j < h; j++) {
+            const double a = -SDL_PI_D * j / h;
+            f->tw_re[h - 1 + j] = (float)cos(a);
+            f->tw_im[h - 1 + j] = (float)sin(a);
+        }
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+    for (int i = 0; i < n; i++) {
+        Uint32 r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= (Uint32)((i >> b) & 1) << (bits - 1 - b);
+        f->bitrev[i] = r;
+    }
+    return 0;
+}
+
+void fft_free(struct fft *f){
+    free(f->tw_re);
+    free(f->tw_im);
+    free(f->bitrev);
+    f->tw_re = f->tw_im = NULL;
+    f->bitrev = NULL;
+}
+
+void fft_forward_scalar(const struct fft *f, float *re, float *im){
+    bit_reverse(f, re, im);
+    for (int h = 1; h < f->n; h *= 2)
+        stage_scalar(re, im, f->tw_re + h - 1, f->tw_im + h - 1, f->n, h);
+}
+
+void fft_forward(const struct fft *f, float *re, float *im){
+    pthread_once(&dispatch_once, dispatch);
+
+    bit_reverse(f, re, im);
+    for (int h = 1; h < f->n; h *= 2) {
+        const fft_stage_fn stage = (h >= stage_width) ? stage_impl : stage_scalar;
+        stage(re, im, f->tw_re + h - 1, f->tw_im + h - 1, f->n, h);
+    }
+}
+
+void fft_forward_with(const struct fft *f, const struct fft_kernel *k, float *re, float *im){
+    bit_reverse(f, re, im);
+    for (int h = 1; h < f->n; h *= 2) {
+        const fft_stage_fn stage = (h >= k->width) ? k->stage : stage_scalar;
+        stage(re, im, f->tw_re + h - 1, f->tw_im + h - 1, f->n, h);
+    }
+}
+
+const char *fft_isa(void){
+    pthread_once(&dispatch_once, dispatch);
+    return isa;
+}
+
+int fft_kernels(struct fft_kernel out[FFT_MAX_KERNELS]){
+    int n = 0;
+    out[n++] = (struct fft_kernel){ "scalar", 1, stage_scalar };
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2())
+        out[n++] = (struct fft_kernel){ "sse2", 4, stage_sse2 };
+    if (SDL_HasAVX2())
+        out[n++] = (struct fft_kernel){ "avx2", 8, stage_avx2 };
+#endif
+    return n;
+}
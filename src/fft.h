@@ -0,0 +1,79 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+/**
+ * fft
+ *
+ * Plan of an in-place radix-2 complex FFT of `n` points on split arrays
+ * (real parts in one array, imaginary parts in another):
+ * - tw_re, tw_im: exp(-i*pi*j/h) for every stage of half-size h, stored
+ *                 stage after stage at h - 1 + j, so each stage's
+ *                 butterflies load their twiddles contiguously
+ * - bitrev:       bit-reversed index of every input position
+ */
+struct fft {
+    int n;
+    float *tw_re;
+    float *tw_im;
+    Uint32 *bitrev;
+};
+
+/**
+ * Plan FFTs of `n` points, a power of two of at least 2.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int fft_init(struct fft *f, int n);
+
+void fft_free(struct fft *f);
+
+/**
+ * Forward transform of re[0..n) + i*im[0..n), in place and unnormalized.
+ * Butterflies run with the widest kernel the CPU supports (AVX2, SSE2,
+ * scalar), picked once at first use; stages narrower than a vector fall
+ * back to scalar.
+ */
+void fft_forward(const struct fft *f, float *re, float *im);
+
+/**
+ * fft_kernel
+ *
+ * One built-in implementation of the butterflies:
+ * - isa:   its name, as fft_isa() reports it
+ * - width: butterflies per vector; narrower stages run scalar
+ * - stage: one pass over all blocks of size 2h
+ */
+struct fft_kernel {
+    const char *isa;
+    int width;
+    void (*stage)(float *re, float *im, const float *wr, const float *wi, int n, int h);
+};
+
+// scalar, SSE2 and AVX2
+#define FFT_MAX_KERNELS 3
+
+/*
+ * Largest difference allowed between a bin of a vector kernel's transform
+ * and the scalar reference's, relative to the reference's largest bin.
+ * The kernels do the scalar arithmetic lane by lane, so they only differ
+ * where the compiler contracts the scalar loop differently.
+ */
+#define FFT_KERNEL_TOLERANCE 1e-6f
+
+// plain C reference the vector kernels are checked against (see bench.c)
+void fft_forward_scalar(const struct fft *f, float *re, float *im);
+
+// fft_forward on kernel `k` instead of the one the CPU dispatches to
+void fft_forward_with(const struct fft *f, const struct fft_kernel *k, float *re, float *im);
+
+// name of the kernel fft_forward dispatches to
+const char *fft_isa(void);
+
+/**
+ * Every kernel built in that this CPU can run, scalar first, so they can
+ * be checked against each other.
+ *
+ * @return how many were written to `out`
+ */
+int fft_kernels(struct fft_kernel out[FFT_MAX_KERNELS]);
@@ -0,0 +1,263 @@
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "kernels.h"
+
+typedef void (*s16_stats_fn)(const int16_t *samples, Uint64 n, struct s16_stats *out);
+typedef void (*s16_stats_stereo_fn)(const int16_t *samples, Uint64 frames, struct s16_stats out[2]);
+
+static s16_stats_fn s16_stats_impl = s16_stats_scalar;
+static s16_stats_stereo_fn s16_stats_stereo_impl = s16_stats_stereo_scalar;
+static const char *isa = "scalar";
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// Scalar
+// =============================================================================
+
+void s16_stats_scalar(const int16_t *samples, Uint64 n, struct s16_stats *out){
+    int lo = 0, hi = 0;
+    Uint64 sumsq = 0;
+
+    for (Uint64 i = 0; i < n; i++) {
+        int v = samples[i];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        sumsq += (Uint64)(v * v);
+    }
+
+    out->min = lo;
+    out->max = hi;
+    out->sumsq = sumsq;
+}
+
+void s16_stats_stereo_scalar(const int16_t *samples, Uint64 frames, struct s16_stats out[2]){
+    int lo[2] = {0, 0}, hi[2] = {0, 0};
+    Uint64 sumsq[2] = {0, 0};
+
+    for (Uint64 i = 0; i < frames; i++) {
+        for (int c = 0; c < 2; c++) {
+            int v = samples[2 * i + c];
+            if (v < lo[c]) lo[c] = v;
+            if (v > hi[c]) hi[c] = v;
+            sumsq[c] += (Uint64)(v * v);
+        }
+    }
+
+    for (int c = 0; c < 2; c++) {
+        out[c].min = lo[c];
+        out[c].max = hi[c];
+        out[c].sumsq = sumsq[c];
+    }
+}
+
+// =============================================================================
+// x86
+// =============================================================================
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * pmaddwd adds two squares per lane. That only overflows a signed 32-bit
+ * lane for (-32768, -32768), and never an unsigned one, so the lanes are
+ * zero-extended into 64-bit accumulators.
+ */
+
+__attribute__((target("sse2")))
+static void s16_stats_sse2(const int16_t *samples, Uint64 n, struct s16_stats *out){
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = zero, vmax = zero, acc = zero;
+
+    Uint64 i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+
+        __m128i sq = _mm_madd_epi16(v, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    int16_t lanes_min[8], lanes_max[8];
+    Uint64 lanes_acc[2];
+    _mm_storeu_si128((__m128i *)lanes_min, vmin);
+    _mm_storeu_si128((__m128i *)lanes_max, vmax);
+    _mm_storeu_si128((__m128i *)lanes_acc, acc);
+
+    struct s16_stats tail;
+    s16_stats_scalar(samples + i, n - i, &tail);
+
+    for (int k = 0; k < 8; k++) {
+        if (lanes_min[k] < tail.min) tail.min = lanes_min[k];
+        if (lanes_max[k] > tail.max) tail.max = lanes_max[k];
+    }
+    tail.sumsq += lanes_acc[0] + lanes_acc[1];
+    *out = tail;
+}
+
+/*
+ * Interleaved stereo keeps left samples in the even 16-bit lanes and right
+ * ones in the odd lanes, so min/max need no shuffling. For the squares,
+ * masking one channel to zero before pmaddwd leaves one square per lane.
+ */
+
+__attribute__((target("sse2")))
+static void s16_stats_stereo_sse2(const int16_t *samples, Uint64 frames, struct s16_stats out[2]){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i left = _mm_set1_epi32(0x0000FFFF);
+    const __m128i right = _mm_set1_epi32((int)0xFFFF0000u);
+    __m128i vmin = zero, vmax = zero, acc_l = zero, acc_r = zero;
+
+    Uint64 i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + 2 * i));
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+
+        __m128i sq_l = _mm_madd_epi16(v, _mm_and_si128(v, left));
+        __m128i sq_r = _mm_madd_epi16(v, _mm_and_si128(v, right));
+        acc_l = _mm_add_epi64(acc_l, _mm_unpacklo_epi32(sq_l, zero));
+        acc_l = _mm_add_epi64(acc_l, _mm_unpackhi_epi32(sq_l, zero));
+        acc_r = _mm_add_epi64(acc_r, _mm_unpacklo_epi32(sq_r, zero));
+        acc_r = _mm_add_epi64(acc_r, _mm_unpackhi_epi32(sq_r, zero));
+    }
+
+    int16_t lanes_min[8], lanes_max[8];
+    Uint64 lanes_l[2], lanes_r[2];
+    _mm_storeu_si128((__m128i *)lanes_min, vmin);
+    _mm_storeu_si128((__m128i *)lanes_max, vmax);
+    _mm_storeu_si128((__m128i *)lanes_l, acc_l);
+    _mm_storeu_si128((__m128i *)lanes_r, acc_r);
+
+    s16_stats_stereo_scalar(samples + 2 * i, frames - i, out);
+
+    for (int k = 0; k < 8; k++) {
+        if (lanes_min[k] < out[k & 1].min) out[k & 1].min = lanes_min[k];
+        if (lanes_max[k] > out[k & 1].max) out[k & 1].max = lanes_max[k];
+    }
+    out[0].sumsq += lanes_l[0] + lanes_l[1];
+    out[1].sumsq += lanes_r[0] + lanes_r[1];
+}
+
+__attribute__((target("avx2")))
+static void s16_stats_avx2(const int16_t *samples, Uint64 n, struct s16_stats *out){
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vmin = zero, vmax = zero, acc = zero;
+
+    Uint64 i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(samples + i));
+        vmin = _mm256_min_epi16(vmin, v);
+        vmax = _mm256_max_epi16(vmax, v);
+
+        __m256i sq = _mm256_madd_epi16(v, v);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sq, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sq, zero));
+    }
+
+    int16_t lanes_min[16], lanes_max[16];
+    Uint64 lanes_acc[4];
+    _mm256_storeu_si256((__m256i *)lanes_min, vmin);
+    _mm256_storeu_si256((__m256i *)lanes_max, vmax);
+    _mm256_storeu_si256((__m256i *)lanes_acc, acc);
+
+    struct s16_stats tail;
+    s16_stats_scalar(samples + i, n - i, &tail);
+
+    for (int k = 0; k < 16; k++) {
+        if (lanes_min[k] < tail.min) tail.min = lanes_min[k];
+        if (lanes_max[k] > tail.max) tail.max = lanes_max[k];
+    }
+    tail.sumsq += lanes_acc[0] + lanes_acc[1] + lanes_acc[2] + lanes_acc[3];
+    *out = tail;
+}
+
+__attribute__((target("avx2")))
+static void s16_stats_stereo_avx2(const int16_t *samples, Uint64 frames, struct s16_stats out[2]){
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i left = _mm256_set1_epi32(0x0000FFFF);
+    const __m256i right = _mm256_set1_epi32((int)0xFFFF0000u);
+    __m256i vmin = zero, vmax = zero, acc_l = zero, acc_r = zero;
+
+    Uint64 i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(samples + 2 * i));
+        vmin = _mm256_min_epi16(vmin, v);
+        vmax = _mm256_max_epi16(vmax, v);
+
+        __m256i sq_l = _mm256_madd_epi16(v, _mm256_and_si256(v, left));
+        __m256i sq_r = _mm256_madd_epi16(v, _mm256_and_si256(v, right));
+        acc_l = _mm256_add_epi64(acc_l, _mm256_unpacklo_epi32(sq_l, zero));
+        acc_l = _mm256_add_epi64(acc_l, _mm256_unpackhi_epi32(sq_l, zero));
+        acc_r = _mm256_add_epi64(acc_r, _mm256_unpacklo_epi32(sq_r, zero));
+        acc_r = _mm256_add_epi64(acc_r, _mm256_unpackhi_epi32(sq_r, zero));
+    }
+
+    int16_t lanes_min[16], lanes_max[16];
+    Uint64 lanes_l[4], lanes_r[4];
+    _mm256_storeu_si256((__m256i *)lanes_min, vmin);
+    _mm256_storeu_si256((__m256i *)lanes_max, vmax);
+    _mm256_storeu_si256((__m256i *)lanes_l, acc_l);
+    _mm256_storeu_si256((__m256i *)lanes_r, acc_r);
+
+    s16_stats_stereo_scalar(samples + 2 * i, frames - i, out);
+
+    for (int k = 0; k < 16; k++) {
+        if (lanes_min[k] < out[k & 1].min) out[k & 1].min = lanes_min[k];
+        if (lanes_max[k] > out[k & 1].max) out[k & 1].max = lanes_max[k];
+    }
+    out[0].sumsq += lanes_l[0] + lanes_l[1] + lanes_l[2] + lanes_l[3];
+    out[1].sumsq += lanes_r[0] + lanes_r[1] + lanes_r[2] + lanes_r[3];
+}
+
+#endif
+
+// =============================================================================
+// Dispatch
+// =============================================================================
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasAVX2()) {
+        s16_stats_impl = s16_stats_avx2;
+        s16_stats_stereo_impl = s16_stats_stereo_avx2;
+        isa = "avx2";
+    } else if (SDL_HasSSE2()) {
+        s16_stats_impl = s16_stats_sse2;
+        s16_stats_stereo_impl = s16_stats_stereo_sse2;
+        isa = "sse2";
+    }
+#endif
+}
+
+void s16_stats(const int16_t *samples, Uint64 n, struct s16_stats *out){
+    pthread_once(&dispatch_once, dispatch);
+    s16_stats_impl(samples, n, out);
+}
+
+void s16_stats_stereo(const int16_t *samples, Uint64 frames, struct s16_stats out[2]){
+    pthread_once(&dispatch_once, dispatch);
+    s16_stats_stereo_impl(samples, frames, out);
+}
+
+const char *kernels_isa(void){
+    pthread_once(&dispatch_once, dispatch);
+    return isa;
+}
+
+int s16_kernels(struct s16_kernel out[S16_MAX_KERNELS]){
+    int n = 0;
+    out[n++] = (struct s16_kernel){ "scalar", s16_stats_scalar, s16_stats_stereo_scalar };
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2())
+        out[n++] = (struct s16_kernel){ "sse2", s16_stats_sse2, s16_stats_stereo_sse2 };
+    if (SDL_HasAVX2())
+        out[n++] = (struct s16_kernel){ "avx2", s16_stats_avx2, s16_stats_stereo_avx2 };
+#endif
+    return n;
+}
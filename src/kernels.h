@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <SDL3/SDL.h>
+
+/**
+ * s16_stats
+ *
+ * Exact statistics of a run of signed 16-bit samples:
+ * - min, max: extremes of the run, 0 included (an empty run gives 0, 0)
+ * - sumsq:    sum of squared samples; exact, never rounded
+ */
+struct s16_stats {
+    int min;
+    int max;
+    Uint64 sumsq;
+};
+
+/**
+ * s16_kernel
+ *
+ * One built-in implementation of the stats kernels:
+ * - isa:          its name, as kernels_isa() reports it
+ * - mono, stereo: what s16_stats / s16_stats_stereo run on it
+ */
+struct s16_kernel {
+    const char *isa;
+    void (*mono)(const int16_t *samples, Uint64 n, struct s16_stats *out);
+    void (*stereo)(const int16_t *samples, Uint64 frames, struct s16_stats out[2]);
+};
+
+// scalar, SSE2 and AVX2
+#define S16_MAX_KERNELS 3
+
+/**
+ * Compute the stats of `n` samples with the widest kernel the CPU supports
+ * (AVX2, SSE2, scalar), picked once at first use. Every kernel works in
+ * integers, so all of them return exactly the same result: the tolerance
+ * against the scalar reference is zero, for min, max and sumsq alike.
+ */
+void s16_stats(const int16_t *samples, Uint64 n, struct s16_stats *out);
+
+// plain C reference the vector kernels are checked against (see bench.c)
+void s16_stats_scalar(const int16_t *samples, Uint64 n, struct s16_stats *out);
+
+/**
+ * Per-channel stats of `frames` interleaved stereo frames: out[0] is the
+ * left channel, out[1] the right one. Dispatched like s16_stats.
+ */
+void s16_stats_stereo(const int16_t *samples, Uint64 frames, struct s16_stats out[2]);
+void s16_stats_stereo_scalar(const int16_t *samples, Uint64 frames, struct s16_stats out[2]);
+
+// name of the kernel s16_stats dispatches to
+const char *kernels_isa(void);
+
+/**
+ * Every kernel built in that this CPU can run, scalar first, so they can
+ * be checked against each other.
+ *
+ * @return how many were written to `out`
+ */
+int s16_kernels(struct s16_kernel out[S16_MAX_KERNELS]);
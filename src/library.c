@@ -0,0 +1,306 @@
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "analysis.h"
+#include "audio.h"
+#include "decoder.h"
+#include "library.h"
+#include "pool.h"
+#include "waveform.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define LIBRARY_MAGIC "AUDINDX"
+#define LIBRARY_VERSION 1
+#define LIBRARY_ENDIAN 0x01020304u
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+struct path_list {
+    char **paths;
+    Uint64 count;
+    Uint64 cap;
+};
+
+/**
+ * scan_job
+ *
+ * The files being indexed, one pool item each. Every item only writes
+ * its own slot of `entries` / `sizes`, so nothing is shared:
+ * - sizes: bytes on disk of every file indexed, 0 for one that failed
+ */
+struct scan_job {
+    char **paths;
+    struct library_entry *entries;
+    Uint64 *sizes;
+};
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static int has_suffix(const char *s, const char *suffix){
+    const size_t n = SDL_strlen(s), m = SDL_strlen(suffix);
+    return n >= m && SDL_strcasecmp(s + n - m, suffix) == 0;
+}
+
+static int is_audio(const char *path){
+    return has_suffix(path, ".wav") || has_suffix(path, ".w64") || has_suffix(path, ".rf64")
+        || has_suffix(path, ".bw64") || decoder_handles(path);
+}
+
+static int add_path(struct path_list *l, const char *path){
+    if (l->count == l->cap) {
+        const Uint64 cap = l->cap ? l->cap * 2 : 256;
+        char **paths = realloc(l->paths, cap * sizeof *paths);
+        if (!paths) {
+            SDL_OutOfMemory();
+            return -1;
+        }
+        l->paths = paths;
+        l->cap = cap;
+    }
+
+    l->paths[l->count] = SDL_strdup(path);
+    if (!l->paths[l->count]) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    l->count++;
+    return 0;
+}
+
+static void free_paths(struct path_list *l){
+    for (Uint64 i = 0; i < l->count; i++)
+        SDL_free(l->paths[i]);
+    free(l->paths);
+    SDL_zerop(l);
+}
+
+// audio files under `dir`; symlinks are followed to files but not to directories
+static int walk(struct path_list *l, const char *dir){
+    DIR *d = opendir(dir);
+    if (!d) {
+        SDL_SetError("cannot open directory %s", dir);
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(d))) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+
+        char path[PATH_MAX];
+        if (snprintf(path, sizeof path, "%s/%s", dir, de->d_name) >= (int)sizeof path)
+            continue;
+
+        struct stat st;
+        if (lstat(path, &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            rc = walk(l, path);
+        else if ((S_ISREG(st.st_mode) || (S_ISLNK(st.st_mode) && stat(path, &st) == 0
+                                          && S_ISREG(st.st_mode))) && is_audio(path))
+            rc = add_path(l, path);
+    }
+
+    closedir(d);
+    return rc;
+}
+
+// same rules as the playlist's .m3u lists
+static int read_list(struct path_list *l, const char *list){
+    FILE *f = fopen(list, "r");
+    if (!f) {
+        SDL_SetError("cannot open list %s", list);
+        return -1;
+    }
+
+    const char *slash = strrchr(list, '/');
+    const int dir_len = slash ? (int)(slash - list) + 1 : 0;
+
+    char line[PATH_MAX];
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof line, f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        if (line[0] == '/' || dir_len == 0) {
+            rc = add_path(l, line);
+        } else {
+            char path[PATH_MAX * 2];
+            snprintf(path, sizeof path, "%.*s%s", dir_len, list, line);
+            rc = add_path(l, path);
+        }
+    }
+
+    fclose(f);
+    return rc;
+}
+
+static int compare_paths(const void *a, const void *b){
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static Uint8 to_byte(float v){
+    return (v >= 1.0f) ? 255 : (v <= 0.0f) ? 0 : (Uint8)(v * 255.0f + 0.5f);
+}
+
+// the summary reduced to what the index keeps
+static void fill_entry(struct library_entry *e, const struct waveform *wf, const struct audio_track *t){
+    SDL_zerop(e);
+    e->frames = wf->frames;
+    e->duration_ms = wf->frames * 1000 / (Uint64)t->spec.freq;
+    e->freq = (Uint32)t->spec.freq;
+    e->channels = (Uint16)t->spec.channels;
+    e->format = (Uint16)t->spec.format;
+    e->integrated = wf->loudness.integrated;
+    e->true_peak = wf->loudness.true_peak;
+    if (wf->frames == 0)
+        return;
+
+    float rms[LIBRARY_BARS], peaks[LIBRARY_BARS];
+    waveform_query(wf, -1, 0, wf->frames, 1, &e->rms, &e->peak);
+    waveform_query(wf, -1, 0, wf->frames, LIBRARY_BARS, rms, peaks);
+    for (int b = 0; b < LIBRARY_BARS; b++) {
+        e->peaks[b] = to_byte(peaks[b]);
+        e->levels[b] = to_byte(rms[b]);
+    }
+}
+
+// @return bytes on disk of the file at `path`, 0 if it could not be indexed
+static Uint64 analyze_file(const char *path, struct library_entry *e){
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "skipping %s: cannot stat\n", path);
+        return 0;
+    }
+
+    struct audio_track track;
+    SDL_zero(track);
+    if (audio_track_open(&track, path) < 0) {
+        fprintf(stderr, "skipping %s: %s\n", path, SDL_GetError());
+        return 0;
+    }
+
+    struct waveform wf;
+    const int rc = analysis_run(&wf, path, &track);
+    if (rc == 0)
+        fill_entry(e, &wf, &track);
+    else
+        fprintf(stderr, "skipping %s: %s\n", path, SDL_GetError());
+
+    waveform_free(&wf);
+    audio_track_close(&track);
+    return (rc == 0) ? (Uint64)st.st_size : 0;
+}
+
+static void analyze_files(void *ctx, Uint64 begin, Uint64 end){
+    const struct scan_job *job = ctx;
+    for (Uint64 i = begin; i < end; i++)
+        job->sizes[i] = analyze_file(job->paths[i], &job->entries[i]);
+}
+
+// entries whose size is not 0, written like a cache entry: to a temporary file renamed into place
+static int write_index(const char *out, const struct path_list *l, struct library_entry *entries,
+                       const Uint64 *sizes, Uint64 count){
+    struct library_header h;
+    SDL_zero(h);
+    SDL_memcpy(h.magic, LIBRARY_MAGIC, sizeof h.magic);
+    h.version = LIBRARY_VERSION;
+    h.endian = LIBRARY_ENDIAN;
+    h.count = count;
+    h.bars = LIBRARY_BARS;
+    h.entry_size = sizeof(struct library_entry);
+    for (Uint64 i = 0; i < l->count; i++) {
+        if (sizes[i] == 0)
+            continue;
+        entries[i].path = h.strings;
+        h.strings += SDL_strlen(l->paths[i]) + 1;
+    }
+
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof tmp, "%s.%ld.tmp", out, (long)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        SDL_SetError("cannot write %s", tmp);
+        return -1;
+    }
+
+    int ok = fwrite(&h, sizeof h, 1, f) == 1;
+    for (Uint64 i = 0; ok && i < l->count; i++)
+        if (sizes[i])
+            ok = fwrite(&entries[i], sizeof entries[i], 1, f) == 1;
+    for (Uint64 i = 0; ok && i < l->count; i++)
+        if (sizes[i])
+            ok = fwrite(l->paths[i], SDL_strlen(l->paths[i]) + 1, 1, f) == 1;
+
+    if (fclose(f) != 0 || !ok || rename(tmp, out) < 0) {
+        unlink(tmp);
+        SDL_SetError("cannot write index %s", out);
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int library_analyze(const char *input, const char *out, struct library_stats *stats){
+    SDL_zerop(stats);
+    const Uint64 start_ns = SDL_GetTicksNS();
+
+    struct path_list l;
+    SDL_zero(l);
+    struct stat st;
+    int rc = (stat(input, &st) == 0 && S_ISDIR(st.st_mode)) ? walk(&l, input) : read_list(&l, input);
+    if (rc < 0) {
+        free_paths(&l);
+        return -1;
+    }
+    // readdir order is arbitrary, the index should not be
+    qsort(l.paths, l.count, sizeof *l.paths, compare_paths);
+
+    struct library_entry *entries = calloc(l.count ? l.count : 1, sizeof *entries);
+    Uint64 *sizes = calloc(l.count ? l.count : 1, sizeof *sizes);
+    if (!entries || !sizes) {
+        free(entries);
+        free(sizes);
+        free_paths(&l);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    struct scan_job job = { l.paths, entries, sizes };
+    pool_parallel_for(l.count, 1, analyze_files, &job);
+
+    for (Uint64 i = 0; i < l.count; i++) {
+        if (sizes[i] == 0) {
+            stats->failed++;
+            continue;
+        }
+        stats->files++;
+        stats->bytes += sizes[i];
+    }
+
+    rc = write_index(out, &l, entries, sizes, stats->files);
+    stats->seconds = (SDL_GetTicksNS() - start_ns) / 1e9;
+    stats->threads = pool_threads();
+
+    free(entries);
+    free(sizes);
+    free_paths(&l);
+    return rc;
+}
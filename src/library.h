@@ -0,0 +1,98 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+/**
+ * Headless scan of a whole library into one compact index file, for
+ * `--analyze`. Files are spread over the thread pool, one per item; the
+ * chunks of a long file go through the pool too, so a few big files
+ * still keep every core busy.
+ */
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// overview bars kept per file
+#define LIBRARY_BARS 64
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * library_header
+ *
+ * Start of an index file, written in host byte order (`endian` catches
+ * an index read on a machine of the other order). It is followed by
+ * `count` library_entry records and a table of `strings` bytes holding
+ * their NUL-terminated paths.
+ */
+struct library_header {
+    char magic[8];
+    Uint32 version;
+    Uint32 endian;
+    Uint64 count;
+    Uint64 strings;
+    Uint32 bars;
+    Uint32 entry_size;
+};
+
+/**
+ * library_entry
+ *
+ * One file of the index:
+ * - path:        offset of its path in the string table
+ * - frames, freq, channels, format: the PCM as the player sees it
+ * - duration_ms: frames * 1000 / freq, rounded down
+ * - peak, rms:   whole track over all channels, 0..1
+ * - integrated, true_peak: EBU R128 loudness in LUFS and dBTP,
+ *                -INFINITY for silence
+ * - peaks, levels: peak and RMS of LIBRARY_BARS equal slices of the
+ *                track, 0..1 scaled to 0..255
+ */
+struct library_entry {
+    Uint64 path;
+    Uint64 frames;
+    Uint64 duration_ms;
+    Uint32 freq;
+    Uint16 channels;
+    Uint16 format;
+    float peak;
+    float rms;
+    float integrated;
+    float true_peak;
+    Uint8 peaks[LIBRARY_BARS];
+    Uint8 levels[LIBRARY_BARS];
+};
+
+/**
+ * library_stats
+ *
+ * What a scan got through:
+ * - files, failed: files indexed, and those that could not be read
+ * - bytes:         size on disk of the files indexed
+ * - seconds:       wall time from the first file opened to the index written
+ * - threads:       pool threads the files were spread over
+ */
+struct library_stats {
+    Uint64 files;
+    Uint64 failed;
+    Uint64 bytes;
+    double seconds;
+    int threads;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Index every audio file under the directory `input` (recursively, in
+ * path order) or listed in the file `input` (one path per line as in an
+ * .m3u, relative to the list's directory, # lines skipped) into `out`.
+ * Files that fail are reported on stderr and left out.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int library_analyze(const char *input, const char *out, struct library_stats *stats);
@@ -0,0 +1,506 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "loudness.h"
+#include "pool.h"
+#include "sample.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// frames converted to f32 at a time by a scan task
+#define SCAN_FRAMES 256
+
+// frames the true-peak bound is checked for at a time
+#define PEAK_FRAMES 64
+
+// frames before the current one the interpolator reads
+#define HISTORY (LOUDNESS_TP_TAPS - 1)
+
+// samples per pool task, large enough to make the pre-roll a small overhead
+#define SCAN_GRAIN_SAMPLES (256 * 1024)
+
+// hops per gating block (400 ms) and per short-term window (3 s)
+#define BLOCK_HOPS 4
+#define SHORT_TERM_HOPS 30
+
+#define ABSOLUTE_GATE_LUFS (-70.0)
+#define RELATIVE_GATE_LU (-10.0)
+#define RANGE_GATE_LU (-20.0)
+
+// filter state below this is flushed to zero, far under any 24-bit sample
+#define DENORMAL 1e-30
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+// one interleaved loader per sample format, instantiated from SAMPLE_FORMATS
+static inline __attribute__((always_inline))
+void load_interleaved(const Uint8 *p, int frames, int channels, float *out,
+                      float (*load)(const Uint8 *), const int size){
+    for (int i = 0; i < frames * channels; i++, p += size)
+        out[i] = load(p);
+}
+
+#define DEFINE_LOAD_INTERLEAVED(name, format)                                                  \
+    static void load_interleaved_##name(const Uint8 *p, int frames, int channels, float *out){ \
+        load_interleaved(p, frames, channels, out, load_##name, SDL_AUDIO_BYTESIZE(format));  \
+    }
+
+SAMPLE_FORMATS(DEFINE_LOAD_INTERLEAVED)
+
+static loudness_load_fn pick_load(SDL_AudioFormat format){
+#define PICK_LOAD_INTERLEAVED(name, fmt) \
+    if (format == fmt) return load_interleaved_##name;
+    SAMPLE_FORMATS(PICK_LOAD_INTERLEAVED)
+#undef PICK_LOAD_INTERLEAVED
+
+    return NULL;
+}
+
+/*
+ * K-weighting of BS.1770 at any rate: the pre-filter shelf and the RLB
+ * high-pass, with the analog prototypes the 48 kHz coefficients of the
+ * standard were derived from, bilinear-transformed for `freq`.
+ */
+static void design_k_weighting(struct loudness *l, int freq){
+    double f0 = 1681.974450955533, q = 0.7071752369554196;
+    const double vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double k = tan(M_PI * f0 / freq);
+    double a0 = 1.0 + k / q + k * k;
+    l->shelf[0] = (vh + vb * k / q + k * k) / a0;
+    l->shelf[1] = 2.0 * (k * k - vh) / a0;
+    l->shelf[2] = (vh - vb * k / q + k * k) / a0;
+    l->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+    l->shelf[4] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / freq);
+    a0 = 1.0 + k / q + k * k;
+    l->highpass[0] = 1.0;
+    l->highpass[1] = -2.0;
+    l->highpass[2] = 1.0;
+    l->highpass[3] = 2.0 * (k * k - 1.0) / a0;
+    l->highpass[4] = (1.0 - k / q + k * k) / a0;
+}
+
+/*
+ * Polyphase 4x interpolator: a Blackman-windowed sinc cut off at the
+ * original Nyquist frequency, phase p taking taps p, p + 4, ... Each phase
+ * is normalized to unity gain at DC.
+ */
+static void design_true_peak(struct loudness *l){
+    const int taps = LOUDNESS_TP_PHASES * LOUDNESS_TP_TAPS;
+    double h[LOUDNESS_TP_PHASES * LOUDNESS_TP_TAPS];
+    for (int n = 0; n < taps; n++) {
+        const double t = (n - (taps - 1) / 2.0) / LOUDNESS_TP_PHASES;
+        const double x = (n + 0.5) / taps;
+        h[n] = sin(M_PI * t) / (M_PI * t)
+             * (0.42 - 0.5 * cos(2.0 * M_PI * x) + 0.08 * cos(4.0 * M_PI * x));
+    }
+
+    l->tp_bound = 0.0f;
+    for (int p = 0; p < LOUDNESS_TP_PHASES; p++) {
+        double sum = 0.0, abs_sum = 0.0;
+        for (int j = 0; j < LOUDNESS_TP_TAPS; j++)
+            sum += h[j * LOUDNESS_TP_PHASES + p];
+        for (int j = 0; j < LOUDNESS_TP_TAPS; j++) {
+            l->tp[j][p] = (float)(h[j * LOUDNESS_TP_PHASES + p] / sum);
+            abs_sum += fabs(l->tp[j][p]);
+        }
+        // a hair over, so float rounding can never make the bound too tight
+        if (abs_sum * 1.0001 > l->tp_bound)
+            l->tp_bound = (float)(abs_sum * 1.0001);
+    }
+}
+
+// transposed direct form II on coefficients b0 b1 b2 a1 a2
+static inline double biquad(const double *f, double *z, double x){
+    const double y = f[0] * x + z[0];
+    z[0] = f[1] * x - f[3] * y + z[1];
+    z[1] = f[2] * x - f[4] * y;
+    return y;
+}
+
+/*
+ * BS.1770 channel weights for SDL's channel orders: surround and back
+ * channels count 1.41, the LFE (fourth from 5.1 on, third in 4.1) not at all.
+ */
+static double channel_weight(int channels, int c){
+    switch (channels) {
+    case 1: case 2: case 3:
+        return 1.0;
+    case 4:
+        return (c >= 2) ? 1.41 : 1.0;
+    case 5:
+        return (c == 2) ? 0.0 : (c >= 3) ? 1.41 : 1.0;
+    default:
+        return (c == 3) ? 0.0 : (c >= 4) ? 1.41 : 1.0;
+    }
+}
+
+static double to_lufs(double power){
+    return -0.691 + 10.0 * log10(power);
+}
+
+static int compare_floats(const void *a, const void *b){
+    const float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// =============================================================================
+// Kernels
+// =============================================================================
+
+typedef float (*peak_fn)(const struct loudness *l, const float *x, int n, int channels);
+
+static float interpolate_scalar(const struct loudness *l, const float *x, int n, int channels);
+
+static peak_fn interpolate_peak = interpolate_scalar;
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Highest interpolated sample of frames [0, n) at `x`, whose HISTORY
+ * frames before are readable. The phases sit side by side, so each tap is
+ * one multiply-add across all of them.
+ */
+static float interpolate_scalar(const struct loudness *l, const float *x, int n, int channels){
+    float peak = 0.0f;
+    for (int i = 0; i < n; i++, x += channels) {
+        for (int c = 0; c < channels; c++) {
+            float y[LOUDNESS_TP_PHASES] = { 0.0f };
+            for (int j = 0; j < LOUDNESS_TP_TAPS; j++) {
+                const float v = x[c - j * channels];
+                for (int p = 0; p < LOUDNESS_TP_PHASES; p++)
+                    y[p] += l->tp[j][p] * v;
+            }
+            for (int p = 0; p < LOUDNESS_TP_PHASES; p++) {
+                const float v = fabsf(y[p]);
+                peak = (v > peak) ? v : peak;
+            }
+        }
+    }
+    return peak;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * The four phases are the four lanes. Three sums over every third tap
+ * keep the adds from waiting on each other (LOUDNESS_TP_TAPS is 12).
+ */
+__attribute__((target("sse2")))
+static float interpolate_sse2(const struct loudness *l, const float *x, int n, int channels){
+    __m128 tap[LOUDNESS_TP_TAPS];
+    for (int j = 0; j < LOUDNESS_TP_TAPS; j++)
+        tap[j] = _mm_loadu_ps(l->tp[j]);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    __m128 peak = _mm_setzero_ps();
+    for (int i = 0; i < n; i++, x += channels) {
+        for (int c = 0; c < channels; c++) {
+            __m128 y0 = _mm_mul_ps(tap[0], _mm_set1_ps(x[c]));
+            __m128 y1 = _mm_mul_ps(tap[1], _mm_set1_ps(x[c - channels]));
+            __m128 y2 = _mm_mul_ps(tap[2], _mm_set1_ps(x[c - 2 * channels]));
+            for (int j = 3; j < LOUDNESS_TP_TAPS; j += 3) {
+                y0 = _mm_add_ps(y0, _mm_mul_ps(tap[j], _mm_set1_ps(x[c - j * channels])));
+                y1 = _mm_add_ps(y1, _mm_mul_ps(tap[j + 1], _mm_set1_ps(x[c - (j + 1) * channels])));
+                y2 = _mm_add_ps(y2, _mm_mul_ps(tap[j + 2], _mm_set1_ps(x[c - (j + 2) * channels])));
+            }
+            const __m128 y = _mm_add_ps(_mm_add_ps(y0, y1), y2);
+            peak = _mm_max_ps(peak, _mm_andnot_ps(sign, y));
+        }
+    }
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(peak);
+}
+
+#endif
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2())
+        interpolate_peak = interpolate_sse2;
+#endif
+}
+
+// =============================================================================
+// Scan
+// =============================================================================
+
+struct scan_job {
+    struct loudness *l;
+    const Uint8 *buf;
+    Uint64 first;
+    Uint64 frames;
+    Uint64 before;
+    Uint64 hop_first;
+};
+
+/*
+ * Raise `peak` to the highest true peak of frames [0, n) at `x`. Most
+ * windows are too quiet for the interpolator to beat the peak so far,
+ * whatever the signal in between: the bound skips those and leaves only
+ * the loud stretches.
+ */
+static float true_peak(const struct loudness *l, const float *x, int n, int channels, float peak){
+    for (int k = 0; k < n; k += PEAK_FRAMES) {
+        const int m = (n - k < PEAK_FRAMES) ? n - k : PEAK_FRAMES;
+        const float *s = x + (size_t)k * channels;
+
+        float window = 0.0f, sample = 0.0f;
+        for (int i = -HISTORY * channels; i < 0; i++) {
+            const float v = fabsf(s[i]);
+            window = (v > window) ? v : window;
+        }
+        for (int i = 0; i < m * channels; i++) {
+            const float v = fabsf(s[i]);
+            sample = (v > sample) ? v : sample;
+        }
+        window = (sample > window) ? sample : window;
+        peak = (sample > peak) ? sample : peak;
+
+        if (window * l->tp_bound > peak) {
+            const float v = interpolate_peak(l, s, m, channels);
+            peak = (v > peak) ? v : peak;
+        }
+    }
+    return peak;
+}
+
+/*
+ * One task: hops [begin, end) of the job, clipped to the frames it has.
+ * The filters start from rest up to l->preroll frames early and the
+ * interpolator's history from silence, exactly like the track itself.
+ */
+static void scan_hops(void *ctx, Uint64 begin, Uint64 end){
+    const struct scan_job *job = ctx;
+    struct loudness *l = job->l;
+    const int channels = l->spec.channels;
+    const Uint64 frame_size = SDL_AUDIO_FRAMESIZE(l->spec);
+
+    Uint64 pos = (job->hop_first + begin) * l->hop;
+    Uint64 stop = (job->hop_first + end) * l->hop;
+    if (pos < job->first) pos = job->first;
+    if (stop > job->first + job->frames) stop = job->first + job->frames;
+
+    const Uint64 seen = pos - (job->first - job->before);
+    Uint64 at = pos - ((seen < l->preroll) ? seen : l->preroll);
+
+    double z[LOUDNESS_MAX_CHANNELS][4];
+    float x[(HISTORY + SCAN_FRAMES) * LOUDNESS_MAX_CHANNELS];
+    SDL_memset(z, 0, sizeof z);
+    SDL_memset(x, 0, (size_t)HISTORY * channels * sizeof *x);
+    float *const cur = x + HISTORY * channels;
+    float peak = 0.0f;
+
+    while (at < stop) {
+        // a piece never straddles the start of the counted frames or a hop
+        const Uint64 hop = at / l->hop;
+        Uint64 limit = (at < pos) ? pos : (hop + 1) * l->hop;
+        if (limit > stop) limit = stop;
+        const int n = (limit - at < SCAN_FRAMES) ? (int)(limit - at) : SCAN_FRAMES;
+
+        const Uint8 *p = (at >= job->first) ? job->buf + (at - job->first) * frame_size
+                                            : job->buf - (job->first - at) * frame_size;
+        l->load(p, n, channels, cur);
+
+        double sum[LOUDNESS_MAX_CHANNELS] = { 0.0 };
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < channels; c++) {
+                const double s = biquad(l->shelf, &z[c][0], cur[i * channels + c]);
+                const double y = biquad(l->highpass, &z[c][2], s);
+                sum[c] += y * y;
+            }
+        }
+        for (int c = 0; c < channels; c++)
+            for (int k = 0; k < 4; k++)
+                if (fabs(z[c][k]) < DENORMAL) z[c][k] = 0.0;
+
+        if (at >= pos) {
+            for (int c = 0; c < channels; c++)
+                l->energy[hop * channels + c] += sum[c];
+            peak = true_peak(l, cur, n, channels, peak);
+            l->peak[hop] = (peak > l->peak[hop]) ? peak : l->peak[hop];
+        }
+
+        SDL_memmove(x, x + (size_t)n * channels, (size_t)HISTORY * channels * sizeof *x);
+        at += n;
+    }
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int loudness_init(struct loudness *l, Uint64 frames, const SDL_AudioSpec *spec){
+    SDL_zerop(l);
+    pthread_once(&dispatch_once, dispatch);
+
+    l->load = pick_load(spec->format);
+    if (!l->load || spec->channels < 1 || spec->channels > LOUDNESS_MAX_CHANNELS || spec->freq <= 0) {
+        SDL_SetError("loudness: unsupported format 0x%04x, %d channels at %d Hz",
+                     spec->format, spec->channels, spec->freq);
+        return -1;
+    }
+    l->spec = *spec;
+    l->frames = frames;
+    l->hop = (Uint64)spec->freq * LOUDNESS_HOP_MS / 1000;
+    if (l->hop == 0)
+        l->hop = 1;
+    l->hops = (frames + l->hop - 1) / l->hop;
+    l->preroll = (Uint64)spec->freq * LOUDNESS_PREROLL_MS / 1000;
+
+    if (l->hops > 0) {
+        l->energy = calloc(l->hops * spec->channels, sizeof *l->energy);
+        l->peak = calloc(l->hops, sizeof *l->peak);
+        if (!l->energy || !l->peak) {
+            loudness_free(l);
+            SDL_OutOfMemory();
+            return -1;
+        }
+    }
+
+    design_k_weighting(l, spec->freq);
+    design_true_peak(l);
+    return 0;
+}
+
+void loudness_free(struct loudness *l){
+    free(l->energy);
+    free(l->peak);
+    l->energy = NULL;
+    l->peak = NULL;
+}
+
+void loudness_scan(struct loudness *l, const Uint8 *buf, Uint64 first, Uint64 frames, Uint64 before){
+    if (first >= l->frames)
+        return;
+    if (frames > l->frames - first)
+        frames = l->frames - first;
+    if (frames == 0)
+        return;
+
+    const Uint64 hop_first = first / l->hop;
+    const Uint64 hop_last = (first + frames - 1) / l->hop;
+    struct scan_job job = { l, buf, first, frames, before, hop_first };
+    const Uint64 grain = SCAN_GRAIN_SAMPLES / (l->hop * l->spec.channels) + 1;
+    pool_parallel_for(hop_last - hop_first + 1, grain, scan_hops, &job);
+}
+
+int loudness_finish(const struct loudness *l, struct loudness_result *out){
+    out->integrated = -INFINITY;
+    out->range = 0.0f;
+    out->true_peak = -INFINITY;
+
+    float peak = 0.0f;
+    for (Uint64 h = 0; h < l->hops; h++)
+        peak = (l->peak[h] > peak) ? l->peak[h] : peak;
+    if (peak > 0.0f)
+        out->true_peak = 20.0f * log10f(peak);
+
+    // only whole hops make up blocks, a partial one at the end is left out
+    const Uint64 hops = l->frames / l->hop;
+    if (hops < BLOCK_HOPS)
+        return 0;
+
+    double *power = malloc(hops * sizeof *power);
+    float *range = malloc(hops * sizeof *range);
+    if (!power || !range) {
+        free(power);
+        free(range);
+        SDL_OutOfMemory();
+        return -1;
+    }
+    const int channels = l->spec.channels;
+    for (Uint64 h = 0; h < hops; h++) {
+        double sum = 0.0;
+        for (int c = 0; c < channels; c++)
+            sum += channel_weight(channels, c) * l->energy[h * channels + c];
+        power[h] = sum;
+    }
+
+    // blocks overlap by 75%, a block starting at every hop
+    const double absolute = pow(10.0, (ABSOLUTE_GATE_LUFS + 0.691) / 10.0);
+    const double block_scale = 1.0 / (BLOCK_HOPS * (double)l->hop);
+    double gated = 0.0;
+    Uint64 count = 0;
+    for (Uint64 j = 0; j + BLOCK_HOPS <= hops; j++) {
+        double z = 0.0;
+        for (int k = 0; k < BLOCK_HOPS; k++)
+            z += power[j + k];
+        z *= block_scale;
+        if (z > absolute) {
+            gated += z;
+            count++;
+        }
+    }
+    if (count > 0) {
+        const double relative = gated / count * pow(10.0, RELATIVE_GATE_LU / 10.0);
+        double sum = 0.0;
+        Uint64 n = 0;
+        for (Uint64 j = 0; j + BLOCK_HOPS <= hops; j++) {
+            double z = 0.0;
+            for (int k = 0; k < BLOCK_HOPS; k++)
+                z += power[j + k];
+            z *= block_scale;
+            if (z > absolute && z > relative) {
+                sum += z;
+                n++;
+            }
+        }
+        out->integrated = (float)to_lufs(sum / n);
+    }
+
+    // loudness range: spread of the gated short-term loudness, 10th to 95th percentile
+    const double short_scale = 1.0 / (SHORT_TERM_HOPS * (double)l->hop);
+    gated = 0.0;
+    count = 0;
+    for (Uint64 j = 0; j + SHORT_TERM_HOPS <= hops; j++) {
+        double z = 0.0;
+        for (int k = 0; k < SHORT_TERM_HOPS; k++)
+            z += power[j + k];
+        z *= short_scale;
+        if (z > absolute) {
+            gated += z;
+            range[count++] = (float)to_lufs(z);
+        }
+    }
+    if (count > 0) {
+        const float relative = (float)(to_lufs(gated / count) + RANGE_GATE_LU);
+        Uint64 n = 0;
+        for (Uint64 i = 0; i < count; i++)
+            if (range[i] > relative)
+                range[n++] = range[i];
+        qsort(range, n, sizeof *range, compare_floats);
+        const float lo = range[(Uint64)((n - 1) * 0.10 + 0.5)];
+        const float hi = range[(Uint64)((n - 1) * 0.95 + 0.5)];
+        out->range = hi - lo;
+    }
+
+    free(power);
+    free(range);
+    return 0;
+}
+
+float loudness_gain(const struct loudness_result *r, float target_lufs){
+    if (!isfinite(r->integrated))
+        return 1.0f;
+
+    float db = target_lufs - r->integrated;
+    const float headroom = LOUDNESS_PEAK_CEILING_DBTP - r->true_peak;
+    if (db > headroom)
+        db = headroom;
+    return powf(10.0f, db / 20.0f);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define LOUDNESS_MAX_CHANNELS 16
+
+// gating blocks are four hops (400 ms), short-term windows thirty (3 s)
+#define LOUDNESS_HOP_MS 100
+
+// frames a scan runs its filters on before the first one it counts
+#define LOUDNESS_PREROLL_MS 100
+
+// ReplayGain 2.0 reference level, what --normalize aims for by default
+#define LOUDNESS_TARGET_LUFS (-18.0f)
+
+// normalization never lifts the true peak above this
+#define LOUDNESS_PEAK_CEILING_DBTP (-1.0f)
+
+// true-peak interpolator: 4x oversampling (one phase per lane of an SSE
+// vector), taps per phase
+#define LOUDNESS_TP_PHASES 4
+#define LOUDNESS_TP_TAPS 12
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * loudness_result
+ *
+ * EBU R128 measurement of a whole track (ITU-R BS.1770-4, EBU Tech 3342):
+ * - integrated: gated programme loudness in LUFS, -INFINITY when no
+ *               400 ms block rises above the absolute gate (silence, or
+ *               shorter than a block)
+ * - range:      loudness range (LRA) in LU
+ * - true_peak:  highest 4x oversampled sample in dBTP
+ */
+struct loudness_result {
+    float integrated;
+    float range;
+    float true_peak;
+};
+
+// f32 of `frames` interleaved frames at `p`, interleaved into `out`
+typedef void (*loudness_load_fn)(const Uint8 *p, int frames, int channels, float *out);
+
+/**
+ * loudness
+ *
+ * Measurement in progress. The track is cut into hops of LOUDNESS_HOP_MS;
+ * what the gates and windows need is the K-weighted energy of every hop
+ * and channel, and those sums are independent of each other. So scans
+ * run in parallel over ranges of hops, each warming its filters up on the
+ * LOUDNESS_PREROLL_MS before its range, which leaves the result equal to
+ * one sequential pass to well below the precision reported:
+ * - hop:       frames per hop
+ * - energy:    `hops` x `channels` sums of squared K-weighted samples
+ * - peak:      highest interpolated sample the scan covering a hop had
+ *              found by its end; the largest of them is the true peak
+ * - shelf, highpass: K-weighting stages as biquads (b0 b1 b2 a1 a2)
+ * - tp, tp_bound: interpolator taps, phases side by side, and the largest
+ *              sum of absolute taps of a phase, bounding what it can make of
+ *              a window
+ */
+struct loudness {
+    SDL_AudioSpec spec;
+    Uint64 frames;
+    Uint64 hop;
+    Uint64 hops;
+    Uint64 preroll;
+    double *energy;
+    float *peak;
+    double shelf[5];
+    double highpass[5];
+    float tp[LOUDNESS_TP_TAPS][LOUDNESS_TP_PHASES];
+    float tp_bound;
+    loudness_load_fn load;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Get `l` ready to measure `frames` frames of `spec`, nothing scanned yet.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int loudness_init(struct loudness *l, Uint64 frames, const SDL_AudioSpec *spec);
+
+void loudness_free(struct loudness *l);
+
+/**
+ * Scan frames [first, first + frames) at `buf`, spread over the thread
+ * pool. The `before` frames preceding `buf` must be readable too (as many
+ * as the caller has, up to l->preroll). Ranges must not overlap but may
+ * come in any order and split hops anywhere.
+ */
+void loudness_scan(struct loudness *l, const Uint8 *buf, Uint64 first, Uint64 frames, Uint64 before);
+
+/**
+ * Gate and summarize what was scanned into `out`.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int loudness_finish(const struct loudness *l, struct loudness_result *out);
+
+/**
+ * Linear gain that brings `r` to `target_lufs`, reduced as far as needed
+ * to keep the true peak under LOUDNESS_PEAK_CEILING_DBTP; 1 for a track
+ * without a measurable loudness.
+ */
+float loudness_gain(const struct loudness_result *r, float target_lufs);
@@ -1,15 +1,32 @@
 #include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h> 
 #include <SDL3_image/SDL_image.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+#include "analysis.h"
+#include "audio.h"
+#include "cache.h"
 #include "debug.h"
+#include "decoder.h"
+#include "dsp.h"
+#include "library.h"
+#include "loudness.h"
+#include "metrics.h"
+#include "mixer.h"
+#include "wav.h"
+#include "playlist.h"
+#include "pool.h"
+#include "resample.h"
+#include "spectrum.h"
+#include "waveform.h"
 
 // =============================================================================
 // Constants
@@ -17,39 +34,32 @@
 
 #define RUNNING 1
 #define STOPPED 0
-#define WAV_HEADER_SIZE 44
-#define MAX_HEADER_SIZE 44
+
+// how often an idle, paused UI looks for analysis progress
+#define ANALYSIS_POLL_MS 100
+
+// crossfade after a seek unless --seek-fade says otherwise
+#define SEEK_FADE_MS 5
+
+// live preview while dragging the timeline: at most one seek this often
+#define SCRUB_INTERVAL_MS 40
 
 #define BG_COLOR 209, 229, 244, 255
 #define GRAPHIC_COLOR 22, 30, 26, 255
+#define UNPLAYED_COLOR 110, 125, 135, 255
 #define TIME_COUNTER_COLOR 0, 0, 0, 255
+#define SPECTRUM_COLOR 22, 30, 26, 110
+
+// alpha of the "not analyzed yet" markers, tinted like the bars around them
+#define PLACEHOLDER_ALPHA 90
+
+// counts a render call towards the per-frame draw call tally
+#define DRAW(call) (frame_draw_calls++, (call))
 
 // =============================================================================
 // Structs
 // =============================================================================
 
-struct audio_buffer{
-    Uint32 len;
-    Uint8 *buf;
-    Uint32 pos;
-    SDL_AudioSpec spec; 
-};
-
-/**
- * audio_track_time
- *
- * Snapshot of playback timing in whole seconds:
- * - elapsed_sec:   seconds played since the start (0..total_sec)
- * - remaining_sec: seconds left until the end (0..total_sec), typically for countdown UI
- * - total_sec:     total duration in seconds
- */
-typedef struct audio_track_time {
-    int elapsed_sec;
-    int remaining_sec;
-    int total_sec;
-} audio_track_time;
-
-
 //The drag_kind enum represent drag on a different buttons  
 typedef enum {
     DRAG_NONE = 0,
@@ -57,19 +67,64 @@ typedef enum {
     DRAG_VOLUME
 } drag_kind;
 
+/**
+ * latency_mode
+ *
+ * Device buffer size picked with --latency, traded against wakeups:
+ * - sample_frames: value for SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES
+ */
+struct latency_mode {
+    const char *name;
+    const char *sample_frames;
+};
+
 typedef struct {
     audio_track_time track_time;
     drag_kind drag;
     SDL_FRect timeline_btn;
     SDL_FRect volume_btn;
     float slider_pos;
+    int track;
+    int next;
+    int next_queued;
+    const struct waveform *waveform;
+    Uint64 waveform_ready;
     float *rms; 
+    int rms_lanes;
     int rms_count;
+    int rms_ready;
+    SDL_FRect *bar_rects;
+    int waveform_dirty;
+    int draw_calls;
+    audio_track_time shown_time;
+    Uint64 frame_allocations;
+    int show_metrics;
+    int show_spectrum;
+    Uint32 spectrum_seq;
+    float spectrum_bands[SPECTRUM_BANDS];
+    SDL_FRect spectrum_rects[SPECTRUM_BANDS];
 } AppState;
 
 void init_state(AppState *state){
     state->drag = DRAG_NONE;
+    state->track = -1;
+    state->next = -1;
+    state->next_queued = 0;
+    state->waveform = NULL;
+    state->waveform_ready = 0;
     state->rms = NULL;
+    state->rms_lanes = 0;
+    state->rms_count = 0;
+    state->rms_ready = 0;
+    state->bar_rects = NULL;
+    state->waveform_dirty = 1;
+    state->draw_calls = 0;
+    state->shown_time = (audio_track_time){ -1, -1, -1, 0, 0 };
+    state->frame_allocations = 0;
+    state->show_metrics = 0;
+    state->show_spectrum = 0;
+    state->spectrum_seq = 0;
+    SDL_zeroa(state->spectrum_bands);
 }
 
 // =============================================================================
@@ -105,6 +160,10 @@ TTF_Font *ttf_font = NULL;
 TTF_TextEngine *ttf_engine = NULL;
 static int ttf_font_size = 20;
 
+// elapsed / remaining counters, kept alive and only re-set when they change
+static TTF_Text *txt_elapsed = NULL;
+static TTF_Text *txt_remaining = NULL;
+
 static SDL_FRect r_volumebar;
 static int volumebar_padding_x = 50;
 static int volumebar_length = 90;
@@ -120,26 +179,103 @@ static int play_btn_weight = 50;
 static SDL_Texture *pause_icon = NULL;
 static SDL_Texture *play_icon = NULL;
 
+static int graphic_padding_y = 150;
+static const int bar_width = 2;
+static const int bar_gap = 1;
+
+// the bars, drawn once per layout and only tinted and blitted per frame
+static SDL_Texture *waveform_tex = NULL;
+static int waveform_tex_w = 0;
+static int waveform_tex_h = 0;
+
+enum { KNOB_TIMELINE, KNOB_VOLUME, KNOB_COUNT };
+static SDL_Texture *knob_atlas = NULL;
+static SDL_FRect knob_uv[KNOB_COUNT];
+
+static int frame_draw_calls = 0;
+
+// one display refresh, how often a playing track is checked for movement
+static Sint32 frame_ms = 16;
+
+static SDL_malloc_func real_malloc;
+static SDL_calloc_func real_calloc;
+static SDL_realloc_func real_realloc;
+static SDL_free_func real_free;
+
+// SDL heap allocations made by the current thread, see count_allocations
+static _Thread_local Uint64 sdl_allocations = 0;
+
 static int WINDOW_WIDTH = 800;
 static int WINDOW_HEIGHT = 600;
+static const int MIN_WINDOW_WIDTH = 500;
+static const int MIN_WINDOW_HEIGHT = 450;
+static const int MAX_WAVEFORM_LANES = 8;
 
 static char *progname;
-static char *audio_file_path;
+static struct playlist playlist;
 
 static SDL_AudioStream *stream = NULL;
 
 static SDL_AudioDeviceID audio_devid;
+static SDL_AudioSpec device_spec;
+static int device_frames;
+static struct resampler resampler;
+static int resampler_quality = RESAMPLE_MEDIUM;
+static struct dsp_chain dsp;
+static struct dsp_params dsp_params;
+static int dsp_enabled = 1;
+static int normalize = 1;
+static float normalize_lufs = LOUDNESS_TARGET_LUFS;
+static const char *analyze_path = NULL;
+static const char *index_path = "library.idx";
+static int thumb_width = 0, thumb_height = 0;
+static const char *thumb_dir = NULL;
+static int mix_mode = 0;
 
-pthread_mutex_t audio_mu = PTHREAD_MUTEX_INITIALIZER;
 struct audio_buffer *audio = NULL;
 
+static struct metrics metrics;
+static struct spectrum spectrum;
+static const char *metrics_path = NULL;
+static int seek_fade_ms = SEEK_FADE_MS;
+
+static const struct latency_mode latency_modes[] = {
+    { "low",      "256"  },   // ~5 ms at 48 kHz
+    { "balanced", "1024" },   // ~21 ms, close to SDL's own default
+    { "power",    "4096" },   // ~85 ms, few wakeups
+};
+static const struct latency_mode *latency = &latency_modes[1];
+
 // =============================================================================
-// Some declarations
+// Allocation counting
 // =============================================================================
 
-float *calculate_peaks(int16_t *samples, int windows, int window_samples);
-float *calculate_rms(int16_t *samples, int windows, int window_samples); 
-static audio_track_time calculate_audio_track_time(const struct audio_buffer *a);
+static void *counting_malloc(size_t size){
+    sdl_allocations++;
+    return real_malloc(size);
+}
+
+static void *counting_calloc(size_t nmemb, size_t size){
+    sdl_allocations++;
+    return real_calloc(nmemb, size);
+}
+
+static void *counting_realloc(void *mem, size_t size){
+    sdl_allocations++;
+    return real_realloc(mem, size);
+}
+
+/**
+ * Route SDL's allocator (used by SDL_ttf and SDL_image too) through
+ * counters, so render_screen can tell whether a frame hit the heap. The
+ * count is per thread: the audio thread's allocations don't show up in the
+ * UI's. Must run before SDL allocates anything.
+ */
+static void count_allocations(void){
+    SDL_GetOriginalMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+    if (!SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, real_free))
+        fprintf(stderr, "SDL_SetMemoryFunctions failed: %s\n", SDL_GetError());
+}
 
 // =============================================================================
 // Render 
@@ -159,145 +295,449 @@ static inline int center_y(int y, int h, int inner_h) {
     return y + (h - inner_h) / 2;
 }
 
-int SDL_RenderFillCircle(SDL_Renderer * renderer, int x, int y, int radius){
-    int offsetx, offsety, d;
-    int status;
-
-    offsetx = 0;
-    offsety = radius;
-    d = radius -1;
-    status = 0;
-
-    while (offsety >= offsetx) {
-        status += SDL_RenderLine(renderer, x - offsety, y + offsetx,
-                                     x + offsety, y + offsetx);
-        status += SDL_RenderLine(renderer, x - offsetx, y + offsety,
-                                     x + offsetx, y + offsety);
-        status += SDL_RenderLine(renderer, x - offsetx, y - offsety,
-                                     x + offsetx, y - offsety);
-        status += SDL_RenderLine(renderer, x - offsety, y - offsetx,
-                                     x + offsety, y - offsetx);
-
-        if (status < 0) {
-            status = -1;
-            break;
-        }
+static SDL_FColor fcolor(Uint8 r, Uint8 g, Uint8 b, Uint8 a){
+    return (SDL_FColor){ r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f };
+}
 
-        if (d >= 2*offsetx) {
-            d -= 2*offsetx + 1;
-            offsetx +=1;
-        }
-        else if (d < 2 * (radius - offsety)) {
-            d += 2 * offsety - 1;
-            offsety -= 1;
-        }
-        else {
-            d += 2 * (offsety - offsetx - 1);
-            offsety -= 1;
-            offsetx += 1;
+/**
+ * Append quad `n` to a vertex / index batch: `dst` on screen, `uv` the part
+ * of the texture it shows (0..1), tinted by `color`.
+ */
+static void push_quad(SDL_Vertex *v, int *idx, int n, SDL_FRect dst, SDL_FRect uv, SDL_FColor color){
+    static const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+    SDL_Vertex *q = v + 4 * n;
+
+    q[0] = (SDL_Vertex){ { dst.x,         dst.y         }, color, { uv.x,        uv.y        } };
+    q[1] = (SDL_Vertex){ { dst.x + dst.w, dst.y         }, color, { uv.x + uv.w, uv.y        } };
+    q[2] = (SDL_Vertex){ { dst.x + dst.w, dst.y + dst.h }, color, { uv.x + uv.w, uv.y + uv.h } };
+    q[3] = (SDL_Vertex){ { dst.x,         dst.y + dst.h }, color, { uv.x,        uv.y + uv.h } };
+    for (int i = 0; i < 6; i++)
+        idx[6 * n + i] = 4 * n + corners[i];
+}
+
+// anti-aliased white disc of diameter `size` with its top-left corner at x0
+static void rasterize_disc(SDL_Surface *s, int x0, int size){
+    const float r = size / 2.0f;
+
+    for (int y = 0; y < size; y++) {
+        Uint8 *row = (Uint8 *)s->pixels + y * s->pitch + 4 * x0;
+        for (int x = 0; x < size; x++) {
+            float dx = x + 0.5f - r;
+            float dy = y + 0.5f - r;
+            // pixel coverage, ramping over one pixel at the rim
+            float cover = r + 0.5f - sqrtf(dx * dx + dy * dy);
+            if (cover < 0.0f) cover = 0.0f;
+            if (cover > 1.0f) cover = 1.0f;
+
+            row[4 * x + 0] = 255;
+            row[4 * x + 1] = 255;
+            row[4 * x + 2] = 255;
+            row[4 * x + 3] = (Uint8)(cover * 255.0f + 0.5f);
         }
     }
+}
+
+/**
+ * Rasterize both knobs side by side into one white texture, so they are
+ * tinted and drawn together in a single SDL_RenderGeometry call.
+ */
+static int create_knob_atlas(void){
+    const int sizes[KNOB_COUNT] = { [KNOB_TIMELINE] = timelinebtn_size, [KNOB_VOLUME] = volumebtn_size };
+
+    int w = 0, h = 0;
+    for (int k = 0; k < KNOB_COUNT; k++) {
+        w += sizes[k] + 1;
+        if (sizes[k] > h) h = sizes[k];
+    }
+
+    SDL_Surface *s = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (!s)
+        return -1;
+    SDL_memset(s->pixels, 0, (size_t)s->pitch * h);
+
+    int x = 0;
+    for (int k = 0; k < KNOB_COUNT; k++) {
+        rasterize_disc(s, x, sizes[k]);
+        knob_uv[k] = (SDL_FRect){ (float)x / w, 0.0f, (float)sizes[k] / w, (float)sizes[k] / h };
+        x += sizes[k] + 1;
+    }
+
+    knob_atlas = SDL_CreateTextureFromSurface(renderer, s);
+    SDL_DestroySurface(s);
+    if (!knob_atlas)
+        return -1;
+
+    SDL_SetTextureBlendMode(knob_atlas, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+// one lane per channel, or a single mixed lane for wide layouts
+static int waveform_lanes(const struct waveform *wf){
+    return (wf->channels >= 1 && wf->channels <= MAX_WAVEFORM_LANES) ? wf->channels : 1;
+}
 
-    return status;
+// rows [*top, *top + *height) of a lane `lane_height` high that the bar of level `rms` covers
+static void bar_extent(int lane_height, float rms, int *top, int *height){
+    const int line_padding = (int)(lane_height * (1 - rms) / 3);
+    *top = line_padding;
+    *height = lane_height - 2 * line_padding + 1;
 }
 
-void prepare_audio_graphic(AppState *state){
-    const int bar_width = 2;
-    const int gap = 1;
+// (re)computes the bars for the current window width from the waveform summary
+void layout_audio_graphic(AppState *state){
+    if (!state->waveform) return;
 
-    int graphic_lines = WINDOW_WIDTH / (bar_width + gap);
+    int graphic_lines = WINDOW_WIDTH / (bar_width + bar_gap);
 
-    int total_samples = audio->len / sizeof(int16_t);
-    int window_samples = total_samples / graphic_lines;
+    const struct waveform *wf = state->waveform;
+    int lanes = waveform_lanes(wf);
 
-    int16_t *samples = (int16_t *)audio->buf;
+    float *rms = realloc(state->rms, lanes * graphic_lines * sizeof(float));
+    if (!rms) return;
 
-    state->rms = calculate_rms(samples, graphic_lines, window_samples);
+    for (int lane = 0; lane < lanes; lane++) {
+        int channel = (lanes == 1) ? -1 : lane;
+        state->rms_ready = waveform_query(wf, channel, 0, wf->frames, graphic_lines,
+                                          rms + lane * graphic_lines, NULL);
+    }
+    state->rms = rms;
+    state->rms_lanes = lanes;
     state->rms_count = graphic_lines;
+    state->waveform_dirty = 1;
+}
+
+/**
+ * Draw the bars into waveform_tex, white on transparent, so that every
+ * frame only has to tint and blit it. Called after a layout change, a
+ * resize or a render target reset, never per frame.
+ */
+static int rebuild_waveform_texture(AppState *state){
+    const int w = WINDOW_WIDTH;
+    const int h = WINDOW_HEIGHT - 2 * graphic_padding_y;
+
+    if (!waveform_tex || waveform_tex_w != w || waveform_tex_h != h) {
+        if (waveform_tex)
+            SDL_DestroyTexture(waveform_tex);
+
+        waveform_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        if (!waveform_tex)
+            return -1;
+        SDL_SetTextureBlendMode(waveform_tex, SDL_BLENDMODE_BLEND);
+        waveform_tex_w = w;
+        waveform_tex_h = h;
+    }
+
+    const int count = state->rms_lanes * state->rms_count;
+    SDL_FRect *rects = realloc(state->bar_rects, count * sizeof *rects);
+    if (!rects) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    state->bar_rects = rects;
+
+    // analyzed bars first, then the placeholders, one batch each
+    const int offset = bar_width + bar_gap;
+    const int lane_height = h / state->rms_lanes;
+    SDL_FRect *bar = rects;
+    SDL_FRect *mark = rects + state->rms_lanes * state->rms_ready;
+
+    for (int lane = 0; lane < state->rms_lanes; lane++){
+        const float *rms = state->rms + lane * state->rms_count;
+        const int y1 = lane * lane_height;
+        const int ymid = y1 + lane_height / 2;
+
+        for (int i = 0; i < state->rms_ready; i++){
+            int top, height;
+            bar_extent(lane_height, rms[i], &top, &height);
+            *bar++ = (SDL_FRect){ i * offset, y1 + top, 1, height };
+        }
+
+        // not analyzed yet: flat marker at the middle
+        for (int i = state->rms_ready; i < state->rms_count; i++)
+            *mark++ = (SDL_FRect){ i * offset, ymid - 1, 1, 3 };
+    }
+
+    const int ready = state->rms_lanes * state->rms_ready;
+
+    SDL_SetRenderTarget(renderer, waveform_tex);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+    DRAW(SDL_RenderClear(renderer));
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    DRAW(SDL_RenderFillRects(renderer, rects, ready));
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, PLACEHOLDER_ALPHA);
+    DRAW(SDL_RenderFillRects(renderer, rects + ready, count - ready));
+    SDL_SetRenderTarget(renderer, NULL);
+
+    state->waveform_dirty = 0;
+    return 0;
 }
 
-// prepare_audio_graphic is needed
-void render_audio_graphic(AppState *state){
+/**
+ * Blit the cached waveform as two quads of one SDL_RenderGeometry call,
+ * split at `played` (0..1): the played part in GRAPHIC_COLOR, the rest in
+ * UNPLAYED_COLOR.
+ */
+void render_audio_graphic(AppState *state, float played){
     if (!state->rms) return;
 
-    const int padding = 150;
+    if (state->waveform_dirty && rebuild_waveform_texture(state) < 0) {
+        fprintf(stderr, "rebuild_waveform_texture failed: %s\n", SDL_GetError());
+        state->waveform_dirty = 0;
+    }
+    if (!waveform_tex) return;
 
-    const int bar_width = 2;
-    const int gap = 1;
-    
-    int offset = bar_width + gap;
+    const float w = waveform_tex_w;
+    const float h = waveform_tex_h;
+    const float split = w * played;
 
-    SDL_SetRenderDrawColor(renderer, GRAPHIC_COLOR);
+    SDL_Vertex v[8];
+    int idx[12];
+    push_quad(v, idx, 0, (SDL_FRect){ 0, graphic_padding_y, split, h },
+              (SDL_FRect){ 0, 0, played, 1 }, fcolor(GRAPHIC_COLOR));
+    push_quad(v, idx, 1, (SDL_FRect){ split, graphic_padding_y, w - split, h },
+              (SDL_FRect){ played, 0, 1 - played, 1 }, fcolor(UNPLAYED_COLOR));
+
+    DRAW(SDL_RenderGeometry(renderer, waveform_tex, v, 8, idx, 12));
+}
 
-    int xpos = 0; 
-    const int y1 = padding;
-    const int y2 = WINDOW_HEIGHT - padding;
-    const int max_line_length = y2 - y1;
+/**
+ * Offscreen counterpart of rebuild_waveform_texture: the same lanes and
+ * bars for a `w` x `h` image, in GRAPHIC_COLOR on BG_COLOR, written
+ * straight into the pixels of a surface, so neither a window nor a
+ * renderer is needed. The cost depends on the size only, as the bars
+ * come from the summary.
+ */
+static SDL_Surface *rasterize_waveform(const struct waveform *wf, int w, int h){
+    const int offset = bar_width + bar_gap;
+    const int bars = w / offset;
+    const int lanes = waveform_lanes(wf);
+    const int lane_height = h / lanes;
+    const Uint8 bg[4] = { BG_COLOR }, fg[4] = { GRAPHIC_COLOR };
+
+    SDL_Surface *s = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    float *rms = malloc((bars > 0 ? bars : 1) * sizeof *rms);
+    if (!s || !rms) {
+        SDL_DestroySurface(s);
+        free(rms);
+        return NULL;
+    }
 
-    for (int i = 0; i < state->rms_count; i++){
-        float coeff = state->rms[i];
-        int line_padding = (int)(max_line_length * (1 - coeff) / 3);
-        SDL_RenderLine(renderer, xpos, y1 + line_padding, xpos, y2 - line_padding);
-        xpos += offset;
+    Uint8 *pixels = s->pixels;
+    for (int x = 0; x < w; x++)
+        SDL_memcpy(pixels + 4 * x, bg, 4);
+    for (int y = 1; y < h; y++)
+        SDL_memcpy(pixels + y * s->pitch, pixels, 4 * (size_t)w);
+
+    for (int lane = 0; lane < lanes && wf->frames > 0; lane++) {
+        const int ready = waveform_query(wf, (lanes == 1) ? -1 : lane, 0, wf->frames, bars, rms, NULL);
+        for (int i = 0; i < ready; i++) {
+            int top, height;
+            bar_extent(lane_height, rms[i], &top, &height);
+            top += lane * lane_height;
+            const int bottom = (top + height < h) ? top + height : h;
+            for (int y = top; y < bottom; y++)
+                SDL_memcpy(pixels + y * s->pitch + 4 * i * offset, fg, 4);
+        }
     }
+
+    free(rms);
+    return s;
 }
 
-void render_screen(AppState *state){
-    SDL_SetRenderDrawColor(renderer, BG_COLOR);
-    SDL_RenderClear(renderer);
+// live spectrum over the waveform, one bar per band rising from its bottom
+static void render_spectrum(AppState *state){
+    const float h = WINDOW_HEIGHT - 2 * graphic_padding_y;
+    const float bottom = graphic_padding_y + h;
+    const float band_w = (float)WINDOW_WIDTH / SPECTRUM_BANDS;
 
-    render_audio_graphic(state);
-    
-    //draw timeline 
-    SDL_RenderFillRect(renderer, &r_timelinebar);
-    
-    int cx = r_timelinebtn.x + r_timelinebtn.w / 2;
-    int cy = r_timelinebar.y + r_timelinebar.h / 2;
-    int radius = timelinebtn_size / 2;
-    SDL_RenderFillCircle(renderer, cx, cy, radius);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        const float bar_h = h * state->spectrum_bands[b];
+        state->spectrum_rects[b] = (SDL_FRect){ b * band_w, bottom - bar_h, band_w - bar_gap, bar_h };
+    }
 
-    char time_elapsed_text[16];
-    char time_remaining_text[16];
-    
-    audio_track_time track_time_state = state->track_time;
-    snprintf(time_elapsed_text, sizeof time_elapsed_text, "%d:%02d",
-        track_time_state.elapsed_sec / 60, track_time_state.elapsed_sec % 60);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, SPECTRUM_COLOR);
+    DRAW(SDL_RenderFillRects(renderer, state->spectrum_rects, SPECTRUM_BANDS));
+}
 
-    snprintf(time_remaining_text, sizeof time_remaining_text, "%d:%02d",
-        track_time_state.remaining_sec / 60, track_time_state.remaining_sec % 60);
+// both knobs in one batch from the knob atlas
+static void render_knobs(void){
+    if (!knob_atlas) return;
+
+    const SDL_FRect *knobs[KNOB_COUNT] = { [KNOB_TIMELINE] = &r_timelinebtn, [KNOB_VOLUME] = &r_volumebtn };
+    const SDL_FRect *bars[KNOB_COUNT] = { [KNOB_TIMELINE] = &r_timelinebar, [KNOB_VOLUME] = &r_volumebar };
+
+    SDL_Vertex v[4 * KNOB_COUNT];
+    int idx[6 * KNOB_COUNT];
+    for (int k = 0; k < KNOB_COUNT; k++) {
+        const float size = knobs[k]->w;
+        const float cx = knobs[k]->x + knobs[k]->w / 2;
+        const float cy = bars[k]->y + bars[k]->h / 2;
+        push_quad(v, idx, k, (SDL_FRect){ cx - size / 2, cy - size / 2, size, size },
+                  knob_uv[k], fcolor(GRAPHIC_COLOR));
+    }
 
-    TTF_Text *txt_elapsed = TTF_CreateText(ttf_engine, ttf_font, time_elapsed_text, strlen(time_elapsed_text));
-    TTF_Text *txt_remaining = TTF_CreateText(ttf_engine, ttf_font, time_remaining_text, strlen(time_remaining_text));
-    if (!txt_elapsed || !txt_remaining) {
-        fprintf(stderr, "TTF_CreateText failed: %s\n", SDL_GetError());
+    DRAW(SDL_RenderGeometry(renderer, knob_atlas, v, 4 * KNOB_COUNT, idx, 6 * KNOB_COUNT));
+}
+
+// m:ss, or h:mm:ss from an hour on
+static void format_time(char *out, size_t size, int sec){
+    if (sec >= 3600)
+        snprintf(out, size, "%d:%02d:%02d", sec / 3600, sec / 60 % 60, sec % 60);
+    else
+        snprintf(out, size, "%d:%02d", sec / 60, sec % 60);
+}
+
+/**
+ * Point the persistent counter texts at the current track time. TTF only
+ * re-lays out a text when its string is set, so this happens once a second
+ * instead of every frame.
+ *
+ * @return 1 if the counters changed, else 0
+ */
+static int update_time_counters(AppState *state){
+    const audio_track_time t = state->track_time;
+    if (t.elapsed_sec == state->shown_time.elapsed_sec
+        && t.remaining_sec == state->shown_time.remaining_sec)
+        return 0;
+
+    char text[16];
+    format_time(text, sizeof text, t.elapsed_sec);
+    TTF_SetTextString(txt_elapsed, text, 0);
+
+    format_time(text, sizeof text, t.remaining_sec);
+    TTF_SetTextString(txt_remaining, text, 0);
+
+    state->shown_time = t;
+    return 1;
+}
+
+static void overlay_line(float *y, const char *fmt, ...){
+    char line[128];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof line, fmt, ap);
+    va_end(ap);
+
+    DRAW(SDL_RenderDebugText(renderer, 8, *y, line));
+    *y += 12;
+}
+
+// F3: live view of the metrics, read without stopping their writers
+static void render_metrics_overlay(const AppState *state){
+    const struct metrics *m = &metrics;
+    float y = 8;
+
+    SDL_SetRenderDrawColor(renderer, TIME_COUNTER_COLOR);
+    overlay_line(&y, "callback  n %llu  p50 %.1f us  p99 %.1f us  max %.1f us",
+                 (unsigned long long)atomic_load(&m->callbacks),
+                 metrics_percentile(&m->callback, 0.50) / 1e3,
+                 metrics_percentile(&m->callback, 0.99) / 1e3,
+                 atomic_load(&m->callback.max_ns) / 1e3);
+    overlay_line(&y, "interval  p50 %.2f ms  p99 %.2f ms  max %.2f ms",
+                 metrics_percentile(&m->interval, 0.50) / 1e6,
+                 metrics_percentile(&m->interval, 0.99) / 1e6,
+                 atomic_load(&m->interval.max_ns) / 1e6);
+    overlay_line(&y, "underruns %llu  requested %llu KiB  supplied %llu KiB",
+                 (unsigned long long)atomic_load(&m->underruns),
+                 (unsigned long long)(atomic_load(&m->bytes_requested) >> 10),
+                 (unsigned long long)(atomic_load(&m->bytes_supplied) >> 10));
+    overlay_line(&y, "seek      n %llu  p50 %.2f ms  p99 %.2f ms  max %.2f ms",
+                 (unsigned long long)atomic_load(&m->seek.count),
+                 metrics_percentile(&m->seek, 0.50) / 1e6,
+                 metrics_percentile(&m->seek, 0.99) / 1e6,
+                 atomic_load(&m->seek.max_ns) / 1e6);
+    overlay_line(&y, "fft %d    p50 %.1f us  p99 %.1f us  max %.1f us  %s",
+                 SPECTRUM_FFT_SIZE,
+                 metrics_percentile(&m->fft, 0.50) / 1e3,
+                 metrics_percentile(&m->fft, 0.99) / 1e3,
+                 atomic_load(&m->fft.max_ns) / 1e3, fft_isa());
+    if (audio->dsp) {
+        overlay_line(&y, "eq %-2d     p50 %.1f us  p99 %.1f us  max %.1f us  %s",
+                     dsp_params.eq_on ? dsp_params.bands : 0,
+                     metrics_percentile(&m->dsp_eq, 0.50) / 1e3,
+                     metrics_percentile(&m->dsp_eq, 0.99) / 1e3,
+                     atomic_load(&m->dsp_eq.max_ns) / 1e3, dsp_isa());
+        overlay_line(&y, "limiter   p50 %.1f us  p99 %.1f us  max %.1f us  %s",
+                     metrics_percentile(&m->dsp_limiter, 0.50) / 1e3,
+                     metrics_percentile(&m->dsp_limiter, 0.99) / 1e3,
+                     atomic_load(&m->dsp_limiter.max_ns) / 1e3, dsp_params.limiter_on ? "on" : "off");
     }
+    const struct audio_track *t = audio_now_playing(audio, NULL);
+    if (atomic_load_explicit(&t->measured, memory_order_acquire)) {
+        const float gain = (audio->dsp && audio->normalize)
+            ? loudness_gain(&t->loudness, audio->target_lufs) : 1.0f;
+        overlay_line(&y, "loudness  %.1f LUFS  LRA %.1f LU  peak %.1f dBTP  gain %+.1f dB",
+                     t->loudness.integrated, t->loudness.range, t->loudness.true_peak,
+                     20.0f * log10f(gain));
+    } else {
+        overlay_line(&y, "loudness  measuring");
+    }
+    overlay_line(&y, "frame     p50 %.2f ms  p99 %.2f ms  draws %d  allocs %llu",
+                 metrics_percentile(&m->frame, 0.50) / 1e6,
+                 metrics_percentile(&m->frame, 0.99) / 1e6,
+                 state->draw_calls, (unsigned long long)state->frame_allocations);
+}
+
+void render_screen(AppState *state){
+    const Uint64 start_ns = SDL_GetTicksNS();
+    const Uint64 allocations = sdl_allocations;
+    frame_draw_calls = 0;
 
-    TTF_SetTextColor(txt_elapsed, TIME_COUNTER_COLOR);
-    TTF_SetTextColor(txt_remaining, TIME_COUNTER_COLOR);
+    SDL_SetRenderDrawColor(renderer, BG_COLOR);
+    DRAW(SDL_RenderClear(renderer));
+
+    // played part of the track, following the knob while it is dragged
+    const float knob_range = r_timelinebar.w - r_timelinebtn.w;
+    float played = (knob_range > 0) ? (r_timelinebtn.x - r_timelinebar.x) / knob_range : 0.0f;
+    if (played < 0.0f) played = 0.0f;
+    if (played > 1.0f) played = 1.0f;
 
-    TTF_DrawRendererText(txt_elapsed, r_time_left.x, r_time_left.y);
+    render_audio_graphic(state, played);
+    if (state->show_spectrum)
+        render_spectrum(state);
 
-    TTF_DrawRendererText(txt_remaining, r_time_remaining.x, r_time_remaining.y);
+    //draw timeline and volume bars
+    const SDL_FRect bars[2] = { r_timelinebar, r_volumebar };
+    SDL_SetRenderDrawColor(renderer, GRAPHIC_COLOR);
+    DRAW(SDL_RenderFillRects(renderer, bars, 2));
 
-    SDL_free(txt_elapsed);
-    SDL_free(txt_remaining);
-    //draw volume control
-    SDL_RenderFillRect(renderer, &r_volumebar);
+    render_knobs();
 
-    cx = r_volumebtn.x + r_volumebtn.w / 2;
-    cy = r_volumebar.y + r_volumebar.h / 2;
-    radius = volumebtn_size / 2;
-    SDL_RenderFillCircle(renderer, cx, cy, radius);
+    const int counters_changed = update_time_counters(state);
+
+    if (txt_elapsed && txt_remaining) {
+        DRAW(TTF_DrawRendererText(txt_elapsed, r_time_left.x, r_time_left.y));
+        DRAW(TTF_DrawRendererText(txt_remaining, r_time_remaining.x, r_time_remaining.y));
+    }
 
     if (SDL_AudioStreamDevicePaused(stream)) {
-        SDL_RenderTexture(renderer, play_icon, NULL, &r_play); 
+        DRAW(SDL_RenderTexture(renderer, play_icon, NULL, &r_play)); 
     } else {
-        SDL_RenderTexture(renderer, pause_icon, NULL, &r_play); 
+        DRAW(SDL_RenderTexture(renderer, pause_icon, NULL, &r_play)); 
     }
 
+    if (state->show_metrics)
+        render_metrics_overlay(state);
+
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
+    // presenting waits for vsync, only the work up to here is frame cost
+    metrics_record(&metrics.frame, SDL_GetTicksNS() - start_ns);
+
+    if (frame_draw_calls != state->draw_calls) {
+        DEBUG_PRINTF("%d draw calls per frame\n", frame_draw_calls);
+        state->draw_calls = frame_draw_calls;
+    }
+
     SDL_RenderPresent(renderer);
+
+    // steady frames must not touch the heap; only new counter text may
+    state->frame_allocations = sdl_allocations - allocations;
+    if (state->frame_allocations && !counters_changed)
+        DEBUG_PRINTF("%llu SDL allocations in a steady frame\n",
+                     (unsigned long long)state->frame_allocations);
 }
 
 void setup_menu(){
@@ -371,7 +811,7 @@ int setup_sdl(){
         return -1;
     }
 
-    SDL_CreateWindowAndRenderer(progname, WINDOW_WIDTH, WINDOW_HEIGHT, 0, &window, &renderer);
+    SDL_CreateWindowAndRenderer(progname, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE, &window, &renderer);
     if (!window) {
         printf("SDL_CreateWindow error: %s\n", SDL_GetError());
         return -1;
@@ -383,6 +823,17 @@ int setup_sdl(){
         return -1;
     }
 
+    SDL_SetWindowMinimumSize(window, MIN_WINDOW_WIDTH, MIN_WINDOW_HEIGHT);
+
+    if (!SDL_SetRenderVSync(renderer, 1))
+        printf("Error: SDL_SetRenderVSync failed, frames are paced by timeouts: %s\n", SDL_GetError());
+
+    const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+    if (mode && mode->refresh_rate > 0.0f)
+        frame_ms = (Sint32)(1000.0f / mode->refresh_rate);
+    if (frame_ms < 1)
+        frame_ms = 1;
+
     if (SDL_ShowCursor() < 0)
         printf("error: %s", SDL_GetError());
     
@@ -398,6 +849,11 @@ int setup_sdl(){
         printf("Error: IMG_LoadTexture failed (play_icon): %s\n", SDL_GetError());
     }   
     SDL_SetTextureScaleMode(play_icon, SDL_SCALEMODE_LINEAR);
+
+    if (create_knob_atlas() < 0){
+        printf("Error: create_knob_atlas failed: %s\n", SDL_GetError());
+    }
+
     if (!TTF_Init()) {
         fprintf(stderr, "TTF_Init failed: %s\n", SDL_GetError());
         return -1;
@@ -413,125 +869,158 @@ int setup_sdl(){
         printf("Error: TTF_CreateRendererTextEngine failed: %s\n", SDL_GetError());
     }  
 
+    txt_elapsed = TTF_CreateText(ttf_engine, ttf_font, "", 0);
+    txt_remaining = TTF_CreateText(ttf_engine, ttf_font, "", 0);
+    if (!txt_elapsed || !txt_remaining) {
+        fprintf(stderr, "TTF_CreateText failed: %s\n", SDL_GetError());
+    } else {
+        TTF_SetTextColor(txt_elapsed, TIME_COUNTER_COLOR);
+        TTF_SetTextColor(txt_remaining, TIME_COUNTER_COLOR);
+    }
+
     setup_menu();
     return 0;
 }
 
-float *calculate_rms(int16_t *samples, int windows, int window_samples) {
-    float *rms = calloc(windows, sizeof(float));
-
-    for (int i = 0; i < windows; i++) {
-
-        int start = i * window_samples;
-        int end   = start + window_samples;
-
-        double sum = 0.0;
-
-        for (int j = start; j < end; j++) {
-            double v = samples[j];
-            sum += v * v;
-        }
-
-        double mean = sum / window_samples;
-        double value = sqrt(mean);
-
-        rms[i] = (float)(value / 32767.0);
+// point `audio` at `track` from its start, with the seek fade and the spectrum tap
+static void init_audio_buffer(struct audio_track *track){
+    audio_buffer_init(audio, track, &metrics);
+    audio_set_seek_fade(audio, seek_fade_ms);
+    audio_set_normalize(audio, normalize, normalize_lufs);
+    if (spectrum.joinable) {
+        audio_set_tap(audio, &spectrum.tap);
+        spectrum_set_freq(&spectrum, track->spec.freq);
     }
-
-    return rms;
 }
 
-static audio_track_time calculate_audio_track_time(const struct audio_buffer *a){
-    audio_track_time t = {0, 0, 0};
-
-    const int bytes_per_sample = SDL_AUDIO_BITSIZE(a->spec.format) / 8;
-    const int bytes_per_frame  = bytes_per_sample * a->spec.channels;
-
-    if (bytes_per_frame <= 0 || a->spec.freq <= 0 || a->len == 0) {
-        return t;
+/**
+ * Open a stream for the tracks in `audio->spec`. A track at another rate
+ * than the device's is resampled by the callback, unless --resampler=sdl
+ * or the ratio is out of the resampler's range, then runs through the
+ * DSP chain unless --dsp=off, and SDL converts whatever is left (sample
+ * format, channels). With neither, a track in the device's format goes
+ * through untouched.
+ */
+static int open_stream(void){
+    SDL_AudioSpec src = audio->spec;
+
+    resampler_free(&resampler);
+    if (src.freq != device_spec.freq && resampler_quality != RESAMPLE_SDL) {
+        if (resampler_init(&resampler, src.format, src.channels, src.freq, device_spec.freq,
+                           resampler_quality) == 0) {
+            audio_set_resampler(audio, &resampler);
+            src = (SDL_AudioSpec){ SDL_AUDIO_F32, src.channels, device_spec.freq };
+        } else {
+            fprintf(stderr, "%s, SDL converts the rate\n", SDL_GetError());
+        }
     }
 
-    Uint32 pos = a->pos;
-    if (pos > a->len) pos = a->len;
-
-    const Uint64 total_frames   = (Uint64)a->len / (Uint64)bytes_per_frame;
-    const Uint64 elapsed_frames = (Uint64)pos     / (Uint64)bytes_per_frame;
-
-    const Uint64 total_ms   = total_frames   * 1000ULL / (Uint64)a->spec.freq;
-    const Uint64 elapsed_ms = elapsed_frames * 1000ULL / (Uint64)a->spec.freq;
-
-    const Uint64 clamped_elapsed_ms = (elapsed_ms > total_ms) ? total_ms : elapsed_ms;
-
-    t.total_sec = (int)(total_ms / 1000ULL);
-    t.elapsed_sec = (int)(clamped_elapsed_ms / 1000ULL);
-
-    t.remaining_sec = t.total_sec - t.elapsed_sec;
-
-    // Safety clamps
-    if (t.elapsed_sec < 0) t.elapsed_sec = 0;
-    if (t.total_sec < 0) t.total_sec = 0;
-    if (t.elapsed_sec > t.total_sec) t.elapsed_sec = t.total_sec;
-    if (t.remaining_sec < 0) t.remaining_sec = 0;
-    if (t.remaining_sec > t.total_sec) t.remaining_sec = t.total_sec;
-
-    return t;
-}
-
-int audio_buffer_init(){
-    if (!audio || !audio_file_path) {
-        fprintf(stderr, "audio or audio_file_path is NULL\n");
-        return -1;
+    dsp_chain_free(&dsp);
+    if (dsp_enabled) {
+        if (dsp_chain_init(&dsp, src.format, src.channels, src.freq, &dsp_params, &metrics) == 0) {
+            audio_set_dsp(audio, &dsp);
+            src.format = SDL_AUDIO_F32;
+            DEBUG_PRINTF("dsp: %d eq bands (%s), limiter %s, %d frames look-ahead\n",
+                         dsp_params.bands, dsp_isa(), dsp_params.limiter_on ? "on" : "off",
+                         dsp_chain_latency(&dsp));
+        } else {
+            fprintf(stderr, "%s, playing without it\n", SDL_GetError());
+        }
     }
 
-    if (!SDL_LoadWAV(audio_file_path, &audio->spec, &audio->buf, &audio->len)) {
-        fprintf(stderr, "SDL_LoadWAV failed: %s\n", SDL_GetError());
+    if (src.format == device_spec.format && src.channels == device_spec.channels
+        && src.freq == device_spec.freq)
+        DEBUG_PRINTF("stream: %d Hz, %d channels, no conversion\n", src.freq, src.channels);
+    else
+        DEBUG_PRINTF("stream: %d Hz -> device %d Hz (%s %s), %d -> %d channels\n",
+                     audio->spec.freq, device_spec.freq,
+                     audio->resampler ? resample_quality_name(resampler_quality) : "SDL",
+                     audio->resampler ? resample_isa() : "", src.channels, device_spec.channels);
+
+    // heard one device buffer and the limiter's look-ahead after leaving the stream
+    Uint64 latency_ns = 0;
+    if (device_frames > 0 && device_spec.freq > 0)
+        latency_ns += (Uint64)device_frames * SDL_NS_PER_SECOND / (Uint64)device_spec.freq;
+    if (audio->dsp)
+        latency_ns += (Uint64)dsp_chain_latency(&dsp) * SDL_NS_PER_SECOND / (Uint64)src.freq;
+    audio_set_output_latency(audio, latency_ns);
+
+    stream = SDL_OpenAudioDeviceStream(audio_devid, &src, audio_callback, audio);
+    if (stream == NULL) {
+        printf("Uhoh, stream failed to create: %s\n", SDL_GetError());
         return -1;
     }
-
-    audio->pos = 0;
     return 0;
 }
 
-static void audio_callback(
-    void *userdata, 
-    SDL_AudioStream *stream, 
-    int additional_amount, 
-    int total_amount
-){  
-    pthread_mutex_lock(&audio_mu);
+int setup_audio(){
+    audio = calloc(1, sizeof(struct audio_buffer));
+    if (!audio) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
 
-    const int CHUNK_SIZE = 512;
-    if (audio->pos + CHUNK_SIZE > audio->len){
-        DEBUG_PRINTF("not enough data in audio buffer\n");
-        pthread_mutex_unlock(&audio_mu);
-        return;
+    // start with the first file that loads
+    int first = 0;
+    while (first < playlist.count && playlist_load(&playlist, first) < 0) {
+        fprintf(stderr, "cannot load %s: %s\n", playlist.entries[first].path, SDL_GetError());
+        first++;
     }
-    while (additional_amount > 0){
-        SDL_PutAudioStreamData(stream, audio->buf + audio->pos, CHUNK_SIZE);
-        audio->pos += CHUNK_SIZE;
-        additional_amount -= CHUNK_SIZE;
+    if (first == playlist.count)
+        return -1;
+
+    // the player works without a spectrum, the view just stays empty
+    if (spectrum_init(&spectrum, &metrics) < 0 || spectrum_start(&spectrum) < 0) {
+        fprintf(stderr, "spectrum failed: %s\n", SDL_GetError());
+        spectrum_free(&spectrum);
     }
-    pthread_mutex_unlock(&audio_mu);
-}
 
-int setup_audio(){
-    audio = malloc(sizeof(struct audio_buffer));
-    audio_buffer_init();
+    init_audio_buffer(&playlist.entries[first].track);
     
-    audio_devid = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &audio->spec);
+    // only a request: the backend may round it or ignore it
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, latency->sample_frames);
+
+    // the device runs in its preferred format, the stream adapts to it
+    audio_devid = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, NULL);
     if (!audio_devid){
         printf("Audio device could not be opened!\n"
                        "SDL_Error: %s\n", SDL_GetError());
-        SDL_free(audio->buf);
         return -1;
     }
+
+    if (!SDL_GetAudioDeviceFormat(audio_devid, &device_spec, &device_frames))
+        device_spec = audio->spec;
+    DEBUG_PRINTF("latency %s: asked for %s frames, got %d\n",
+                 latency->name, latency->sample_frames, device_frames);
     
-    stream = SDL_OpenAudioDeviceStream(audio_devid, &audio->spec, audio_callback, &audio);
-    if (stream == NULL)
-        printf("Uhoh, stream failed to create: %s\n", SDL_GetError());
-    
+    if (open_stream() < 0)
+        return -1;
 
     SDL_ResumeAudioStreamDevice(stream);
+    return 0;
+}
+
+/**
+ * The next track is in another format: replace the stream with one in its
+ * format once the playing track has drained. The device stays open, and
+ * the volume and pause state carry over.
+ */
+static int restart_stream(struct audio_track *next){
+    const int paused = SDL_AudioStreamDevicePaused(stream);
+    const float gain = SDL_GetAudioStreamGain(stream);
+
+    SDL_DestroyAudioStream(stream);
+    stream = NULL;
+
+    init_audio_buffer(next);
+    metrics.last_callback_ns = 0;
+    if (open_stream() < 0)
+        return -1;
+
+    SDL_SetAudioStreamGain(stream, gain);
+    if (!paused)
+        SDL_ResumeAudioStreamDevice(stream);
+    return 0;
 }
 
 int setup(void){
@@ -546,6 +1035,7 @@ int setup(void){
 int toggle_audio(){
     if (SDL_AudioStreamDevicePaused(stream)) {
         DEBUG_PRINTF("device resumed\n");
+        audio_clock_pause(audio, stream, 0);
         if (!SDL_ResumeAudioStreamDevice(stream)) {
             fprintf(stderr, "Resume failed: %s\n", SDL_GetError());
         }
@@ -554,16 +1044,31 @@ int toggle_audio(){
         if (!SDL_PauseAudioStreamDevice(stream)) {
             fprintf(stderr, "Pause failed: %s\n", SDL_GetError());
         }
+        audio_clock_pause(audio, stream, 1);
     }
 }
 
+// flip an on/off parameter of the DSP chain; the callback applies it on its next block
+static void toggle_dsp(int *on){
+    *on = !*on;
+    if (audio->dsp)
+        dsp_chain_set(&dsp, &dsp_params);
+}
+
 void seek_audio(float percent){
-    pthread_mutex_lock(&audio_mu);
-    audio->pos = audio->len * percent;
-    int bytes_per_sample = SDL_AUDIO_BITSIZE(audio->spec.format) / 8;
-    int bytes_per_frame  = bytes_per_sample * audio->spec.channels;
-    audio->pos -= audio->pos % bytes_per_frame;
-    pthread_mutex_unlock(&audio_mu);
+    const struct audio_track *track = audio_now_playing(audio, NULL);
+    audio_seek(audio, stream, audio_track_frame_at(track, percent));
+}
+
+// seek while the timeline knob is dragged, throttled so the preview stays audible
+void scrub_audio(float percent){
+    static Uint64 last_ns;
+    const Uint64 now = SDL_GetTicksNS();
+    if (now - last_ns < SCRUB_INTERVAL_MS * SDL_NS_PER_MS)
+        return;
+
+    last_ns = now;
+    seek_audio(percent);
 }
 
 void adjust_volume(float gain){
@@ -588,11 +1093,81 @@ float drag_slider_x(SDL_FRect* btn, const SDL_FRect* bar, float mouse_x){
     return slider_pos;
 }
 
-void update(AppState *state){
-    pthread_mutex_lock(&audio_mu);
+void resize_window(AppState *state, int w, int h){
+    WINDOW_WIDTH = w;
+    WINDOW_HEIGHT = h;
+
+    setup_menu();
+
+    // setup_menu parks the volume knob at full, put it back where the gain is
+    float gain = SDL_GetAudioStreamGain(stream);
+    if (gain >= 0.0f && gain <= 1.0f)
+        r_volumebtn.x = r_volumebar.x + (r_volumebar.w - r_volumebtn.w) * gain;
+
+    layout_audio_graphic(state);
+}
+
+// the callback moved on to entry `index`: drop the old one, prefetch the one after
+static void show_track(AppState *state, int index){
+    playlist_release(&playlist, state->track);
+
+    state->track = index;
+    state->waveform = &playlist.entries[index].waveform;
+    state->waveform_ready = atomic_load_explicit(&state->waveform->ready, memory_order_acquire);
+    state->next = index + 1;
+    state->next_queued = 0;
+
+    playlist_prefetch(&playlist, state->next);
+    layout_audio_graphic(state);
+}
+
+/**
+ * Hand the prefetched track to the callback as soon as the loader is done
+ * with it, or restart the stream at the end of the playing track when the
+ * formats differ. Files that fail to load are skipped.
+ */
+static void follow_playlist(AppState *state){
+    if (state->next < 0 || state->next >= playlist.count || state->next_queued == 1)
+        return;
+
+    struct playlist_entry *e = &playlist.entries[state->next];
+    switch (atomic_load_explicit(&e->state, memory_order_acquire)) {
+    case PLAYLIST_FAILED:
+        state->next++;
+        playlist_prefetch(&playlist, state->next);
+        break;
+    case PLAYLIST_LOADED:
+        if (state->next_queued == 0) {
+            state->next_queued = (audio_queue_next(audio, &e->track) == 0) ? 1 : -1;
+            if (state->next_queued < 0)
+                DEBUG_PRINTF("%s, restarting the stream between tracks\n", SDL_GetError());
+        }
+        if (state->next_queued < 0 && atomic_load_explicit(&audio->at_end, memory_order_relaxed)) {
+            if (restart_stream(&e->track) < 0)
+                state->next = -1;
+        }
+        break;
+    }
+}
+
+// @return 1 if anything on screen changed since the last call, else 0
+int update(AppState *state){
+    const float knob_x = r_timelinebtn.x;
+    const audio_track_time shown = state->track_time;
+    int changed = 0;
+
+    // what is heard, so the knob and the counters do not run ahead of the sound
+    Uint64 pos;
+    const struct audio_track *playing = audio_now_heard(audio, &pos);
+    audio_advise_playback(audio);
+    if (playing->index != state->track) {
+        show_track(state, playing->index);
+        changed = 1;
+    }
+    follow_playlist(state);
 
     if (state->drag != DRAG_TIMELINE){
-        float track_percent = (audio->len > 0) ? ((float)audio->pos / (float)audio->len) : 0.0f;
+        double track_percent = (playing->frames > 0) ? ((double)pos / (double)playing->frames) : 0.0;
 
         int minx = r_timelinebar.x;
         int maxx = r_timelinebar.x + r_timelinebar.w - r_timelinebtn.w;
@@ -601,7 +1176,47 @@ void update(AppState *state){
 
     state->track_time = calculate_audio_track_time(audio);
 
-    pthread_mutex_unlock(&audio_mu);
+    Uint64 ready = atomic_load_explicit(&state->waveform->ready, memory_order_acquire);
+    if (ready != state->waveform_ready) {
+        state->waveform_ready = ready;
+        layout_audio_graphic(state);
+        changed = 1;
+    }
+
+    if (r_timelinebtn.x != knob_x
+        || state->track_time.elapsed_sec != shown.elapsed_sec
+        || state->track_time.remaining_sec != shown.remaining_sec)
+        changed = 1;
+
+    if (state->show_spectrum) {
+        const Uint32 seq = spectrum_read(&spectrum, state->spectrum_bands);
+        if (seq != state->spectrum_seq) {
+            state->spectrum_seq = seq;
+            changed = 1;
+        }
+    }
+
+    // the overlay follows the audio thread's counters while playing
+    if (state->show_metrics && !SDL_AudioStreamDevicePaused(stream))
+        changed = 1;
+
+    return changed;
+}
+
+/**
+ * How long mainloop may block waiting for events: not at all when a frame
+ * is due, one display frame while playback moves the knob, a coarse poll
+ * while only the analysis progresses, and forever when nothing moves.
+ */
+static Sint32 wait_timeout(const AppState *state, int redraw){
+    if (redraw)
+        return 0;
+    if (!SDL_AudioStreamDevicePaused(stream))
+        return frame_ms;
+    if (state->track >= 0
+        && atomic_load(&playlist.entries[state->track].analysis.state) == ANALYSIS_RUNNING)
+        return ANALYSIS_POLL_MS;
+    return -1;
 }
 
 int mainloop(){
@@ -610,23 +1225,43 @@ int mainloop(){
     
     AppState state;
     init_state(&state);
-    prepare_audio_graphic(&state);
 
     int window_status = RUNNING;
+    int redraw = 1;
     while (window_status == RUNNING) {
         SDL_Event event;
-        SDL_GetMouseState(&mouse.x, &mouse.y);
+        int have_event = SDL_WaitEventTimeout(&event, wait_timeout(&state, redraw));
 
-        while (SDL_PollEvent(&event)) {  
+        while (have_event) {  
+            SDL_GetMouseState(&mouse.x, &mouse.y);
             switch (event.type){
             case SDL_EVENT_QUIT:
                 window_status = STOPPED;
                 break;
+            case SDL_EVENT_WINDOW_RESIZED:
+                resize_window(&state, event.window.data1, event.window.data2);
+                break;
+            case SDL_EVENT_RENDER_TARGETS_RESET:
+                // the backend dropped the contents of waveform_tex
+                state.waveform_dirty = 1;
+                break;
             case SDL_EVENT_KEY_DOWN:
                     switch (event.key.key){
                     case SDLK_SPACE:
                         toggle_audio();
                         break;
+                    case SDLK_F3:
+                        state.show_metrics = !state.show_metrics;
+                        break;
+                    case SDLK_S:
+                        state.show_spectrum = !state.show_spectrum;
+                        break;
+                    case SDLK_E:
+                        toggle_dsp(&dsp_params.eq_on);
+                        break;
+                    case SDLK_L:
+                        toggle_dsp(&dsp_params.limiter_on);
+                        break;
                     }
                     break;
             case SDL_EVENT_MOUSE_BUTTON_DOWN:
@@ -653,6 +1288,7 @@ int mainloop(){
                 switch (state.drag){
                 case DRAG_TIMELINE:
                     slider_pos = drag_slider_x(&r_timelinebtn, &r_timelinebar, mouse.x);
+                    scrub_audio(slider_pos);
                     break;
                 case DRAG_VOLUME:
                     slider_pos = drag_slider_x(&r_volumebtn, &r_volumebar, mouse.x);
@@ -660,21 +1296,41 @@ int mainloop(){
                     break;
                 }
             }
+
+            // hovering over the window is the only event that changes nothing
+            if (event.type != SDL_EVENT_MOUSE_MOTION || state.drag != DRAG_NONE)
+                redraw = 1;
+
+            have_event = SDL_PollEvent(&event);
         }
 
-        update(&state);
+        if (update(&state))
+            redraw = 1;
 
-        render_screen(&state);
-        SDL_Delay(16); 
+        if (redraw || state.waveform_dirty) {
+            // with vsync on, presenting paces the loop to the display
+            render_screen(&state);
+            redraw = 0;
+        }
     }
+
+    free(state.rms);
+    free(state.bar_rects);
     return 0;
 }
 
 void cleanup(){
     if (stream) SDL_DestroyAudioStream(stream);
+    resampler_free(&resampler);
+    dsp_chain_free(&dsp);
+    spectrum_free(&spectrum);
+
+    // the stream and the analyzer are gone, nothing writes the metrics anymore
+    if (metrics_path && metrics_dump(&metrics, metrics_path) < 0)
+        fprintf(stderr, "metrics_dump failed: %s\n", SDL_GetError());
 
-    if (audio->buf)
-        SDL_free(audio->buf);
+    // after the stream: the callback reads the tracks
+    playlist_free(&playlist);
 
     if (pause_icon)
         SDL_DestroyTexture(pause_icon);
@@ -682,6 +1338,18 @@ void cleanup(){
     if (play_icon)
         SDL_DestroyTexture(play_icon);
 
+    if (waveform_tex)
+        SDL_DestroyTexture(waveform_tex);
+
+    if (knob_atlas)
+        SDL_DestroyTexture(knob_atlas);
+
+    if (txt_elapsed)
+        TTF_DestroyText(txt_elapsed);
+
+    if (txt_remaining)
+        TTF_DestroyText(txt_remaining);
+
     if (renderer)
         SDL_DestroyRenderer(renderer);
 
@@ -690,50 +1358,302 @@ void cleanup(){
 
     TTF_Quit();
 
+    pool_shutdown();
+
     SDL_Quit();
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2){
-        printf("Error: No .wav file specified.\n");
-        printf("Usage: ./audio_player /full/path/to/your/audio.wav\n");
+// --analyze: index a whole library without opening a window or a device
+static int analyze_library(void){
+    struct library_stats st;
+    const int rc = library_analyze(analyze_path, index_path, &st);
+    pool_shutdown();
+    if (rc < 0) {
+        fprintf(stderr, "library_analyze failed: %s\n", SDL_GetError());
         return 1;
     }
-    
-    progname = argv[0];
-    audio_file_path = argv[1];
-    
-    if (setup() < 0){
-        cleanup();
-        return 1;
+
+    const double seconds = (st.seconds > 0.0) ? st.seconds : 1e-9;
+    printf("%s: %llu files (%llu failed), %.1f MB in %.2f s on %d threads: %.1f files/s, %.1f MB/s\n",
+           index_path, (unsigned long long)st.files, (unsigned long long)st.failed,
+           st.bytes / 1e6, st.seconds, st.threads, st.files / seconds, st.bytes / 1e6 / seconds);
+    return 0;
+}
+
+/**
+ * thumbnail_job
+ *
+ * --render-png over the playlist, one pool item per file; items only
+ * write their own slot of `done`:
+ * - done: 1 for every thumbnail written
+ */
+struct thumbnail_job {
+    struct playlist_entry *entries;
+    int *done;
+};
+
+// <path>.png, or <thumb_dir>/<basename>.png
+static void thumbnail_path(char *out, size_t size, const char *path){
+    if (!thumb_dir) {
+        snprintf(out, size, "%s.png", path);
+        return;
     }
+    const char *slash = strrchr(path, '/');
+    snprintf(out, size, "%s/%s.png", thumb_dir, slash ? slash + 1 : path);
+}
 
-    mainloop();
+// the cached summary if there is one, else a fresh analysis that is cached for the player
+static int render_thumbnail(const char *path){
+    struct audio_track track;
+    SDL_zero(track);
+    if (audio_track_open(&track, path) < 0)
+        return -1;
 
-    cleanup();
+    struct waveform wf;
+    int rc = 0;
+    if (waveform_cache_load(&wf, path, &track) < 0) {
+        rc = analysis_run(&wf, path, &track);
+        if (rc == 0 && waveform_cache_store(&wf, path, &track) < 0)
+            fprintf(stderr, "waveform_cache_store failed: %s\n", SDL_GetError());
+    }
 
-    return 0;
+    SDL_Surface *surface = (rc == 0) ? rasterize_waveform(&wf, thumb_width, thumb_height) : NULL;
+    if (surface) {
+        char out[4096];
+        thumbnail_path(out, sizeof out, path);
+        if (!IMG_SavePNG(surface, out))
+            rc = -1;
+        SDL_DestroySurface(surface);
+    } else {
+        rc = -1;
+    }
+
+    waveform_free(&wf);
+    audio_track_close(&track);
+    return rc;
+}
+
+static void render_thumbnails(void *ctx, Uint64 begin, Uint64 end){
+    const struct thumbnail_job *job = ctx;
+    for (Uint64 i = begin; i < end; i++) {
+        job->done[i] = render_thumbnail(job->entries[i].path) == 0;
+        if (!job->done[i])
+            fprintf(stderr, "skipping %s: %s\n", job->entries[i].path, SDL_GetError());
+    }
+}
+
+// --render-png: waveform thumbnails of every file, no window and no device
+static int render_pngs(char **paths, int count){
+    const Uint64 start_ns = SDL_GetTicksNS();
+    if (playlist_init(&playlist, paths, count) < 0){
+        fprintf(stderr, "playlist_init failed: %s\n", SDL_GetError());
+        playlist_free(&playlist);
+        pool_shutdown();
+        return 1;
+    }
+
+    int *done = calloc(playlist.count, sizeof *done);
+    if (!done) {
+        fprintf(stderr, "render_pngs failed: out of memory\n");
+        playlist_free(&playlist);
+        pool_shutdown();
+        return 1;
+    }
+
+    struct thumbnail_job job = { playlist.entries, done };
+    pool_parallel_for((Uint64)playlist.count, 1, render_thumbnails, &job);
+
+    int rendered = 0;
+    for (int i = 0; i < playlist.count; i++)
+        rendered += done[i];
+    const double seconds = (SDL_GetTicksNS() - start_ns) / 1e9;
+    printf("%d of %d thumbnails (%dx%d) in %.2f s on %d threads: %.1f per second\n",
+           rendered, playlist.count, thumb_width, thumb_height, seconds, pool_threads(),
+           rendered / (seconds > 0.0 ? seconds : 1e-9));
+
+    free(done);
+    playlist_free(&playlist);
+    pool_shutdown();
+    return (rendered == playlist.count) ? 0 : 1;
 }
 
-float *calculate_peaks(int16_t *samples, int windows, int window_samples){
-    float *peaks = calloc(windows, sizeof(float));
-    int i, j;
-    for (i = 0; i < windows; i++) {
-        int start = i * window_samples;
-        int end   = start + window_samples;
+/**
+ * --mix: every file at once, each a voice of the mixer at unity gain in
+ * the middle (stems of one mix add up to it), until the last one ends.
+ * The mixer runs at the first file's rate; files at another are skipped.
+ */
+static int mix_files(char **paths, int count){
+    if (playlist_init(&playlist, paths, count) < 0 || !SDL_Init(SDL_INIT_AUDIO)) {
+        fprintf(stderr, "mix failed: %s\n", SDL_GetError());
+        playlist_free(&playlist);
+        pool_shutdown();
+        return 1;
+    }
+
+    struct audio_track *tracks = calloc(playlist.count, sizeof *tracks);
+    struct mixer mix;
+    SDL_zero(mix);
+    int rc = 1, voices = 0;
+    if (!tracks)
+        goto done;
+
+    for (int i = 0; i < playlist.count; i++) {
+        const char *path = playlist.entries[i].path;
+        if (audio_track_open(&tracks[i], path) < 0) {
+            fprintf(stderr, "skipping %s: %s\n", path, SDL_GetError());
+            continue;
+        }
+        if (!mix.voices && mixer_init(&mix, tracks[i].spec.freq, playlist.count) < 0)
+            goto done;
+        if (mixer_play(&mix, &tracks[i], 1.0f, 0.0f, 0) < 0)
+            fprintf(stderr, "skipping %s: %s\n", path, SDL_GetError());
+        else
+            voices++;
+    }
+    if (voices == 0) {
+        SDL_SetError("nothing to mix");
+        goto done;
+    }
 
-        int peak = 0;
+    const SDL_AudioSpec spec = { SDL_AUDIO_F32, MIXER_CHANNELS, mix.freq };
+    SDL_AudioStream *mix_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec,
+                                                            mixer_callback, &mix);
+    if (!mix_stream)
+        goto done;
+    printf("mixing %d voices at %d Hz (%s)\n", voices, mix.freq, mixer_isa());
+    SDL_ResumeAudioStreamDevice(mix_stream);
+
+    for (int playing = voices; playing > 0; ) {
+        SDL_Delay(100);
+        playing = 0;
+        for (int v = 0; v < mix.max_voices; v++)
+            playing += mixer_voice_active(&mix, v);
+    }
+    SDL_DestroyAudioStream(mix_stream);
+    rc = 0;
+
+done:
+    if (rc)
+        fprintf(stderr, "mix failed: %s\n", SDL_GetError());
+    for (int i = 0; tracks && i < playlist.count; i++)
+        audio_track_close(&tracks[i]);
+    free(tracks);
+    mixer_free(&mix);
+    playlist_free(&playlist);
+    pool_shutdown();
+    SDL_Quit();
+    return rc;
+}
 
-        for (j = start; j < end; j++) {
-            int v = samples[j];
-            if (v < 0) 
-                v = -v;
+int main(int argc, char **argv) {
+    // before anything can reach SDL's allocator or start a thread
+    count_allocations();
 
-            if (v > peak)
-                peak = v;
+    progname = argv[0];
+    dsp_params_default(&dsp_params);
+
+    // options out, files (and .m3u lists) packed at the front in order
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--metrics=", 10) == 0)
+            metrics_path = argv[i] + 10;
+        else if (strncmp(argv[i], "--seek-fade=", 12) == 0)
+            seek_fade_ms = atoi(argv[i] + 12);
+        else if (strncmp(argv[i], "--resampler=", 12) == 0) {
+            resampler_quality = resample_quality_of(argv[i] + 12);
+            if (resampler_quality < 0) {
+                printf("Error: unknown resampler %s (sdl, fast, medium or best)\n", argv[i] + 12);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--eq=", 5) == 0) {
+            if (dsp_parse_eq(&dsp_params, argv[i] + 5) < 0) {
+                printf("Error: %s\n", SDL_GetError());
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--limiter=", 10) == 0) {
+            if (strcmp(argv[i] + 10, "off") == 0)
+                dsp_params.limiter_on = 0;
+            else {
+                dsp_params.limiter_on = 1;
+                dsp_params.ceiling_db = (float)atof(argv[i] + 10);
+            }
+        }
+        else if (strcmp(argv[i], "--dsp=off") == 0)
+            dsp_enabled = 0;
+        else if (strncmp(argv[i], "--normalize=", 12) == 0) {
+            normalize = strcmp(argv[i] + 12, "off") != 0;
+            if (normalize)
+                normalize_lufs = (float)atof(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--analyze=", 10) == 0)
+            analyze_path = argv[i] + 10;
+        else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc)
+            analyze_path = argv[++i];
+        else if (strncmp(argv[i], "--index=", 8) == 0)
+            index_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--render-png", 12) == 0 && (argv[i][12] == '=' || argv[i][12] == '\0')) {
+            const char *size = (argv[i][12] == '=') ? argv[i] + 13 : (i + 1 < argc) ? argv[++i] : "";
+            if (sscanf(size, "%dx%d", &thumb_width, &thumb_height) != 2
+                || thumb_width < bar_width + bar_gap || thumb_height < 1
+                || thumb_width > 16384 || thumb_height > 16384) {
+                printf("Error: bad thumbnail size %s (WIDTHxHEIGHT)\n", size);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--png-dir=", 10) == 0)
+            thumb_dir = argv[i] + 10;
+        else if (strcmp(argv[i], "--mix") == 0)
+            mix_mode = 1;
+        else if (strncmp(argv[i], "--latency=", 10) == 0) {
+            latency = NULL;
+            for (size_t m = 0; m < SDL_arraysize(latency_modes); m++)
+                if (strcmp(argv[i] + 10, latency_modes[m].name) == 0)
+                    latency = &latency_modes[m];
+            if (!latency) {
+                printf("Error: unknown latency mode %s (low, balanced or power)\n", argv[i] + 10);
+                return 1;
+            }
         }
+        else
+            argv[1 + files++] = argv[i];
+    }
+
+    if (analyze_path)
+        return analyze_library();
+
+    if (thumb_width && files > 0)
+        return render_pngs(argv + 1, files);
+    if (mix_mode && files > 0)
+        return mix_files(argv + 1, files);
+
+    if (files == 0){
+        printf("Error: No audio file specified.\n");
+        printf("Usage: ./audio_player [--metrics=out.json|out.csv] [--seek-fade=MS] [--latency=low|balanced|power] [--resampler=sdl|fast|medium|best] [--eq=[L|H]FREQ:GAIN_DB[:Q],...] [--limiter=DB|off] [--dsp=off] [--normalize=LUFS|off] file.wav|file.flac|file.mp3|file.ogg|list.m3u ...\n");
+        printf("       ./audio_player --analyze=DIR|LIST [--index=library.idx]\n");
+        printf("       ./audio_player --render-png=WIDTHxHEIGHT [--png-dir=DIR] file|list.m3u ...\n");
+        printf("       ./audio_player --mix file|list.m3u ...\n");
+        printf("Decoders built in: %s\n", decoder_backends()[0] ? decoder_backends() : "none");
+        return 1;
+    }
+
+    if (playlist_init(&playlist, argv + 1, files) < 0){
+        fprintf(stderr, "playlist_init failed: %s\n", SDL_GetError());
+        playlist_free(&playlist);
+        return 1;
+    }
 
-        peaks[i] = peak / 32767.0;
+    metrics_init(&metrics);
+
+    if (setup() < 0){
+        cleanup();
+        return 1;
     }
-    return peaks;
+
+    mainloop();
+
+    cleanup();
+
+    return 0;
 }
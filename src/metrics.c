@@ -0,0 +1,137 @@
+#include <stdio.h>
+
+#include "metrics.h"
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static int bucket_of(Uint64 ns){
+    int b = (ns > 1) ? 63 - __builtin_clzll(ns) : 0;
+    return (b < METRICS_BUCKETS) ? b : METRICS_BUCKETS - 1;
+}
+
+static Uint64 load(const _Atomic Uint64 *v){
+    return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+static void histogram_init(struct metrics_histogram *h){
+    for (int b = 0; b < METRICS_BUCKETS; b++)
+        atomic_init(&h->buckets[b], 0);
+    atomic_init(&h->count, 0);
+    atomic_init(&h->sum_ns, 0);
+    atomic_init(&h->max_ns, 0);
+}
+
+static void csv_histogram(FILE *f, const char *name, const struct metrics_histogram *h){
+    fprintf(f, "%s_count,%llu\n", name, (unsigned long long)load(&h->count));
+    fprintf(f, "%s_mean_ns,%llu\n", name, (unsigned long long)metrics_mean(h));
+    fprintf(f, "%s_p50_ns,%llu\n", name, (unsigned long long)metrics_percentile(h, 0.50));
+    fprintf(f, "%s_p99_ns,%llu\n", name, (unsigned long long)metrics_percentile(h, 0.99));
+    fprintf(f, "%s_max_ns,%llu\n", name, (unsigned long long)load(&h->max_ns));
+}
+
+static void json_histogram(FILE *f, const char *name, const struct metrics_histogram *h){
+    fprintf(f, "  \"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, "
+               "\"p99_ns\": %llu, \"max_ns\": %llu,\n    \"buckets_log2_ns\": [",
+            name, (unsigned long long)load(&h->count), (unsigned long long)metrics_mean(h),
+            (unsigned long long)metrics_percentile(h, 0.50),
+            (unsigned long long)metrics_percentile(h, 0.99), (unsigned long long)load(&h->max_ns));
+    for (int b = 0; b < METRICS_BUCKETS; b++)
+        fprintf(f, "%s%llu", b ? ", " : "", (unsigned long long)load(&h->buckets[b]));
+    fprintf(f, "]},\n");
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+void metrics_init(struct metrics *m){
+    histogram_init(&m->callback);
+    histogram_init(&m->interval);
+    histogram_init(&m->frame);
+    histogram_init(&m->seek);
+    histogram_init(&m->fft);
+    histogram_init(&m->dsp_eq);
+    histogram_init(&m->dsp_limiter);
+    atomic_init(&m->callbacks, 0);
+    atomic_init(&m->underruns, 0);
+    atomic_init(&m->bytes_requested, 0);
+    atomic_init(&m->bytes_supplied, 0);
+    m->last_callback_ns = 0;
+}
+
+void metrics_record(struct metrics_histogram *h, Uint64 ns){
+    metrics_add(&h->buckets[bucket_of(ns)], 1);
+    metrics_add(&h->sum_ns, ns);
+    if (ns > load(&h->max_ns))
+        atomic_store_explicit(&h->max_ns, ns, memory_order_relaxed);
+    metrics_add(&h->count, 1);
+}
+
+Uint64 metrics_percentile(const struct metrics_histogram *h, double p){
+    const Uint64 count = load(&h->count);
+    if (count == 0)
+        return 0;
+
+    const Uint64 rank = (Uint64)(p * (double)count);
+    const Uint64 max = load(&h->max_ns);
+    Uint64 seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += load(&h->buckets[b]);
+        if (seen > rank) {
+            Uint64 upper = (1ull << (b + 1)) - 1;
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
+
+Uint64 metrics_mean(const struct metrics_histogram *h){
+    const Uint64 count = load(&h->count);
+    return count ? load(&h->sum_ns) / count : 0;
+}
+
+int metrics_dump(const struct metrics *m, const char *path){
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        SDL_SetError("cannot write %s", path);
+        return -1;
+    }
+
+    const size_t len = SDL_strlen(path);
+    if (len >= 4 && SDL_strcasecmp(path + len - 4, ".csv") == 0) {
+        fprintf(f, "metric,value\n");
+        fprintf(f, "callbacks,%llu\n", (unsigned long long)load(&m->callbacks));
+        fprintf(f, "underruns,%llu\n", (unsigned long long)load(&m->underruns));
+        fprintf(f, "bytes_requested,%llu\n", (unsigned long long)load(&m->bytes_requested));
+        fprintf(f, "bytes_supplied,%llu\n", (unsigned long long)load(&m->bytes_supplied));
+        csv_histogram(f, "callback", &m->callback);
+        csv_histogram(f, "interval", &m->interval);
+        csv_histogram(f, "frame", &m->frame);
+        csv_histogram(f, "seek", &m->seek);
+        csv_histogram(f, "fft", &m->fft);
+        csv_histogram(f, "dsp_eq", &m->dsp_eq);
+        csv_histogram(f, "dsp_limiter", &m->dsp_limiter);
+    } else {
+        fprintf(f, "{\n");
+        json_histogram(f, "callback", &m->callback);
+        json_histogram(f, "interval", &m->interval);
+        json_histogram(f, "frame", &m->frame);
+        json_histogram(f, "seek", &m->seek);
+        json_histogram(f, "fft", &m->fft);
+        json_histogram(f, "dsp_eq", &m->dsp_eq);
+        json_histogram(f, "dsp_limiter", &m->dsp_limiter);
+        fprintf(f, "  \"callbacks\": %llu,\n", (unsigned long long)load(&m->callbacks));
+        fprintf(f, "  \"underruns\": %llu,\n", (unsigned long long)load(&m->underruns));
+        fprintf(f, "  \"bytes_requested\": %llu,\n", (unsigned long long)load(&m->bytes_requested));
+        fprintf(f, "  \"bytes_supplied\": %llu\n", (unsigned long long)load(&m->bytes_supplied));
+        fprintf(f, "}\n");
+    }
+
+    if (fclose(f) != 0) {
+        SDL_SetError("cannot write %s", path);
+        return -1;
+    }
+    return 0;
+}
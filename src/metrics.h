@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// one bucket per power of two nanoseconds
+#define METRICS_BUCKETS 40
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * metrics_histogram
+ *
+ * Log2 histogram of durations in nanoseconds: bucket b counts samples in
+ * [2^b, 2^(b+1)) ns, the last bucket everything above. Written by one
+ * thread only, with relaxed atomic stores, so recording never waits and
+ * other threads may read it at any time. A reader can see a sample in
+ * `count` before it shows up in its bucket, never a torn value.
+ */
+struct metrics_histogram {
+    _Atomic Uint64 buckets[METRICS_BUCKETS];
+    _Atomic Uint64 count;
+    _Atomic Uint64 sum_ns;
+    _Atomic Uint64 max_ns;
+};
+
+/**
+ * metrics
+ *
+ * Counters of the playback path and the UI:
+ * - callback:        time spent inside the audio callback
+ * - interval:        time from one callback's start to the next one's
+ * - frame:           CPU time of one UI frame, up to (not including) present
+ * - seek:            from a seek request to its first samples entering the
+ *                    (flushed) stream, i.e. audible after the device buffer
+ * - fft:             one spectrum analysis (window, FFT, bands), written by
+ *                    the spectrum thread
+ * - dsp_eq, dsp_limiter: one block through that stage of the DSP chain
+ * - underruns:       callbacks that supplied less than requested before
+ *                    the end of the track
+ * - bytes_requested: sum of what SDL asked the callback for
+ * - bytes_supplied:  sum of the track audio the callback put into the
+ *                    stream (not the silence after the end); both in the
+ *                    stream's input format, so they compare with or
+ *                    without a resampler or DSP chain
+ *
+ * Everything but `frame` and `fft` is written by the audio thread.
+ */
+struct metrics {
+    struct metrics_histogram callback;
+    struct metrics_histogram interval;
+    struct metrics_histogram frame;
+    struct metrics_histogram seek;
+    struct metrics_histogram fft;
+    struct metrics_histogram dsp_eq;
+    struct metrics_histogram dsp_limiter;
+    _Atomic Uint64 callbacks;
+    _Atomic Uint64 underruns;
+    _Atomic Uint64 bytes_requested;
+    _Atomic Uint64 bytes_supplied;
+    Uint64 last_callback_ns;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+void metrics_init(struct metrics *m);
+
+// add one sample; only ever called from the histogram's writer thread
+void metrics_record(struct metrics_histogram *h, Uint64 ns);
+
+// relaxed add for counters written by a single thread
+static inline void metrics_add(_Atomic Uint64 *counter, Uint64 n){
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+/**
+ * Upper bound of the duration below which a fraction `p` (0..1) of the
+ * samples fall, at the histogram's power-of-two resolution and clamped to
+ * the largest sample seen.
+ */
+Uint64 metrics_percentile(const struct metrics_histogram *h, double p);
+
+Uint64 metrics_mean(const struct metrics_histogram *h);
+
+/**
+ * Write a snapshot of `m` to `path`: CSV (one metric,value row each) when
+ * the name ends in ".csv", JSON with the full histograms otherwise.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int metrics_dump(const struct metrics *m, const char *path);
@@ -0,0 +1,409 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "mixer.h"
+#include "sample.h"
+
+static void mix_scalar(float *out, const float *src, int frames, int stride,
+                       float left, float right, float step_left, float step_right);
+
+static mixer_mix_fn mix_impl = mix_scalar;
+static mixer_load_fn load_s16le_impl = NULL;
+static const char *isa = "scalar";
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// Kernels
+// =============================================================================
+
+/*
+ * Add `frames` frames of one voice into the stereo sum `out`. The voice
+ * has `stride` channels per frame: a mono one goes to both sides, wider
+ * ones give their first two channels. The gains start at `left`/`right`
+ * and move by `step_*` per frame, so a parameter change is a ramp over
+ * the block instead of a click.
+ */
+static void mix_scalar(float *out, const float *src, int frames, int stride,
+                       float left, float right, float step_left, float step_right){
+    const int second = (stride > 1) ? 1 : 0;
+    for (int i = 0; i < frames; i++, src += stride, out += 2) {
+        out[0] += src[0] * (left + step_left * i);
+        out[1] += src[second] * (right + step_right * i);
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * Four frames per iteration, in lanes L R L R: a mono voice has its
+ * samples duplicated into pairs, a stereo one is already laid out like
+ * the sum. Wider voices would need a gather for two channels out of many,
+ * so they stay scalar.
+ */
+__attribute__((target("sse2")))
+static void mix_sse2(float *out, const float *src, int frames, int stride,
+                     float left, float right, float step_left, float step_right){
+    if (stride > 2) {
+        mix_scalar(out, src, frames, stride, left, right, step_left, step_right);
+        return;
+    }
+
+    __m128 g0 = _mm_setr_ps(left, right, left + step_left, right + step_right);
+    __m128 g1 = _mm_add_ps(g0, _mm_setr_ps(2 * step_left, 2 * step_right, 2 * step_left, 2 * step_right));
+    const __m128 step = _mm_setr_ps(4 * step_left, 4 * step_right, 4 * step_left, 4 * step_right);
+
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 lo, hi;
+        if (stride == 1) {
+            const __m128 x = _mm_loadu_ps(src + i);
+            lo = _mm_unpacklo_ps(x, x);
+            hi = _mm_unpackhi_ps(x, x);
+        } else {
+            lo = _mm_loadu_ps(src + 2 * i);
+            hi = _mm_loadu_ps(src + 2 * i + 4);
+        }
+        _mm_storeu_ps(out + 2 * i, _mm_add_ps(_mm_loadu_ps(out + 2 * i), _mm_mul_ps(lo, g0)));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(out + 2 * i + 4), _mm_mul_ps(hi, g1)));
+        g0 = _mm_add_ps(g0, step);
+        g1 = _mm_add_ps(g1, step);
+    }
+
+    mix_scalar(out + 2 * i, src + i * stride, frames - i, stride,
+               left + step_left * i, right + step_right * i, step_left, step_right);
+}
+
+/*
+ * s16 is what most voices are, and converting it sample by sample costs
+ * more than mixing it: eight at a time, widened by unpacking into the
+ * high halves and shifting back with the sign.
+ */
+__attribute__((target("sse2")))
+static void load_s16le_sse2(const Uint8 *p, int frames, int channels, float *out){
+    const int n = frames * channels;
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(p + 2 * i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(zero, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(zero, x), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    for (; i < n; i++)
+        out[i] = load_s16le(p + 2 * i);
+}
+
+#endif
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2()) {
+        mix_impl = mix_sse2;
+        load_s16le_impl = load_s16le_sse2;
+        isa = "sse2";
+    }
+#endif
+}
+
+// one interleaved loader per sample format, instantiated from SAMPLE_FORMATS
+static inline __attribute__((always_inline))
+void load_interleaved(const Uint8 *p, int frames, int channels, float *out,
+                      float (*load)(const Uint8 *), const int size){
+    for (int i = 0; i < frames * channels; i++, p += size)
+        out[i] = load(p);
+}
+
+#define DEFINE_LOAD_INTERLEAVED(name, format)                                                  \
+    static void load_interleaved_##name(const Uint8 *p, int frames, int channels, float *out){ \
+        load_interleaved(p, frames, channels, out, load_##name, SDL_AUDIO_BYTESIZE(format));  \
+    }
+
+SAMPLE_FORMATS(DEFINE_LOAD_INTERLEAVED)
+
+static mixer_load_fn pick_load(SDL_AudioFormat format){
+    if (format == SDL_AUDIO_S16LE && load_s16le_impl)
+        return load_s16le_impl;
+
+#define PICK_LOAD_INTERLEAVED(name, fmt) \
+    if (format == fmt) return load_interleaved_##name;
+    SAMPLE_FORMATS(PICK_LOAD_INTERLEAVED)
+#undef PICK_LOAD_INTERLEAVED
+
+    return NULL;
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+/*
+ * Gains of the two sides for `gain` at `pan`: a mono voice is placed with
+ * the constant-power law (-3 dB each in the middle), a stereo one keeps
+ * both sides at `gain` in the middle and turns the other side down.
+ */
+static void pan_gains(const struct audio_track *t, float gain, float pan, float *left, float *right){
+    if (pan < -1.0f) pan = -1.0f;
+    if (pan > 1.0f) pan = 1.0f;
+
+    if (t->spec.channels == 1) {
+        const float angle = (pan + 1.0f) * (float)(M_PI / 4);
+        *left = gain * cosf(angle);
+        *right = gain * sinf(angle);
+    } else {
+        *left = gain * ((pan > 0.0f) ? 1.0f - pan : 1.0f);
+        *right = gain * ((pan < 0.0f) ? 1.0f + pan : 1.0f);
+    }
+}
+
+/*
+ * Up to `want` frames of the voice at `pos` as f32, contiguous: straight
+ * from the mapping or the decoder's ring when the track is f32 already,
+ * else converted into `scratch`.
+ */
+static int voice_peek(struct mixer_voice *v, Uint64 pos, int want, float *scratch, const float **src){
+    const struct audio_track *t = v->track;
+    Uint64 n;
+    const Uint8 *p;
+    if (t->decoded) {
+        const float *f;
+        n = decoder_stream_peek(t->decoded, &f);
+        p = (const Uint8 *)f;
+    } else {
+        n = (pos < t->frames) ? t->frames - pos : 0;
+        p = t->buf + pos * SDL_AUDIO_FRAMESIZE(t->spec);
+    }
+    if (n > (Uint64)want)
+        n = (Uint64)want;
+
+    if (v->load && n > 0) {
+        v->load(p, (int)n, t->spec.channels, scratch);
+        *src = scratch;
+    } else {
+        *src = (const float *)p;
+    }
+    return (int)n;
+}
+
+static int voice_done(const struct mixer_voice *v, Uint64 pos){
+    const struct audio_track *t = v->track;
+    return pos >= t->frames || (t->decoded && decoder_stream_ended(t->decoded));
+}
+
+static void voice_restart(struct mixer_voice *v, Uint64 pos){
+    if (v->track->decoded)
+        decoder_stream_seek(v->track->decoded, pos);
+}
+
+// add the next `frames` frames of `v` into `out`, freeing the slot when it ends
+static void render_voice(struct mixer *m, struct mixer_voice *v, float *out, int frames){
+    const int state = atomic_load_explicit(&v->state, memory_order_acquire);
+    if (state != MIXER_VOICE_PLAYING && state != MIXER_VOICE_STOPPING)
+        return;
+
+    struct audio_track *t = v->track;
+    Uint64 pos = atomic_load_explicit(&v->pos, memory_order_relaxed);
+    // most blocks have no seek: skip the locked exchange for them
+    const Sint64 seek = (atomic_load_explicit(&v->seek_to, memory_order_relaxed) == NO_SEEK) ? NO_SEEK
+        : atomic_exchange_explicit(&v->seek_to, NO_SEEK, memory_order_acquire);
+    if (seek != NO_SEEK) {
+        pos = ((Uint64)seek < t->frames) ? (Uint64)seek : t->frames;
+        voice_restart(v, pos);
+    }
+
+    float left = 0.0f, right = 0.0f;
+    if (state == MIXER_VOICE_PLAYING) {
+        const float gain = atomic_load_explicit(&v->gain, memory_order_relaxed);
+        const float pan = atomic_load_explicit(&v->pan, memory_order_relaxed);
+        if (gain != v->applied_gain || pan != v->applied_pan) {
+            pan_gains(t, gain, pan, &v->target_left, &v->target_right);
+            v->applied_gain = gain;
+            v->applied_pan = pan;
+        }
+        left = v->target_left;
+        right = v->target_right;
+    }
+    const float step_left = (left - v->left) / frames;
+    const float step_right = (right - v->right) / frames;
+
+    int mixed = 0, ended = 0;
+    while (mixed < frames) {
+        const float *src;
+        const int n = voice_peek(v, pos, frames - mixed, m->scratch, &src);
+        if (n == 0) {
+            if (!voice_done(v, pos))
+                break;          // a decoder behind: silent for the rest of the block
+            if (!v->loop || pos == 0) {
+                ended = 1;
+                break;
+            }
+            pos = 0;
+            voice_restart(v, pos);
+            continue;
+        }
+
+        mix_impl(out + 2 * mixed, src, n, t->spec.channels,
+                 v->left + step_left * mixed, v->right + step_right * mixed, step_left, step_right);
+        if (t->decoded)
+            decoder_stream_consume(t->decoded, (Uint64)n);
+        pos += (Uint64)n;
+        mixed += n;
+    }
+
+    v->left = left;
+    v->right = right;
+    atomic_store_explicit(&v->pos, pos, memory_order_release);
+    if (ended || state == MIXER_VOICE_STOPPING)
+        atomic_store_explicit(&v->state, MIXER_VOICE_FREE, memory_order_release);
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int mixer_init(struct mixer *m, int freq, int max_voices){
+    SDL_zerop(m);
+    pthread_once(&dispatch_once, dispatch);
+
+    if (freq <= 0 || max_voices < 1) {
+        SDL_SetError("no mixer for %d voices at %d Hz", max_voices, freq);
+        return -1;
+    }
+    m->freq = freq;
+    m->max_voices = max_voices;
+    atomic_init(&m->active, 0);
+
+    m->voices = calloc((size_t)max_voices, sizeof *m->voices);
+    m->mix = malloc((size_t)MIXER_BLOCK_FRAMES * MIXER_CHANNELS * sizeof *m->mix);
+    m->scratch = malloc((size_t)MIXER_BLOCK_FRAMES * MIXER_MAX_SOURCE_CHANNELS * sizeof *m->scratch);
+    if (!m->voices || !m->mix || !m->scratch) {
+        mixer_free(m);
+        SDL_OutOfMemory();
+        return -1;
+    }
+    for (int i = 0; i < max_voices; i++) {
+        atomic_init(&m->voices[i].state, MIXER_VOICE_FREE);
+        atomic_init(&m->voices[i].seek_to, NO_SEEK);
+    }
+    return 0;
+}
+
+void mixer_free(struct mixer *m){
+    free(m->voices);
+    free(m->mix);
+    free(m->scratch);
+    m->voices = NULL;
+    m->mix = m->scratch = NULL;
+    m->max_voices = 0;
+}
+
+int mixer_play(struct mixer *m, struct audio_track *t, float gain, float pan, int loop){
+    mixer_load_fn load = pick_load(t->spec.format);
+    if (t->spec.freq != m->freq || t->spec.channels < 1
+        || t->spec.channels > MIXER_MAX_SOURCE_CHANNELS || (!t->decoded && !load)) {
+        SDL_SetError("cannot mix %d channels at %d Hz into %d Hz", t->spec.channels, t->spec.freq, m->freq);
+        return -1;
+    }
+
+    for (int i = 0; i < m->max_voices; i++) {
+        struct mixer_voice *v = &m->voices[i];
+        int expected = MIXER_VOICE_FREE;
+        if (!atomic_compare_exchange_strong_explicit(&v->state, &expected, MIXER_VOICE_SETUP,
+                                                     memory_order_acquire, memory_order_relaxed))
+            continue;
+
+        v->track = t;
+        // f32 in the host's order (always so for a decoder) is mixed in place
+        v->load = (t->decoded || t->spec.format == SDL_AUDIO_F32) ? NULL : load;
+        v->loop = loop;
+        atomic_store_explicit(&v->gain, gain, memory_order_relaxed);
+        atomic_store_explicit(&v->pan, pan, memory_order_relaxed);
+        atomic_store_explicit(&v->seek_to, NO_SEEK, memory_order_relaxed);
+        atomic_store_explicit(&v->pos, 0, memory_order_relaxed);
+        pan_gains(t, gain, pan, &v->left, &v->right);
+        v->applied_gain = gain;
+        v->applied_pan = pan;
+        v->target_left = v->left;
+        v->target_right = v->right;
+
+        int active = atomic_load_explicit(&m->active, memory_order_relaxed);
+        while (active <= i
+               && !atomic_compare_exchange_weak_explicit(&m->active, &active, i + 1,
+                                                         memory_order_relaxed, memory_order_relaxed))
+            ;
+        atomic_store_explicit(&v->state, MIXER_VOICE_PLAYING, memory_order_release);
+        return i;
+    }
+
+    SDL_SetError("all %d voices are playing", m->max_voices);
+    return -1;
+}
+
+void mixer_set(struct mixer *m, int voice, float gain, float pan){
+    struct mixer_voice *v = &m->voices[voice];
+    atomic_store_explicit(&v->gain, gain, memory_order_relaxed);
+    atomic_store_explicit(&v->pan, pan, memory_order_relaxed);
+}
+
+void mixer_seek(struct mixer *m, int voice, Uint64 frame){
+    atomic_store_explicit(&m->voices[voice].seek_to, (Sint64)frame, memory_order_release);
+}
+
+void mixer_stop(struct mixer *m, int voice){
+    int expected = MIXER_VOICE_PLAYING;
+    atomic_compare_exchange_strong_explicit(&m->voices[voice].state, &expected, MIXER_VOICE_STOPPING,
+                                            memory_order_relaxed, memory_order_relaxed);
+}
+
+int mixer_voice_active(const struct mixer *m, int voice){
+    return atomic_load_explicit(&m->voices[voice].state, memory_order_acquire) != MIXER_VOICE_FREE;
+}
+
+Uint64 mixer_voice_position(const struct mixer *m, int voice){
+    return atomic_load_explicit(&m->voices[voice].pos, memory_order_acquire);
+}
+
+void mixer_render(struct mixer *m, float *out, int frames){
+    for (int done = 0; done < frames; done += MIXER_BLOCK_FRAMES) {
+        const int n = (frames - done < MIXER_BLOCK_FRAMES) ? frames - done : MIXER_BLOCK_FRAMES;
+        float *block = out + (size_t)done * MIXER_CHANNELS;
+        SDL_memset(block, 0, (size_t)n * MIXER_CHANNELS * sizeof *block);
+
+        const int active = atomic_load_explicit(&m->active, memory_order_acquire);
+        for (int i = 0; i < active; i++)
+            render_voice(m, &m->voices[i], block, n);
+    }
+}
+
+void mixer_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount){
+    struct mixer *m = userdata;
+    const int block_bytes = MIXER_BLOCK_FRAMES * MIXER_CHANNELS * (int)sizeof(float);
+
+    for (int left = additional_amount; left > 0; left -= block_bytes) {
+        mixer_render(m, m->mix, MIXER_BLOCK_FRAMES);
+        SDL_PutAudioStreamData(stream, m->mix, block_bytes);
+    }
+}
+
+const char *mixer_isa(void){
+    pthread_once(&dispatch_once, dispatch);
+    return isa;
+}
+
+int mixer_kernels(struct mixer_kernel out[MIXER_MAX_KERNELS]){
+    int n = 0;
+    out[n++] = (struct mixer_kernel){ "scalar", mix_scalar, load_interleaved_s16le };
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2())
+        out[n++] = (struct mixer_kernel){ "sse2", mix_sse2, load_s16le_sse2 };
+#endif
+    return n;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+#include "audio.h"
+
+/**
+ * Mixer of many simultaneous voices (stems, cues, previews) into one f32
+ * stereo stream. Every voice plays an open audio_track at its own gain,
+ * pan and position; all of them are summed in float in one callback, and
+ * the stream converts the sum to the device's format once.
+ *
+ * Only `--mix` and the bench drive it so far: the player's own playback
+ * (gapless switches, seek crossfades, resampling, the DSP chain, the
+ * clock) still runs through audio_buffer and audio_callback on a stream
+ * of its own.
+ */
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MIXER_CHANNELS 2
+
+// frames mixed at a time; the voices' parameters ramp over one block
+#define MIXER_BLOCK_FRAMES 256
+
+// channels a voice's track may have; past the first two they are not heard
+#define MIXER_MAX_SOURCE_CHANNELS 16
+
+typedef enum {
+    MIXER_VOICE_FREE = 0,
+    MIXER_VOICE_SETUP,
+    MIXER_VOICE_PLAYING,
+    MIXER_VOICE_STOPPING
+} mixer_voice_state;
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+// interleaved f32 of `frames` interleaved frames of some format at `p`
+typedef void (*mixer_load_fn)(const Uint8 *p, int frames, int channels, float *out);
+
+/*
+ * Add `frames` frames of a voice with `stride` channels into the stereo
+ * sum `out`, at gains starting from `left`/`right` and moving by `step_*`
+ * per frame.
+ */
+typedef void (*mixer_mix_fn)(float *out, const float *src, int frames, int stride,
+                             float left, float right, float step_left, float step_right);
+
+/**
+ * mixer_kernel
+ *
+ * One built-in implementation of the mixer's inner loops:
+ * - isa:        its name, as mixer_isa() reports it
+ * - mix:        adds a voice into the sum; voices wider than stereo run scalar
+ * - load_s16le: converts s16 voices to f32
+ */
+struct mixer_kernel {
+    const char *isa;
+    mixer_mix_fn mix;
+    mixer_load_fn load_s16le;
+};
+
+// scalar and SSE2
+#define MIXER_MAX_KERNELS 2
+
+/*
+ * Largest difference allowed between a sample of a vector kernel's sum
+ * and the scalar reference's, relative to the reference's largest sample.
+ * The SSE2 mix steps its gains by repeated addition where the scalar one
+ * multiplies, so a ramp drifts by up to ~1e-6 by the end of a block. The
+ * s16 loaders are exact: every s16 sample is a float after the scale by a
+ * power of 2.
+ */
+#define MIXER_KERNEL_TOLERANCE 1e-5f
+
+/**
+ * mixer_voice
+ *
+ * One slot of the mixer. The UI claims a free slot, fills it in and
+ * publishes it by storing MIXER_VOICE_PLAYING (release); from then on the
+ * callback owns everything but the requests, and frees the slot when the
+ * voice ends or has faded out after a stop:
+ * - track:      what is played; must stay open while the slot is not free,
+ *               and a decoded one must not be played anywhere else
+ * - load:       converts the track's format, NULL when it is f32 already
+ *               and is mixed straight from the track
+ * - loop:       start over at the end instead of ending
+ * - gain, pan:  requested by the UI, applied from the next block
+ *               (pan -1 left .. 1 right)
+ * - seek_to:    requested frame or NO_SEEK, taken by the callback
+ * - pos:        frame the callback is at, published with release
+ * - left, right: gains in effect at the end of the last block (callback only)
+ * - applied_gain, applied_pan, target_left, target_right: the request the
+ *               callback last turned into gains, and those gains, so the
+ *               pan law only runs on a change (callback only)
+ */
+struct mixer_voice {
+    _Atomic int state;
+    struct audio_track *track;
+    mixer_load_fn load;
+    int loop;
+    _Atomic float gain;
+    _Atomic float pan;
+    _Atomic Sint64 seek_to;
+    _Atomic Uint64 pos;
+    float left;
+    float right;
+    float applied_gain;
+    float applied_pan;
+    float target_left;
+    float target_right;
+};
+
+/**
+ * mixer
+ *
+ * - freq:        rate of the mix; every voice's track must be at it
+ * - voices, max_voices: the slots
+ * - active:      one past the highest slot ever claimed, so the callback
+ *                only walks the part in use
+ * - mix, scratch: a block of the sum, and of one voice converted to f32
+ *
+ * Mixing never allocates or waits.
+ */
+struct mixer {
+    int freq;
+    struct mixer_voice *voices;
+    int max_voices;
+    _Atomic int active;
+    float *mix;
+    float *scratch;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Get `m` ready to mix up to `max_voices` voices at `freq` Hz.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int mixer_init(struct mixer *m, int freq, int max_voices);
+
+// only once no stream pulls from `m` anymore
+void mixer_free(struct mixer *m);
+
+/**
+ * Start `t` from its first frame at `gain` and `pan`, from the next block
+ * on, looping if `loop` is set.
+ *
+ * @return the voice, valid until it ends (see mixer_voice_active), or -1
+ *         when `t` cannot be mixed or every slot is taken (see SDL_GetError)
+ */
+int mixer_play(struct mixer *m, struct audio_track *t, float gain, float pan, int loop);
+
+// new gain and pan of `voice`, ramped to over the next block
+void mixer_set(struct mixer *m, int voice, float gain, float pan);
+
+void mixer_seek(struct mixer *m, int voice, Uint64 frame);
+
+// fade `voice` out over the next block and free its slot
+void mixer_stop(struct mixer *m, int voice);
+
+// 0 once `voice` has ended and its track may be closed
+int mixer_voice_active(const struct mixer *m, int voice);
+
+Uint64 mixer_voice_position(const struct mixer *m, int voice);
+
+/**
+ * Mix the next `frames` frames of every playing voice into `out`, as
+ * interleaved f32 stereo. Only one thread may render at a time.
+ */
+void mixer_render(struct mixer *m, float *out, int frames);
+
+/**
+ * SDL_AudioStreamCallback feeding a stream of f32 stereo at m->freq from
+ * the struct mixer passed as `userdata`, in whole blocks.
+ */
+void mixer_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
+
+// kernel the mixer runs on this CPU, e.g. "sse2"
+const char *mixer_isa(void);
+
+/**
+ * Every kernel built in that this CPU can run, scalar first, so they can
+ * be checked against each other.
+ *
+ * @return how many were written to `out`
+ */
+int mixer_kernels(struct mixer_kernel out[MIXER_MAX_KERNELS]);
@@ -0,0 +1,198 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "playlist.h"
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static int has_suffix(const char *s, const char *suffix){
+    const size_t n = SDL_strlen(s), m = SDL_strlen(suffix);
+    return n >= m && SDL_strcasecmp(s + n - m, suffix) == 0;
+}
+
+static int add_entry(struct playlist *pl, const char *path){
+    struct playlist_entry *entries = realloc(pl->entries, (pl->count + 1) * sizeof *entries);
+    if (!entries) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    pl->entries = entries;
+
+    struct playlist_entry *e = &entries[pl->count];
+    SDL_zerop(e);
+    e->path = SDL_strdup(path);
+    if (!e->path) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    atomic_init(&e->state, PLAYLIST_UNLOADED);
+    pl->count++;
+    return 0;
+}
+
+static int add_m3u(struct playlist *pl, const char *list){
+    FILE *f = fopen(list, "r");
+    if (!f) {
+        SDL_SetError("cannot open playlist %s", list);
+        return -1;
+    }
+
+    // entries are relative to the list's own directory
+    const char *slash = strrchr(list, '/');
+    const int dir_len = slash ? (int)(slash - list) + 1 : 0;
+
+    char line[PATH_MAX];
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof line, f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        if (line[0] == '/' || dir_len == 0) {
+            rc = add_entry(pl, line);
+        } else {
+            char path[PATH_MAX * 2];
+            snprintf(path, sizeof path, "%.*s%s", dir_len, list, line);
+            rc = add_entry(pl, path);
+        }
+    }
+
+    fclose(f);
+    return rc;
+}
+
+/**
+ * Map entry `index` and start its analysis, unless another thread got to
+ * it first. A failed analysis only costs the waveform, the track still plays.
+ */
+static int load_entry(struct playlist *pl, int index){
+    struct playlist_entry *e = &pl->entries[index];
+
+    int expected = PLAYLIST_UNLOADED;
+    if (!atomic_compare_exchange_strong(&e->state, &expected, PLAYLIST_LOADING))
+        return (expected == PLAYLIST_FAILED) ? -1 : 0;
+
+    if (audio_track_open(&e->track, e->path) < 0) {
+        atomic_store(&e->state, PLAYLIST_FAILED);
+        return -1;
+    }
+    e->track.index = index;
+
+    if (analysis_start(&e->analysis, &e->waveform, e->path, &e->track) < 0)
+        fprintf(stderr, "analysis_start failed for %s: %s\n", e->path, SDL_GetError());
+
+    atomic_store_explicit(&e->state, PLAYLIST_LOADED, memory_order_release);
+    return 0;
+}
+
+static void *loader_main(void *arg){
+    struct playlist *pl = arg;
+
+    pthread_mutex_lock(&pl->mu);
+    while (!pl->stopping) {
+        if (pl->request < 0) {
+            pthread_cond_wait(&pl->wake, &pl->mu);
+            continue;
+        }
+
+        const int index = pl->request;
+        pl->request = -1;
+        pthread_mutex_unlock(&pl->mu);
+
+        if (load_entry(pl, index) < 0)
+            fprintf(stderr, "cannot load %s: %s\n", pl->entries[index].path, SDL_GetError());
+        else
+            DEBUG_PRINTF("prefetched track %d\n", index);
+
+        pthread_mutex_lock(&pl->mu);
+    }
+    pthread_mutex_unlock(&pl->mu);
+    return NULL;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int playlist_init(struct playlist *pl, char **paths, int count){
+    SDL_zerop(pl);
+    pthread_mutex_init(&pl->mu, NULL);
+    pthread_cond_init(&pl->wake, NULL);
+    pl->request = -1;
+
+    for (int i = 0; i < count; i++) {
+        int rc = (has_suffix(paths[i], ".m3u") || has_suffix(paths[i], ".m3u8"))
+            ? add_m3u(pl, paths[i])
+            : add_entry(pl, paths[i]);
+        if (rc < 0)
+            return -1;
+    }
+
+    if (pl->count == 0) {
+        SDL_SetError("the playlist is empty");
+        return -1;
+    }
+
+    if (pthread_create(&pl->loader, NULL, loader_main, pl) != 0) {
+        SDL_SetError("cannot start playlist loader thread");
+        return -1;
+    }
+    pl->loader_started = 1;
+    return 0;
+}
+
+int playlist_load(struct playlist *pl, int index){
+    return load_entry(pl, index);
+}
+
+void playlist_prefetch(struct playlist *pl, int index){
+    if (index < 0 || index >= pl->count)
+        return;
+
+    pthread_mutex_lock(&pl->mu);
+    pl->request = index;
+    pthread_cond_signal(&pl->wake);
+    pthread_mutex_unlock(&pl->mu);
+}
+
+void playlist_release(struct playlist *pl, int index){
+    if (index < 0 || index >= pl->count)
+        return;
+
+    struct playlist_entry *e = &pl->entries[index];
+    if (atomic_load(&e->state) != PLAYLIST_LOADED)
+        return;
+
+    analysis_stop(&e->analysis);
+    waveform_free(&e->waveform);
+    audio_track_close(&e->track);
+    SDL_zero(e->analysis);
+    atomic_store(&e->state, PLAYLIST_UNLOADED);
+}
+
+void playlist_free(struct playlist *pl){
+    if (pl->loader_started) {
+        pthread_mutex_lock(&pl->mu);
+        pl->stopping = 1;
+        pthread_cond_signal(&pl->wake);
+        pthread_mutex_unlock(&pl->mu);
+        pthread_join(pl->loader, NULL);
+        pl->loader_started = 0;
+    }
+
+    for (int i = 0; i < pl->count; i++) {
+        playlist_release(pl, i);
+        SDL_free(pl->entries[i].path);
+    }
+    free(pl->entries);
+    pl->entries = NULL;
+    pl->count = 0;
+
+    pthread_mutex_destroy(&pl->mu);
+    pthread_cond_destroy(&pl->wake);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "analysis.h"
+#include "audio.h"
+#include "waveform.h"
+
+typedef enum {
+    PLAYLIST_UNLOADED = 0,
+    PLAYLIST_LOADING,
+    PLAYLIST_LOADED,
+    PLAYLIST_FAILED
+} playlist_entry_state;
+
+/**
+ * playlist_entry
+ *
+ * One file of the playlist, only loaded around the time it plays:
+ * - track:    the mapped (or decoded) PCM the audio callback reads
+ * - waveform: its summary, built in the background by `analysis`
+ * - state:    playlist_entry_state; LOADED is published with release
+ *             semantics once track and analysis are set up
+ */
+struct playlist_entry {
+    char *path;
+    struct audio_track track;
+    struct waveform waveform;
+    struct analysis analysis;
+    _Atomic int state;
+};
+
+/**
+ * playlist
+ *
+ * The files to play in order, and a loader thread that prepares the next
+ * one while the current one plays:
+ * - request: entry the loader should load next, -1 for none (under mu)
+ */
+struct playlist {
+    struct playlist_entry *entries;
+    int count;
+    pthread_t loader;
+    int loader_started;
+    pthread_mutex_t mu;
+    pthread_cond_t wake;
+    int request;
+    int stopping;
+};
+
+/**
+ * Build the playlist from `paths`: audio files are played as given, .m3u
+ * and .m3u8 lists are expanded in place (relative entries are resolved
+ * against the list's directory, # lines are skipped).
+ *
+ * @return 0 on success, -1 on failure or when no file is left (see SDL_GetError)
+ */
+int playlist_init(struct playlist *pl, char **paths, int count);
+
+/**
+ * Load entry `index` on the calling thread, e.g. for the first track.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int playlist_load(struct playlist *pl, int index);
+
+// ask the loader thread to load entry `index`; poll the entry's state
+void playlist_prefetch(struct playlist *pl, int index);
+
+// stop the analysis and close entry `index` once nothing plays from it
+void playlist_release(struct playlist *pl, int index);
+
+void playlist_free(struct playlist *pl);
@@ -0,0 +1,161 @@
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "pool.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define POOL_MAX_WORKERS 63
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * pool_job
+ *
+ * One pool_parallel_for call, living on the caller's stack:
+ * - next:  next chunk to hand out, claimed with fetch_add
+ * - done:  chunks finished
+ * - users: workers currently inside the job (under pool_mu); the caller
+ *          may only return once this drops to zero
+ */
+struct pool_job {
+    pool_fn fn;
+    void *ctx;
+    Uint64 count;
+    Uint64 grain;
+    Uint64 chunks;
+    _Atomic Uint64 next;
+    _Atomic Uint64 done;
+    int users;
+    struct pool_job *link;
+};
+
+// =============================================================================
+// Globals
+// =============================================================================
+
+static pthread_mutex_t pool_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static pthread_t workers[POOL_MAX_WORKERS];
+static int worker_count = 0;
+static int stopping = 0;
+static struct pool_job *jobs = NULL;
+
+// =============================================================================
+// Workers
+// =============================================================================
+
+static void run_chunks(struct pool_job *job){
+    Uint64 c;
+    while ((c = atomic_fetch_add(&job->next, 1)) < job->chunks) {
+        Uint64 begin = c * job->grain;
+        Uint64 end = begin + job->grain;
+        if (end > job->count) end = job->count;
+
+        job->fn(job->ctx, begin, end);
+
+        if (atomic_fetch_add(&job->done, 1) + 1 == job->chunks) {
+            pthread_mutex_lock(&pool_mu);
+            pthread_cond_broadcast(&pool_idle);
+            pthread_mutex_unlock(&pool_mu);
+        }
+    }
+}
+
+static void *worker_main(void *arg){
+    pthread_mutex_lock(&pool_mu);
+    while (!stopping) {
+        struct pool_job *job = jobs;
+        while (job && atomic_load(&job->next) >= job->chunks)
+            job = job->link;
+
+        if (!job) {
+            pthread_cond_wait(&pool_work, &pool_mu);
+            continue;
+        }
+
+        job->users++;
+        pthread_mutex_unlock(&pool_mu);
+        run_chunks(job);
+        pthread_mutex_lock(&pool_mu);
+        if (--job->users == 0)
+            pthread_cond_broadcast(&pool_idle);
+    }
+    pthread_mutex_unlock(&pool_mu);
+    return NULL;
+}
+
+static void pool_start(void){
+    int n = SDL_GetNumLogicalCPUCores() - 1;
+    if (n > POOL_MAX_WORKERS) n = POOL_MAX_WORKERS;
+
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_main, NULL) != 0)
+            break;
+        worker_count++;
+    }
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+void pool_parallel_for(Uint64 count, Uint64 grain, pool_fn fn, void *ctx){
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    pthread_once(&pool_once, pool_start);
+
+    const Uint64 chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || worker_count == 0) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    struct pool_job job = {
+        .fn = fn, .ctx = ctx, .count = count, .grain = grain, .chunks = chunks,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.done, 0);
+
+    pthread_mutex_lock(&pool_mu);
+    struct pool_job **tail = &jobs;
+    while (*tail) tail = &(*tail)->link;
+    *tail = &job;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_mu);
+
+    run_chunks(&job);
+
+    pthread_mutex_lock(&pool_mu);
+    while (atomic_load(&job.done) < chunks || job.users > 0)
+        pthread_cond_wait(&pool_idle, &pool_mu);
+
+    struct pool_job **it = &jobs;
+    while (*it != &job) it = &(*it)->link;
+    *it = job.link;
+    pthread_mutex_unlock(&pool_mu);
+}
+
+int pool_threads(void){
+    pthread_once(&pool_once, pool_start);
+    return worker_count + 1;
+}
+
+void pool_shutdown(void){
+    pthread_mutex_lock(&pool_mu);
+    stopping = 1;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_mu);
+
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    worker_count = 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+/**
+ * Called with a sub-range [begin, end) of the items passed to
+ * pool_parallel_for. Ranges never overlap and together cover every item.
+ */
+typedef void (*pool_fn)(void *ctx, Uint64 begin, Uint64 end);
+
+/**
+ * Run `fn` over `count` items on the shared worker pool, `grain` items at a
+ * time, and return once every item is done. The calling thread works too,
+ * so this also makes progress when the pool could not be started. Safe to
+ * call from several threads at once.
+ */
+void pool_parallel_for(Uint64 count, Uint64 grain, pool_fn fn, void *ctx);
+
+// number of threads pool_parallel_for spreads work over (workers + caller)
+int pool_threads(void);
+
+void pool_shutdown(void);
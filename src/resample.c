@@ -0,0 +1,325 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define HAVE_X86_KERNELS 1
+#endif
+
+#include "resample.h"
+#include "sample.h"
+
+/**
+ * resample_profile
+ *
+ * Filter of one quality level:
+ * - taps:    length per phase; the cost per output sample and channel
+ * - rolloff: passband edge as a fraction of the lower Nyquist frequency
+ * - beta:    Kaiser window shape, higher for more stopband rejection
+ */
+struct resample_profile {
+    const char *name;
+    int taps;
+    double rolloff;
+    double beta;
+};
+
+static const struct resample_profile profiles[] = {
+    [RESAMPLE_SDL]    = { "sdl",    0,  0.0,   0.0  },
+    [RESAMPLE_FAST]   = { "fast",   16, 0.85,  6.0  },
+    [RESAMPLE_MEDIUM] = { "medium", 32, 0.90,  8.0  },
+    [RESAMPLE_BEST]   = { "best",   64, 0.945, 10.0 },
+};
+
+typedef float (*dot_fn)(const float *a, const float *b, int n);
+
+static float dot_scalar(const float *a, const float *b, int n);
+
+static dot_fn dot_impl = dot_scalar;
+static const char *isa = "scalar";
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// Kernels
+// =============================================================================
+
+static float dot_scalar(const float *a, const float *b, int n){
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    for (int i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// n is a multiple of 8 for every profile, so there is no tail to handle
+
+__attribute__((target("sse2")))
+static float dot_sse2(const float *a, const float *b, int n){
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2")))
+static float dot_avx2(const float *a, const float *b, int n){
+    __m256 acc = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+
+    const __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#endif
+
+static void dispatch(void){
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasAVX2()) {
+        dot_impl = dot_avx2;
+        isa = "avx2";
+    } else if (SDL_HasSSE2()) {
+        dot_impl = dot_sse2;
+        isa = "sse2";
+    }
+#endif
+}
+
+/*
+ * One deinterleaving loader per sample format, instantiated from
+ * SAMPLE_FORMATS like the waveform kernels.
+ */
+static inline __attribute__((always_inline))
+void load_planar(const Uint8 *p, int frames, int channels, float *out, int stride,
+                 float (*load)(const Uint8 *), const int size){
+    for (int i = 0; i < frames; i++)
+        for (int c = 0; c < channels; c++, p += size)
+            out[c * stride + i] = load(p);
+}
+
+#define DEFINE_LOAD_PLANAR(name, format)                                                   \
+    static void load_planar_##name(const Uint8 *p, int frames, int channels, float *out,  \
+                                   int stride){                                           \
+        load_planar(p, frames, channels, out, stride, load_##name, SDL_AUDIO_BYTESIZE(format)); \
+    }
+
+SAMPLE_FORMATS(DEFINE_LOAD_PLANAR)
+
+static resample_load_fn pick_load(SDL_AudioFormat format){
+#define PICK_LOAD_PLANAR(name, fmt) \
+    if (format == fmt) return load_planar_##name;
+    SAMPLE_FORMATS(PICK_LOAD_PLANAR)
+#undef PICK_LOAD_PLANAR
+
+    return NULL;
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static int gcd(int a, int b){
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// modified Bessel function of the first kind, order 0, for the Kaiser window
+static double bessel_i0(double x){
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * Design the prototype low-pass at in_rate * up and split it into `up`
+ * phases. Phase p holds h[up * (taps - 1 - t) + p] at t, so that it lines
+ * up with the input oldest first, and is scaled to a DC gain of exactly 1.
+ */
+static void design_bank(struct resampler *r, const struct resample_profile *prof){
+    const int n = r->up * r->taps;
+    const double lower = (r->in_rate < r->out_rate) ? r->in_rate : r->out_rate;
+    const double fc = 0.5 * lower * prof->rolloff / ((double)r->in_rate * r->up);
+    const double mid = (n - 1) / 2.0;
+    const double norm = bessel_i0(prof->beta);
+
+    for (int p = 0; p < r->up; p++) {
+        float *c = r->bank + (size_t)p * r->taps;
+        double sum = 0.0;
+
+        for (int t = 0; t < r->taps; t++) {
+            const double x = (double)(r->up * (r->taps - 1 - t) + p) - mid;
+            const double sinc = (x == 0.0) ? 2.0 * fc : sin(2.0 * SDL_PI_D * fc * x) / (SDL_PI_D * x);
+            const double edge = 2.0 * x / (n - 1);
+            const double w = bessel_i0(prof->beta * sqrt(fmax(0.0, 1.0 - edge * edge))) / norm;
+            c[t] = (float)(sinc * w);
+            sum += sinc * w;
+        }
+
+        for (int t = 0; t < r->taps; t++)
+            c[t] = (float)(c[t] / sum);
+    }
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int resampler_init(struct resampler *r, SDL_AudioFormat format, int channels,
+                   int in_rate, int out_rate, resample_quality quality){
+    SDL_zerop(r);
+    pthread_once(&dispatch_once, dispatch);
+
+    if (quality <= RESAMPLE_SDL || quality > RESAMPLE_BEST) {
+        SDL_SetError("no resampler for quality %d", (int)quality);
+        return -1;
+    }
+    if (channels < 1 || channels > RESAMPLE_MAX_CHANNELS || in_rate <= 0 || out_rate <= 0) {
+        SDL_SetError("cannot resample %d channels from %d to %d Hz", channels, in_rate, out_rate);
+        return -1;
+    }
+
+    const int g = gcd(in_rate, out_rate);
+    const struct resample_profile *prof = &profiles[quality];
+    r->channels = channels;
+    r->in_rate = in_rate;
+    r->out_rate = out_rate;
+    r->up = out_rate / g;
+    r->down = in_rate / g;
+    r->step = r->down / r->up;
+    r->rem = r->down % r->up;
+    r->taps = prof->taps;
+    r->load = pick_load(format);
+    if (r->up > RESAMPLE_MAX_PHASES || !r->load) {
+        SDL_SetError("cannot resample from %d to %d Hz (ratio %d/%d)", in_rate, out_rate, r->up, r->down);
+        return -1;
+    }
+
+    r->cap = r->taps + RESAMPLE_CHUNK;
+    const Uint64 max_out = resampler_out_frames(r, (Uint64)r->cap) + 1;
+    r->bank = malloc((size_t)r->up * r->taps * sizeof *r->bank);
+    r->hist = calloc((size_t)r->cap * channels, sizeof *r->hist);
+    r->out = malloc((size_t)max_out * channels * sizeof *r->out);
+    if (!r->bank || !r->hist || !r->out) {
+        resampler_free(r);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    design_bank(r, prof);
+    resampler_reset(r);
+    return 0;
+}
+
+void resampler_reset(struct resampler *r){
+    // half a filter of silence, so output n lines up with input n * down / up
+    for (int ch = 0; ch < r->channels; ch++)
+        SDL_memset(r->hist + ch * r->cap, 0, (size_t)(r->taps / 2) * sizeof *r->hist);
+    r->avail = r->taps / 2;
+    r->next = 0;
+    r->phase = 0;
+}
+
+void resampler_free(struct resampler *r){
+    free(r->bank);
+    free(r->hist);
+    free(r->out);
+    r->bank = r->hist = r->out = NULL;
+}
+
+int resampler_process(struct resampler *r, const Uint8 *p, int frames){
+    r->load(p, frames, r->channels, r->hist + r->avail, r->cap);
+    r->avail += frames;
+
+    // locals, so the loop does not go through `r` for every output frame
+    const int channels = r->channels, taps = r->taps, cap = r->cap;
+    const int up = r->up, step = r->step, rem = r->rem, avail = r->avail;
+    const float *bank = r->bank, *hist = r->hist;
+    const dot_fn dot = dot_impl;
+    float *out = r->out;
+    int next = r->next, phase = r->phase, n = 0;
+
+    while (next + taps <= avail) {
+        const float *c = bank + (size_t)phase * taps;
+        for (int ch = 0; ch < channels; ch++)
+            *out++ = dot(c, hist + ch * cap + next, taps);
+        n++;
+
+        // phase += down, carried into next without a division per frame
+        next += step;
+        phase += rem;
+        if (phase >= up) {
+            phase -= up;
+            next++;
+        }
+    }
+    r->next = next;
+    r->phase = phase;
+
+    // keep the input the next outputs still need at the front
+    const int drop = (r->next < r->avail) ? r->next : r->avail;
+    if (drop > 0) {
+        for (int ch = 0; ch < r->channels; ch++) {
+            float *h = r->hist + ch * r->cap;
+            SDL_memmove(h, h + drop, (size_t)(r->avail - drop) * sizeof *h);
+        }
+        r->avail -= drop;
+        r->next -= drop;
+    }
+    return n;
+}
+
+Uint64 resampler_in_frames(const struct resampler *r, Uint64 out_frames){
+    return (out_frames * (Uint64)r->down + (Uint64)r->up - 1) / (Uint64)r->up;
+}
+
+Uint64 resampler_out_frames(const struct resampler *r, Uint64 in_frames){
+    return in_frames * (Uint64)r->up / (Uint64)r->down;
+}
+
+int resample_quality_of(const char *name){
+    for (size_t q = 0; q < SDL_arraysize(profiles); q++)
+        if (SDL_strcmp(name, profiles[q].name) == 0)
+            return (int)q;
+    return -1;
+}
+
+const char *resample_quality_name(resample_quality quality){
+    return profiles[quality].name;
+}
+
+const char *resample_isa(void){
+    pthread_once(&dispatch_once, dispatch);
+    return isa;
+}
+
+int resample_kernels(struct resample_kernel out[RESAMPLE_MAX_KERNELS]){
+    int n = 0;
+    out[n++] = (struct resample_kernel){ "scalar", dot_scalar };
+#ifdef HAVE_X86_KERNELS
+    if (SDL_HasSSE2())
+        out[n++] = (struct resample_kernel){ "sse2", dot_sse2 };
+    if (SDL_HasAVX2())
+        out[n++] = (struct resample_kernel){ "avx2", dot_avx2 };
+#endif
+    return n;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// input frames converted per resampler_process call
+#define RESAMPLE_CHUNK 1024
+
+#define RESAMPLE_MAX_CHANNELS 8
+
+// largest up/down factor of the reduced rate ratio, e.g. 160/147 for 44.1 -> 48 kHz
+#define RESAMPLE_MAX_PHASES 1024
+
+typedef enum {
+    RESAMPLE_SDL = 0,   // no resampler: SDL_AudioStream converts the rate
+    RESAMPLE_FAST,
+    RESAMPLE_MEDIUM,
+    RESAMPLE_BEST
+} resample_quality;
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+// planar samples of `frames` interleaved frames at `p`, channel c at out[c * stride]
+typedef void (*resample_load_fn)(const Uint8 *p, int frames, int channels, float *out, int stride);
+
+/**
+ * resample_kernel
+ *
+ * One built-in implementation of the dot product every output sample is:
+ * - isa: its name, as resample_isa() reports it
+ * - dot: sum of a[i] * b[i] over `n`, a multiple of 8
+ */
+struct resample_kernel {
+    const char *isa;
+    float (*dot)(const float *a, const float *b, int n);
+};
+
+// scalar, SSE2 and AVX2
+#define RESAMPLE_MAX_KERNELS 3
+
+/*
+ * Largest difference allowed between a vector kernel's dot product and
+ * the scalar reference's, relative to the sum of |a[i] * b[i]|. The
+ * kernels add the same products in a different order (4 partial sums in
+ * scalar, 8 in the vectors), which moves the rounding by a few ulps of
+ * that sum.
+ */
+#define RESAMPLE_KERNEL_TOLERANCE 1e-6f
+
+/**
+ * resampler
+ *
+ * Streaming polyphase resampler from in_rate to out_rate = in_rate * up / down,
+ * with Kaiser-windowed sinc filters:
+ * - step, rem: down / up and down % up, how far `next` and `phase` move
+ *            per output frame
+ * - taps:    filter length per phase, a multiple of 8 (16, 32 or 64)
+ * - bank:    up phases of `taps` coefficients, stored in input order so each
+ *            output sample is one contiguous dot product
+ * - hist:    planar input, `cap` frames per channel; frames before `avail`
+ *            are valid, the next output starts at `next` with `phase`
+ * - out:     interleaved f32 output of the last resampler_process call
+ *
+ * Converting and resampling never allocate: everything is sized by
+ * resampler_init for RESAMPLE_CHUNK input frames per call.
+ */
+struct resampler {
+    int channels;
+    int in_rate;
+    int out_rate;
+    int up;
+    int down;
+    int step;
+    int rem;
+    int taps;
+    float *bank;
+    float *hist;
+    int cap;
+    int avail;
+    int next;
+    int phase;
+    float *out;
+    resample_load_fn load;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Set up `r` to take `channels` channels of `format` at `in_rate` and
+ * produce f32 at `out_rate`. Fails for qualities other than fast, medium
+ * and best, and for rate ratios or channel counts out of range; callers
+ * then leave the conversion to SDL.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int resampler_init(struct resampler *r, SDL_AudioFormat format, int channels,
+                   int in_rate, int out_rate, resample_quality quality);
+
+void resampler_free(struct resampler *r);
+
+// forget the input seen so far, so the next output starts from silence as after resampler_init
+void resampler_reset(struct resampler *r);
+
+/**
+ * Resample `frames` (at most RESAMPLE_CHUNK) input frames at `p`. The
+ * output continues seamlessly from the previous call, delayed by half a
+ * filter length.
+ *
+ * @return output frames now in r->out
+ */
+int resampler_process(struct resampler *r, const Uint8 *p, int frames);
+
+// input frames that yield about `out_frames` output frames
+Uint64 resampler_in_frames(const struct resampler *r, Uint64 out_frames);
+
+// output frames `in_frames` input frames are worth
+Uint64 resampler_out_frames(const struct resampler *r, Uint64 in_frames);
+
+// quality by name ("sdl", "fast", "medium", "best"), -1 if unknown
+int resample_quality_of(const char *name);
+
+const char *resample_quality_name(resample_quality quality);
+
+// name of the kernel the dot products dispatch to
+const char *resample_isa(void);
+
+/**
+ * Every kernel built in that this CPU can run, scalar first, so they can
+ * be checked against each other.
+ *
+ * @return how many were written to `out`
+ */
+int resample_kernels(struct resample_kernel out[RESAMPLE_MAX_KERNELS]);
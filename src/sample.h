@@ -0,0 +1,126 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+/**
+ * Sample loaders and storers for every SDL_AudioFormat, normalized to
+ * -1..1 (integer formats scale by 2^(bits-1) and round and saturate on
+ * store).
+ * They are static inline so that code instantiated per format with
+ * SAMPLE_FORMATS compiles down to a plain load or store (plus a byte swap
+ * for the other endianness) with no branching.
+ */
+
+// X(name, format): one entry per SDL_AudioFormat, `name` suffixes load_* and store_*
+#define SAMPLE_FORMATS(X)        \
+    X(u8,    SDL_AUDIO_U8)       \
+    X(s8,    SDL_AUDIO_S8)       \
+    X(s16le, SDL_AUDIO_S16LE)    \
+    X(s16be, SDL_AUDIO_S16BE)    \
+    X(s32le, SDL_AUDIO_S32LE)    \
+    X(s32be, SDL_AUDIO_S32BE)    \
+    X(f32le, SDL_AUDIO_F32LE)    \
+    X(f32be, SDL_AUDIO_F32BE)
+
+static inline Uint32 sample_le32(const Uint8 *p){
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static inline Uint32 sample_be32(const Uint8 *p){
+    return (Uint32)p[3] | ((Uint32)p[2] << 8) | ((Uint32)p[1] << 16) | ((Uint32)p[0] << 24);
+}
+
+static inline float sample_bits_to_float(Uint32 bits){
+    float f;
+    SDL_memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+static inline float load_u8(const Uint8 *p){
+    return ((int)p[0] - 128) * (1.0f / 128.0f);
+}
+
+static inline float load_s8(const Uint8 *p){
+    return (Sint8)p[0] * (1.0f / 128.0f);
+}
+
+static inline float load_s16le(const Uint8 *p){
+    return (Sint16)(p[0] | (p[1] << 8)) * (1.0f / 32768.0f);
+}
+
+static inline float load_s16be(const Uint8 *p){
+    return (Sint16)(p[1] | (p[0] << 8)) * (1.0f / 32768.0f);
+}
+
+static inline float load_s32le(const Uint8 *p){
+    return (Sint32)sample_le32(p) * (1.0f / 2147483648.0f);
+}
+
+static inline float load_s32be(const Uint8 *p){
+    return (Sint32)sample_be32(p) * (1.0f / 2147483648.0f);
+}
+
+static inline float load_f32le(const Uint8 *p){
+    return sample_bits_to_float(sample_le32(p));
+}
+
+static inline float load_f32be(const Uint8 *p){
+    return sample_bits_to_float(sample_be32(p));
+}
+
+static inline void sample_put_le32(Uint8 *p, Uint32 v){
+    p[0] = (Uint8)v; p[1] = (Uint8)(v >> 8); p[2] = (Uint8)(v >> 16); p[3] = (Uint8)(v >> 24);
+}
+
+static inline void sample_put_be32(Uint8 *p, Uint32 v){
+    p[3] = (Uint8)v; p[2] = (Uint8)(v >> 8); p[1] = (Uint8)(v >> 16); p[0] = (Uint8)(v >> 24);
+}
+
+static inline Uint32 sample_float_to_bits(float f){
+    Uint32 bits;
+    SDL_memcpy(&bits, &f, sizeof bits);
+    return bits;
+}
+
+// v scaled to a signed integer of `bits` bits, rounded and saturated
+static inline Sint32 sample_to_int(float v, int bits){
+    const double max = (double)((1u << (bits - 1)) - 1);
+    const double x = (double)v * (max + 1.0);
+    if (x >= max) return (Sint32)max;
+    if (x <= -max - 1.0) return (Sint32)(-max - 1.0);
+    return (Sint32)((x < 0.0) ? x - 0.5 : x + 0.5);
+}
+
+static inline void store_u8(Uint8 *p, float v){
+    p[0] = (Uint8)(sample_to_int(v, 8) + 128);
+}
+
+static inline void store_s8(Uint8 *p, float v){
+    p[0] = (Uint8)(Sint8)sample_to_int(v, 8);
+}
+
+static inline void store_s16le(Uint8 *p, float v){
+    const Uint16 s = (Uint16)sample_to_int(v, 16);
+    p[0] = (Uint8)s; p[1] = (Uint8)(s >> 8);
+}
+
+static inline void store_s16be(Uint8 *p, float v){
+    const Uint16 s = (Uint16)sample_to_int(v, 16);
+    p[1] = (Uint8)s; p[0] = (Uint8)(s >> 8);
+}
+
+static inline void store_s32le(Uint8 *p, float v){
+    sample_put_le32(p, (Uint32)sample_to_int(v, 32));
+}
+
+static inline void store_s32be(Uint8 *p, float v){
+    sample_put_be32(p, (Uint32)sample_to_int(v, 32));
+}
+
+static inline void store_f32le(Uint8 *p, float v){
+    sample_put_le32(p, sample_float_to_bits(v));
+}
+
+static inline void store_f32be(Uint8 *p, float v){
+    sample_put_be32(p, sample_float_to_bits(v));
+}
@@ -0,0 +1,175 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "spectrum.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// one analysis per display frame at 60 Hz
+#define SPECTRUM_PERIOD_NS (SDL_NS_PER_SECOND / 60)
+
+// the bands span SPECTRUM_MIN_HZ to Nyquist and SPECTRUM_FLOOR_DB to 0 dBFS
+#define SPECTRUM_MIN_HZ 30.0
+#define SPECTRUM_FLOOR_DB (-80.0f)
+
+// how far a band may drop per analysis, so peaks fall smoothly
+#define SPECTRUM_FALL 0.03f
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+// first FFT bin of every band, log-spaced, each band at least one bin wide
+static void layout_bands(struct spectrum *s, int freq){
+    const double nyquist = freq / 2.0;
+    const double bin_hz = (double)freq / SPECTRUM_FFT_SIZE;
+
+    int prev = 0;
+    for (int b = 0; b <= SPECTRUM_BANDS; b++) {
+        const double hz = SPECTRUM_MIN_HZ * pow(nyquist / SPECTRUM_MIN_HZ, (double)b / SPECTRUM_BANDS);
+        int bin = (int)(hz / bin_hz + 0.5);
+        if (b > 0 && bin <= prev) bin = prev + 1;
+        if (bin > SPECTRUM_FFT_SIZE / 2) bin = SPECTRUM_FFT_SIZE / 2;
+        s->edges[b] = prev = bin;
+    }
+    s->edges_freq = freq;
+}
+
+static void *spectrum_main(void *arg){
+    struct spectrum *s = arg;
+
+    while (!atomic_load_explicit(&s->stopping, memory_order_relaxed)) {
+        const Uint64 start_ns = SDL_GetTicksNS();
+        spectrum_update(s);
+
+        const Uint64 spent = SDL_GetTicksNS() - start_ns;
+        if (spent < SPECTRUM_PERIOD_NS)
+            SDL_DelayNS(SPECTRUM_PERIOD_NS - spent);
+    }
+    return NULL;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int spectrum_init(struct spectrum *s, struct metrics *metrics){
+    SDL_zerop(s);
+    s->metrics = metrics;
+    atomic_init(&s->tap.written, 0);
+    atomic_init(&s->freq, 0);
+    atomic_init(&s->seq, 0);
+    atomic_init(&s->stopping, 0);
+
+    if (fft_init(&s->fft, SPECTRUM_FFT_SIZE) < 0)
+        return -1;
+
+    s->window = malloc(SPECTRUM_FFT_SIZE * sizeof *s->window);
+    s->re = malloc(SPECTRUM_FFT_SIZE * sizeof *s->re);
+    s->im = malloc(SPECTRUM_FFT_SIZE * sizeof *s->im);
+    if (!s->window || !s->re || !s->im) {
+        spectrum_free(s);
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    // periodic Hann: a full-scale sine peaks at |X| = N/4
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++)
+        s->window[i] = (float)(0.5 - 0.5 * cos(2.0 * SDL_PI_D * i / SPECTRUM_FFT_SIZE));
+    return 0;
+}
+
+int spectrum_start(struct spectrum *s){
+    if (pthread_create(&s->thread, NULL, spectrum_main, s) != 0) {
+        SDL_SetError("cannot start spectrum thread");
+        return -1;
+    }
+    s->joinable = 1;
+    return 0;
+}
+
+void spectrum_free(struct spectrum *s){
+    if (s->joinable) {
+        atomic_store(&s->stopping, 1);
+        pthread_join(s->thread, NULL);
+        s->joinable = 0;
+    }
+
+    fft_free(&s->fft);
+    free(s->window);
+    free(s->re);
+    free(s->im);
+    s->window = s->re = s->im = NULL;
+}
+
+void spectrum_set_freq(struct spectrum *s, int freq){
+    atomic_store_explicit(&s->freq, freq, memory_order_relaxed);
+}
+
+int spectrum_update(struct spectrum *s){
+    const Uint64 written = atomic_load_explicit(&s->tap.written, memory_order_acquire);
+    const int freq = atomic_load_explicit(&s->freq, memory_order_relaxed);
+    if (written == s->last_written || freq <= 0)
+        return 0;
+    s->last_written = written;
+
+    const Uint64 start_ns = SDL_GetTicksNS();
+    if (freq != s->edges_freq)
+        layout_bands(s, freq);
+
+    // the newest window; frames before the first one tapped are silence
+    const Uint64 mask = SPECTRUM_TAP_FRAMES - 1;
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        const float v = (written + i >= SPECTRUM_FFT_SIZE)
+            ? s->tap.ring[(written + i - SPECTRUM_FFT_SIZE) & mask]
+            : 0.0f;
+        s->re[i] = v * s->window[i];
+        s->im[i] = 0.0f;
+    }
+
+    // the callback lapped the window while it was copied: skip this frame
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&s->tap.written, memory_order_relaxed) - written
+        > SPECTRUM_TAP_FRAMES - SPECTRUM_FFT_SIZE)
+        return 0;
+
+    fft_forward(&s->fft, s->re, s->im);
+
+    const float norm = 4.0f / SPECTRUM_FFT_SIZE;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        float peak = 0.0f;
+        for (int k = s->edges[b]; k < s->edges[b + 1]; k++) {
+            const float p = s->re[k] * s->re[k] + s->im[k] * s->im[k];
+            peak = (p > peak) ? p : peak;
+        }
+
+        const float db = 10.0f * log10f(peak * norm * norm + 1e-20f);
+        float level = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+        if (level < 0.0f) level = 0.0f;
+        if (level > 1.0f) level = 1.0f;
+
+        const float fallen = s->levels[b] - SPECTRUM_FALL;
+        s->levels[b] = (level > fallen) ? level : fallen;
+    }
+
+    // same sequence lock as the audio buffer's (track, pos) pair
+    atomic_fetch_add_explicit(&s->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    SDL_memcpy(s->bands, s->levels, sizeof s->bands);
+    atomic_fetch_add_explicit(&s->seq, 1, memory_order_release);
+
+    metrics_record(&s->metrics->fft, SDL_GetTicksNS() - start_ns);
+    return 1;
+}
+
+Uint32 spectrum_read(const struct spectrum *s, float out[SPECTRUM_BANDS]){
+    Uint32 seq;
+    do {
+        seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        SDL_memcpy(out, s->bands, sizeof s->bands);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&s->seq, memory_order_relaxed));
+    return seq;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <SDL3/SDL.h>
+
+#include "fft.h"
+#include "metrics.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// points per FFT, ~186 ms at 44.1 kHz
+#define SPECTRUM_FFT_SIZE 8192
+
+// mono frames the tap keeps, a power of two well above SPECTRUM_FFT_SIZE
+#define SPECTRUM_TAP_FRAMES 32768
+
+// log-spaced bands the UI draws
+#define SPECTRUM_BANDS 64
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * spectrum_tap
+ *
+ * Ring of the mono mix of what the audio callback hands to the stream.
+ * One writer (the callback), one reader (the analyzer), no locks:
+ * - ring:    frame f lives at ring[f % SPECTRUM_TAP_FRAMES]
+ * - written: frames written so far, published with release semantics
+ *            after the samples. A reader copies a window and then checks
+ *            that `written` has not moved far enough to overwrite it.
+ */
+struct spectrum_tap {
+    float ring[SPECTRUM_TAP_FRAMES];
+    _Atomic Uint64 written;
+};
+
+/**
+ * spectrum
+ *
+ * Live spectrum of the tap, computed on its own thread about once per
+ * display frame:
+ * - freq:      sample rate of the tapped stream, set by the UI
+ * - window:    Hann window; re, im: the FFT's work arrays
+ * - edges:     first FFT bin of every band, for `edges_freq`
+ * - levels:    the analyzer's smoothed band levels (0..1)
+ * - bands:     `levels` published for the UI under `seq`, odd while the
+ *              analyzer writes them
+ * - metrics:   the analyzer records its cost per FFT in metrics->fft
+ */
+struct spectrum {
+    struct spectrum_tap tap;
+    _Atomic int freq;
+    struct fft fft;
+    float *window;
+    float *re;
+    float *im;
+    int edges[SPECTRUM_BANDS + 1];
+    int edges_freq;
+    float levels[SPECTRUM_BANDS];
+    Uint64 last_written;
+    float bands[SPECTRUM_BANDS];
+    _Atomic Uint32 seq;
+    struct metrics *metrics;
+    pthread_t thread;
+    int joinable;
+    _Atomic int stopping;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Set up `s` with an empty tap. `metrics` must outlive it.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int spectrum_init(struct spectrum *s, struct metrics *metrics);
+
+/**
+ * Run spectrum_update about once per display frame on a thread of its own.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int spectrum_start(struct spectrum *s);
+
+// stop the analyzer thread if running and free the buffers; safe to call more than once
+void spectrum_free(struct spectrum *s);
+
+// sample rate of what is tapped from now on
+void spectrum_set_freq(struct spectrum *s, int freq);
+
+/**
+ * One analysis pass over the newest SPECTRUM_FFT_SIZE tapped frames,
+ * published to the UI. Only one thread may call it at a time.
+ *
+ * @return 1 if new bands were published, 0 if nothing new was tapped
+ */
+int spectrum_update(struct spectrum *s);
+
+/**
+ * Copy the latest bands (0..1, low to high frequencies) to `out`.
+ *
+ * @return a counter that changes whenever the analyzer publishes
+ */
+Uint32 spectrum_read(const struct spectrum *s, float out[SPECTRUM_BANDS]);
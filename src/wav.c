@@ -0,0 +1,317 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wav.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define RIFF_HEADER_SIZE 12
+#define CHUNK_HEADER_SIZE 8
+#define DS64_MIN_SIZE 28
+
+// RF64/BW64 put this in the 32-bit sizes that the ds64 chunk overrides
+#define RF64_SIZE_IN_DS64 0xFFFFFFFFu
+
+// Sony Wave64: RIFF with 16-byte GUIDs for ids and 64-bit sizes that
+// include the 24-byte chunk header, chunks aligned to 8 bytes
+#define W64_HEADER_SIZE 40
+#define W64_CHUNK_HEADER_SIZE 24
+#define FMT_CHUNK_MIN_SIZE 16
+#define FMT_EXTENSIBLE_SIZE 40
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// prefetch/release granularity used while playing
+#define ADVISE_WINDOW (4u << 20)
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static inline Uint16 read_le16(const Uint8 *p){
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+static inline Uint32 read_le32(const Uint8 *p){
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+// RIFX files are RIFF with every field, samples included, big-endian
+static inline Uint16 read16(const Uint8 *p, int big){
+    return big ? (Uint16)(p[1] | (p[0] << 8)) : read_le16(p);
+}
+
+static inline Uint32 read32(const Uint8 *p, int big){
+    return big
+        ? (Uint32)p[3] | ((Uint32)p[2] << 8) | ((Uint32)p[1] << 16) | ((Uint32)p[0] << 24)
+        : read_le32(p);
+}
+
+static inline Uint64 read_le64(const Uint8 *p){
+    return (Uint64)read_le32(p) | ((Uint64)read_le32(p + 4) << 32);
+}
+
+static const Uint8 w64_riff[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                    0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+static const Uint8 w64_wave[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11,
+                                    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const Uint8 w64_fmt[16]  = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11,
+                                    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const Uint8 w64_data[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11,
+                                    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+static void advise(struct wav_file *wav, Uint64 off, Uint64 len, int advice){
+    if (!wav->map || len == 0) return;
+
+    const Uint64 page = (Uint64)sysconf(_SC_PAGESIZE);
+    Uint64 start = (Uint64)(wav->data - (const Uint8 *)wav->map) + off;
+    Uint64 end = start + len;
+    if (end > wav->map_len) end = wav->map_len;
+    if (start >= end) return;
+
+    start -= start % page;
+    madvise((Uint8 *)wav->map + start, end - start, advice);
+}
+
+static int parse_fmt(const Uint8 *p, Uint32 size, int big, SDL_AudioSpec *spec){
+    if (size < FMT_CHUNK_MIN_SIZE) {
+        SDL_SetError("fmt chunk too short (%u bytes)", size);
+        return -1;
+    }
+
+    Uint16 tag = read16(p, big);
+    const Uint16 channels = read16(p + 2, big);
+    const Uint32 freq = read32(p + 4, big);
+    const Uint16 block_align = read16(p + 12, big);
+    const Uint16 bits = read16(p + 14, big);
+
+    if (tag == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < FMT_EXTENSIBLE_SIZE) {
+            SDL_SetError("WAVE_FORMAT_EXTENSIBLE fmt chunk too short");
+            return -1;
+        }
+        // the first two bytes of the SubFormat GUID carry the real tag
+        tag = read16(p + 24, big);
+    }
+
+    SDL_AudioFormat format = SDL_AUDIO_UNKNOWN;
+    if (tag == WAVE_FORMAT_PCM) {
+        switch (bits) {
+        case 8:  format = SDL_AUDIO_U8; break;
+        case 16: format = big ? SDL_AUDIO_S16BE : SDL_AUDIO_S16LE; break;
+        case 32: format = big ? SDL_AUDIO_S32BE : SDL_AUDIO_S32LE; break;
+        }
+    } else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32) {
+        format = big ? SDL_AUDIO_F32BE : SDL_AUDIO_F32LE;
+    }
+
+    if (format == SDL_AUDIO_UNKNOWN) {
+        SDL_SetError("unsupported WAVE encoding (tag 0x%04x, %u bits)", tag, bits);
+        return -1;
+    }
+
+    if (channels == 0 || freq == 0 || block_align != channels * (bits / 8)) {
+        SDL_SetError("inconsistent fmt chunk");
+        return -1;
+    }
+
+    spec->format = format;
+    spec->channels = channels;
+    spec->freq = (int)freq;
+    return 0;
+}
+
+// the PCM of a data chunk with `size` bytes at `body`
+static void set_data(struct wav_file *wav, const Uint8 *body, Uint64 size, Uint64 avail){
+    // recorders that were killed mid-capture leave a bogus size
+    Uint64 len = (size > avail) ? avail : size;
+    len -= len % SDL_AUDIO_FRAMESIZE(wav->spec);
+
+    wav->data = body;
+    wav->data_len = len;
+}
+
+/**
+ * RIFF and RIFX, and their 64-bit extensions RF64 (EBU Tech 3306) and
+ * BW64 (ITU-R BS.2088): those are RIFF whose 32-bit sizes may read
+ * RF64_SIZE_IN_DS64, in which case the real one is in the "ds64" chunk
+ * right after the header. Only the data chunk ever needs it in practice.
+ */
+static int parse_riff(struct wav_file *wav, const char *path){
+    const Uint8 *base = wav->map;
+    const Uint8 *end = base + wav->map_len;
+
+    const int big = SDL_memcmp(base, "RIFX", 4) == 0;
+    const int ds64 = SDL_memcmp(base, "RF64", 4) == 0 || SDL_memcmp(base, "BW64", 4) == 0;
+    if ((!big && !ds64 && SDL_memcmp(base, "RIFF", 4) != 0) || SDL_memcmp(base + 8, "WAVE", 4) != 0) {
+        SDL_SetError("%s is not a RIFF/WAVE file", path);
+        return -1;
+    }
+
+    int have_fmt = 0;
+    Uint64 data_size64 = 0;
+    const Uint8 *p = base + RIFF_HEADER_SIZE;
+    while (end - p >= CHUNK_HEADER_SIZE) {
+        const Uint32 size = read32(p + 4, big);
+        const Uint8 *body = p + CHUNK_HEADER_SIZE;
+        const Uint64 avail = (Uint64)(end - body);
+
+        if (ds64 && SDL_memcmp(p, "ds64", 4) == 0) {
+            if (size < DS64_MIN_SIZE || size > avail) {
+                SDL_SetError("truncated ds64 chunk");
+                return -1;
+            }
+            data_size64 = read_le64(body + 8);
+        } else if (SDL_memcmp(p, "fmt ", 4) == 0) {
+            if (size > avail) {
+                SDL_SetError("truncated fmt chunk");
+                return -1;
+            }
+            if (parse_fmt(body, size, big, &wav->spec) < 0)
+                return -1;
+            have_fmt = 1;
+        } else if (SDL_memcmp(p, "data", 4) == 0) {
+            if (!have_fmt) {
+                SDL_SetError("data chunk before fmt chunk");
+                return -1;
+            }
+            set_data(wav, body, (ds64 && size == RF64_SIZE_IN_DS64) ? data_size64 : size, avail);
+            return 0;
+        }
+
+        // chunks are word aligned
+        const Uint64 skip = (Uint64)size + (size & 1);
+        if (skip > avail)
+            break;
+        p = body + skip;
+    }
+
+    SDL_SetError("%s has no data chunk", path);
+    return -1;
+}
+
+// Sony Wave64, always little-endian
+static int parse_w64(struct wav_file *wav, const char *path){
+    const Uint8 *base = wav->map;
+    const Uint8 *end = base + wav->map_len;
+
+    if (SDL_memcmp(base + 24, w64_wave, 16) != 0) {
+        SDL_SetError("%s is not a Wave64 file", path);
+        return -1;
+    }
+
+    int have_fmt = 0;
+    const Uint8 *p = base + W64_HEADER_SIZE;
+    while (end - p >= W64_CHUNK_HEADER_SIZE) {
+        const Uint64 size = read_le64(p + 16);
+        const Uint8 *body = p + W64_CHUNK_HEADER_SIZE;
+        const Uint64 avail = (Uint64)(end - body);
+        if (size < W64_CHUNK_HEADER_SIZE) {
+            SDL_SetError("bad Wave64 chunk size");
+            return -1;
+        }
+        const Uint64 body_size = size - W64_CHUNK_HEADER_SIZE;
+
+        if (SDL_memcmp(p, w64_fmt, 16) == 0) {
+            if (body_size > avail || body_size > UINT32_MAX) {
+                SDL_SetError("truncated fmt chunk");
+                return -1;
+            }
+            if (parse_fmt(body, (Uint32)body_size, 0, &wav->spec) < 0)
+                return -1;
+            have_fmt = 1;
+        } else if (SDL_memcmp(p, w64_data, 16) == 0) {
+            if (!have_fmt) {
+                SDL_SetError("data chunk before fmt chunk");
+                return -1;
+            }
+            set_data(wav, body, body_size, avail);
+            return 0;
+        }
+
+        const Uint64 skip = (body_size + 7) & ~(Uint64)7;
+        if (skip > avail)
+            break;
+        p = body + skip;
+    }
+
+    SDL_SetError("%s has no data chunk", path);
+    return -1;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int wav_open(struct wav_file *wav, const char *path){
+    SDL_zerop(wav);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SDL_SetError("could not open %s", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < RIFF_HEADER_SIZE) {
+        close(fd);
+        SDL_SetError("%s is not a WAVE file", path);
+        return -1;
+    }
+    if ((Uint64)st.st_size > SIZE_MAX) {
+        close(fd);
+        SDL_SetError("%s is too large to map on this system", path);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        SDL_SetError("mmap %s failed", path);
+        return -1;
+    }
+
+    wav->map = map;
+    wav->map_len = (size_t)st.st_size;
+
+    const Uint8 *base = map;
+    const int rc = (wav->map_len >= W64_HEADER_SIZE && SDL_memcmp(base, w64_riff, 16) == 0)
+        ? parse_w64(wav, path) : parse_riff(wav, path);
+    if (rc < 0) {
+        wav_close(wav);
+        return -1;
+    }
+
+    advise(wav, 0, wav->data_len, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void wav_close(struct wav_file *wav){
+    if (wav->map)
+        munmap(wav->map, wav->map_len);
+    SDL_zerop(wav);
+}
+
+void wav_advise_playback(struct wav_file *wav, Uint64 pos){
+    const Uint64 window = pos / ADVISE_WINDOW;
+    if (wav->advised_window == window + 1)
+        return;
+    wav->advised_window = window + 1;
+
+    // everything behind the window before, not only the last one: after a
+    // seek, or a scan of the whole file, more than one window is resident
+    advise(wav, window * ADVISE_WINDOW, 2ull * ADVISE_WINDOW, MADV_WILLNEED);
+    if (window >= 2)
+        wav_release(wav, 0, (window - 1) * ADVISE_WINDOW);
+}
+
+void wav_release(struct wav_file *wav, Uint64 off, Uint64 len){
+    advise(wav, off, len, MADV_DONTNEED);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <SDL3/SDL.h>
+
+/**
+ * wav_file
+ *
+ * Read-only view of a WAVE file mapped into memory:
+ * - map, map_len:   the whole file as returned by mmap
+ * - data, data_len: PCM payload of the "data" chunk, pointing into the mapping
+ * - spec:           sample format described by the "fmt " chunk
+ * - advised_window: last playback window passed to madvise (+1, 0 = none)
+ *
+ * Nothing is copied: pages are faulted in by whoever reads `data`.
+ */
+struct wav_file {
+    void *map;
+    size_t map_len;
+    const Uint8 *data;
+    Uint64 data_len;
+    SDL_AudioSpec spec;
+    Uint64 advised_window;
+};
+
+/**
+ * Map `path` and locate its "fmt " and "data" chunks. Only the header is
+ * touched, so the cost does not depend on the file length. RIFF, big-endian
+ * RIFX, and the 64-bit RF64, BW64 and Sony Wave64 containers are accepted.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int wav_open(struct wav_file *wav, const char *path);
+
+void wav_close(struct wav_file *wav);
+
+/**
+ * Tell the kernel that playback is at byte `pos` of the data chunk: the
+ * window ahead is prefetched and the pages already played are dropped
+ * from our resident set. Cheap to call often; it only issues madvise()
+ * when `pos` crosses into a new window. That is still a syscall, so not
+ * from the audio callback, and from one thread per file.
+ */
+void wav_advise_playback(struct wav_file *wav, Uint64 pos);
+
+/* Drop [off, off + len) of the data chunk from the resident set. */
+void wav_release(struct wav_file *wav, Uint64 off, Uint64 len);
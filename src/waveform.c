@@ -0,0 +1,360 @@
+#include <math.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "kernels.h"
+#include "pool.h"
+#include "sample.h"
+#include "waveform.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// smallest amount of samples worth handing to another thread
+#define PARALLEL_GRAIN_SAMPLES (64 * 1024)
+
+// =============================================================================
+// Level-0 kernels
+// =============================================================================
+
+/*
+ * One kernel per sample format and channel layout (mono, stereo, any),
+ * instantiated from SAMPLE_FORMATS. The channel count and loader are
+ * compile-time constants in each instance, so the inner loop is fully
+ * specialized and carries no per-sample branching.
+ */
+typedef void (*summarize_fn)(const Uint8 *p, Uint64 frames, int channels,
+                             struct waveform_bin *out);
+
+static inline __attribute__((always_inline))
+void summarize_frames(const Uint8 *p, Uint64 frames, const int channels,
+                      float (*load)(const Uint8 *), const int size,
+                      struct waveform_bin *out){
+    float lo[WAVEFORM_MAX_CHANNELS], hi[WAVEFORM_MAX_CHANNELS], sq[WAVEFORM_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++)
+        lo[c] = hi[c] = sq[c] = 0.0f;
+
+    for (Uint64 i = 0; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            float v = load(p);
+            p += size;
+            lo[c] = (v < lo[c]) ? v : lo[c];
+            hi[c] = (v > hi[c]) ? v : hi[c];
+            sq[c] += v * v;
+        }
+    }
+
+    for (int c = 0; c < channels; c++) {
+        out[c].min = lo[c];
+        out[c].max = hi[c];
+        out[c].sumsq = sq[c];
+    }
+}
+
+#define DEFINE_SUMMARIZE(name, format)                                              \
+    static void summarize_##name##_mono(const Uint8 *p, Uint64 frames, int channels, \
+                                        struct waveform_bin *out){                  \
+        summarize_frames(p, frames, 1, load_##name, SDL_AUDIO_BYTESIZE(format), out); \
+    }                                                                               \
+    static void summarize_##name##_stereo(const Uint8 *p, Uint64 frames, int channels, \
+                                          struct waveform_bin *out){                \
+        summarize_frames(p, frames, 2, load_##name, SDL_AUDIO_BYTESIZE(format), out); \
+    }                                                                               \
+    static void summarize_##name##_multi(const Uint8 *p, Uint64 frames, int channels, \
+                                         struct waveform_bin *out){                 \
+        summarize_frames(p, frames, channels, load_##name, SDL_AUDIO_BYTESIZE(format), out); \
+    }
+
+SAMPLE_FORMATS(DEFINE_SUMMARIZE)
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+// native s16 goes through the exact integer kernels of kernels.c instead
+static void s16_bin(const struct s16_stats *st, struct waveform_bin *out){
+    out->min = st->min * (1.0f / 32768.0f);
+    out->max = st->max * (1.0f / 32768.0f);
+    out->sumsq = (float)((double)st->sumsq * (1.0 / (32768.0 * 32768.0)));
+}
+
+static void summarize_s16_simd_mono(const Uint8 *p, Uint64 frames, int channels,
+                                    struct waveform_bin *out){
+    struct s16_stats st;
+    s16_stats((const int16_t *)p, frames, &st);
+    s16_bin(&st, out);
+}
+
+static void summarize_s16_simd_stereo(const Uint8 *p, Uint64 frames, int channels,
+                                      struct waveform_bin *out){
+    struct s16_stats st[2];
+    s16_stats_stereo((const int16_t *)p, frames, st);
+    s16_bin(&st[0], &out[0]);
+    s16_bin(&st[1], &out[1]);
+}
+#endif
+
+static summarize_fn pick_summarize(SDL_AudioFormat format, int channels){
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    if (format == SDL_AUDIO_S16LE && channels == 1) return summarize_s16_simd_mono;
+    if (format == SDL_AUDIO_S16LE && channels == 2) return summarize_s16_simd_stereo;
+#endif
+
+#define PICK_SUMMARIZE(name, fmt)                          \
+    if (format == fmt) {                                   \
+        if (channels == 1) return summarize_##name##_mono;   \
+        if (channels == 2) return summarize_##name##_stereo; \
+        return summarize_##name##_multi;                   \
+    }
+    SAMPLE_FORMATS(PICK_SUMMARIZE)
+#undef PICK_SUMMARIZE
+
+    return NULL;
+}
+
+struct level0_job {
+    const Uint8 *buf;
+    Uint64 frames;
+    int channels;
+    int frame_size;
+    summarize_fn summarize;
+    Uint64 first_block;
+    struct waveform_bin *bins;
+};
+
+static void summarize_blocks(void *ctx, Uint64 begin, Uint64 end){
+    const struct level0_job *job = ctx;
+
+    for (Uint64 i = job->first_block + begin; i < job->first_block + end; i++) {
+        Uint64 first = i * WAVEFORM_BLOCK_FRAMES;
+        Uint64 count = job->frames - first;
+        if (count > WAVEFORM_BLOCK_FRAMES) count = WAVEFORM_BLOCK_FRAMES;
+        // buf starts at first_block
+        const Uint64 offset = (i - job->first_block) * WAVEFORM_BLOCK_FRAMES;
+        job->summarize(job->buf + offset * job->frame_size, count, job->channels,
+                       &job->bins[i * job->channels]);
+    }
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static inline struct waveform_bin merge_bins(struct waveform_bin a, struct waveform_bin b){
+    struct waveform_bin m;
+    m.min = (a.min < b.min) ? a.min : b.min;
+    m.max = (a.max > b.max) ? a.max : b.max;
+    m.sumsq = a.sumsq + b.sumsq;
+    return m;
+}
+
+struct window_job {
+    const int16_t *samples;
+    Uint64 window_samples;
+    float *out;
+};
+
+static void rms_windows(void *ctx, Uint64 begin, Uint64 end){
+    const struct window_job *job = ctx;
+
+    for (Uint64 i = begin; i < end; i++) {
+        struct s16_stats st;
+        s16_stats(job->samples + i * job->window_samples, job->window_samples, &st);
+
+        double mean = (double)st.sumsq / job->window_samples;
+        job->out[i] = (float)(sqrt(mean) / 32767.0);
+    }
+}
+
+static void peak_windows(void *ctx, Uint64 begin, Uint64 end){
+    const struct window_job *job = ctx;
+
+    for (Uint64 i = begin; i < end; i++) {
+        struct s16_stats st;
+        s16_stats(job->samples + i * job->window_samples, job->window_samples, &st);
+
+        int peak = (-st.min > st.max) ? -st.min : st.max;
+        job->out[i] = peak / 32767.0;
+    }
+}
+
+static float *run_windows(pool_fn fn, const int16_t *samples, int windows, int window_samples){
+    float *out = calloc(windows > 0 ? windows : 1, sizeof(float));
+    if (!out || windows <= 0 || window_samples <= 0)
+        return out;
+
+    struct window_job job = { samples, (Uint64)window_samples, out };
+    Uint64 grain = PARALLEL_GRAIN_SAMPLES / (Uint64)window_samples + 1;
+    pool_parallel_for((Uint64)windows, grain, fn, &job);
+    return out;
+}
+
+// bin i of level l for `channel`, or all channels merged when it is out of range
+static inline struct waveform_bin channel_bin(const struct waveform *wf, int l, Uint64 i, int channel){
+    const struct waveform_bin *bin = &wf->bins[l][i * wf->channels];
+    if (channel >= 0 && channel < wf->channels)
+        return bin[channel];
+
+    struct waveform_bin m = bin[0];
+    for (int c = 1; c < wf->channels; c++)
+        m = merge_bins(m, bin[c]);
+    return m;
+}
+
+static int alloc_level(struct waveform *wf, int level, Uint64 count){
+    wf->bins[level] = malloc(count * wf->channels * sizeof(struct waveform_bin));
+    if (!wf->bins[level]) {
+        SDL_SetError("out of memory for waveform level %d", level);
+        return -1;
+    }
+    wf->count[level] = count;
+    wf->levels = level + 1;
+    return 0;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+int waveform_init(struct waveform *wf, Uint64 len, const SDL_AudioSpec *spec){
+    SDL_zerop(wf);
+    atomic_init(&wf->ready, 0);
+
+    if (!pick_summarize(spec->format, spec->channels)) {
+        SDL_SetError("waveform: unsupported sample format 0x%04x", spec->format);
+        return -1;
+    }
+    if (spec->channels < 1 || spec->channels > WAVEFORM_MAX_CHANNELS) {
+        SDL_SetError("waveform: unsupported channel count %d", spec->channels);
+        return -1;
+    }
+
+    wf->channels = spec->channels;
+    wf->frames = len / SDL_AUDIO_FRAMESIZE(*spec);
+    if (wf->frames == 0)
+        return 0;
+
+    Uint64 count = (wf->frames + WAVEFORM_BLOCK_FRAMES - 1) / WAVEFORM_BLOCK_FRAMES;
+    for (int l = 0; l < WAVEFORM_MAX_LEVELS; l++) {
+        if (alloc_level(wf, l, count) < 0) {
+            waveform_free(wf);
+            return -1;
+        }
+        if (count == 1)
+            break;
+        count = (count + 1) / 2;
+    }
+    return 0;
+}
+
+void waveform_summarize(struct waveform *wf, const Uint8 *buf, const SDL_AudioSpec *spec,
+                        Uint64 begin, Uint64 end){
+    if (end > wf->count[0]) end = wf->count[0];
+    if (begin >= end) return;
+
+    const int channels = wf->channels;
+    const Uint64 done = end;
+    struct level0_job job = {
+        buf, wf->frames, channels, SDL_AUDIO_FRAMESIZE(*spec),
+        pick_summarize(spec->format, channels), begin, wf->bins[0]
+    };
+    Uint64 grain = PARALLEL_GRAIN_SAMPLES / ((Uint64)WAVEFORM_BLOCK_FRAMES * channels) + 1;
+    pool_parallel_for(end - begin, grain, summarize_blocks, &job);
+
+    // refresh every parent with a child in the range; parents that also
+    // cover blocks not summarized yet are redone by a later call
+    for (int l = 1; l < wf->levels; l++) {
+        const Uint64 below = wf->count[l - 1];
+        const struct waveform_bin *src = wf->bins[l - 1];
+        struct waveform_bin *dst = wf->bins[l];
+
+        begin >>= 1;
+        end = (end + 1) >> 1;
+        for (Uint64 i = begin; i < end; i++) {
+            for (int c = 0; c < channels; c++) {
+                const struct waveform_bin *a = &src[2 * i * channels + c];
+                dst[i * channels + c] = (2 * i + 1 < below) ? merge_bins(a[0], a[channels]) : a[0];
+            }
+        }
+    }
+
+    Uint64 ready = done * WAVEFORM_BLOCK_FRAMES;
+    if (ready > wf->frames) ready = wf->frames;
+    atomic_store_explicit(&wf->ready, ready, memory_order_release);
+}
+
+int waveform_build(struct waveform *wf, const Uint8 *buf, Uint64 len, const SDL_AudioSpec *spec){
+    if (waveform_init(wf, len, spec) < 0)
+        return -1;
+
+    waveform_summarize(wf, buf, spec, 0, wf->count[0]);
+    return 0;
+}
+
+void waveform_free(struct waveform *wf){
+    if (wf->map) {
+        munmap(wf->map, wf->map_len);
+    } else {
+        for (int l = 0; l < wf->levels; l++)
+            free(wf->bins[l]);
+    }
+    SDL_zerop(wf);
+}
+
+int waveform_query(const struct waveform *wf, int channel, Uint64 start, Uint64 end, int bars,
+                   float *rms, float *peaks){
+    const int mixed = (channel < 0 || channel >= wf->channels) ? wf->channels : 1;
+
+    const Uint64 ready = atomic_load_explicit(&wf->ready, memory_order_acquire);
+    if (end > wf->frames) end = wf->frames;
+    if (start > end) start = end;
+
+    int ready_bars = 0;
+    for (int b = 0; b < bars; b++) {
+        float r = 0.0f, p = 0.0f;
+
+        Uint64 b0 = start + (end - start) * b / bars;
+        Uint64 b1 = start + (end - start) * (b + 1) / bars;
+        if (b1 <= b0) b1 = b0 + 1;
+
+        if (wf->levels > 0 && start < end && b1 <= ready) {
+            ready_bars = b + 1;
+
+            // level-0 blocks of the bar; rounding both ends down keeps
+            // neighbouring bars from sharing a block
+            Uint64 i0 = b0 / WAVEFORM_BLOCK_FRAMES;
+            Uint64 i1 = b1 / WAVEFORM_BLOCK_FRAMES;
+            if (i1 <= i0) i1 = i0 + 1;
+            if (i1 > wf->count[0]) i1 = wf->count[0];
+
+            Uint64 covered_end = i1 * WAVEFORM_BLOCK_FRAMES;
+            if (covered_end > wf->frames) covered_end = wf->frames;
+            const Uint64 covered = covered_end - i0 * WAVEFORM_BLOCK_FRAMES;
+
+            // cover [i0, i1) with the fewest bins, climbing a level per step
+            // bins always include 0 in their range, so this is the identity
+            struct waveform_bin m = {0.0f, 0.0f, 0.0f};
+            for (int l = 0; l < wf->levels && i0 < i1; l++) {
+                if (i0 & 1)
+                    m = merge_bins(m, channel_bin(wf, l, i0++, channel));
+                if (i1 & 1)
+                    m = merge_bins(m, channel_bin(wf, l, --i1, channel));
+                i0 >>= 1;
+                i1 >>= 1;
+            }
+
+            r = sqrtf(m.sumsq / (float)(covered * mixed));
+            p = (-m.min > m.max) ? -m.min : m.max;
+        }
+
+        if (rms) rms[b] = r;
+        if (peaks) peaks[b] = p;
+    }
+    return ready_bars;
+}
+
+float *calculate_rms(const int16_t *samples, int windows, int window_samples) {
+    return run_windows(rms_windows, samples, windows, window_samples);
+}
+
+float *calculate_peaks(const int16_t *samples, int windows, int window_samples){
+    return run_windows(peak_windows, samples, windows, window_samples);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <SDL3/SDL.h>
+
+#include "loudness.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+// frames summarized by one level-0 bin
+#define WAVEFORM_BLOCK_FRAMES 256
+#define WAVEFORM_MAX_LEVELS 32
+#define WAVEFORM_MAX_CHANNELS 16
+
+// =============================================================================
+// Structs
+// =============================================================================
+
+/**
+ * waveform_bin
+ *
+ * Summary of one channel over a run of frames, samples normalized to -1..1:
+ * - min, max: extremes of the run
+ * - sumsq:    sum of squared samples, so sumsq / frames is the mean power
+ */
+struct waveform_bin {
+    float min;
+    float max;
+    float sumsq;
+};
+
+/**
+ * waveform
+ *
+ * Mipmapped summary of a track. Level 0 holds one bin per
+ * WAVEFORM_BLOCK_FRAMES frames, every level above halves the bin count by
+ * merging pairs from the level below, so a bin of level k covers
+ * WAVEFORM_BLOCK_FRAMES << k frames. The last bin of a level may be partial.
+ * Every bin exists once per channel, channel-interleaved: bin i of channel
+ * c in level l is bins[l][i * channels + c].
+ *
+ * `ready` counts the leading frames whose bins are final in every level;
+ * it only grows while the summary is being built and is published with
+ * release semantics, so readers on other threads may query that prefix.
+ *
+ * When loaded from the cache, the bins point into a read-only mapping of
+ * the cache file (map, map_len) instead of owning their memory.
+ *
+ * `loudness` is measured by the analysis in the same pass as the bins and
+ * cached with them; it is only meaningful once the summary is complete.
+ */
+struct waveform {
+    Uint64 frames;
+    _Atomic Uint64 ready;
+    int channels;
+    int levels;
+    Uint64 count[WAVEFORM_MAX_LEVELS];
+    struct waveform_bin *bins[WAVEFORM_MAX_LEVELS];
+    void *map;
+    size_t map_len;
+    struct loudness_result loudness;
+};
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Allocate every level for `len` bytes of PCM described by `spec`, with
+ * nothing summarized yet (ready == 0). Any SDL_AudioFormat is accepted,
+ * with up to WAVEFORM_MAX_CHANNELS channels.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int waveform_init(struct waveform *wf, Uint64 len, const SDL_AudioSpec *spec);
+
+/**
+ * Summarize level-0 blocks [begin, end), whose frames start at `buf`,
+ * and refresh the levels above them, then publish `ready` up to `end`.
+ * Ranges must be handed in order, starting at block 0, so the track may
+ * come in pieces (e.g. from a decoder) as well as all at once.
+ */
+void waveform_summarize(struct waveform *wf, const Uint8 *buf, const SDL_AudioSpec *spec,
+                        Uint64 begin, Uint64 end);
+
+/**
+ * waveform_init + waveform_summarize over the whole buffer. This is the
+ * only pass over the samples; everything else is answered from the bins.
+ *
+ * @return 0 on success, -1 on failure (see SDL_GetError)
+ */
+int waveform_build(struct waveform *wf, const Uint8 *buf, Uint64 len, const SDL_AudioSpec *spec);
+
+void waveform_free(struct waveform *wf);
+
+/**
+ * Split frames [start, end) of `channel` into `bars` equal ranges and write
+ * the RMS and peak level (0..1) of each into `rms` / `peaks`; either may be
+ * NULL. A negative `channel` merges all channels. Each bar merges at most
+ * two bins per level, whatever the range length.
+ *
+ * @return number of leading bars that are fully summarized; the others
+ *         are written as 0
+ */
+int waveform_query(const struct waveform *wf, int channel, Uint64 start, Uint64 end, int bars,
+                   float *rms, float *peaks);
+
+/**
+ * Per-window peak / RMS level (0..1) of `windows` consecutive runs of
+ * `window_samples` samples. Windows are spread over the thread pool and
+ * each one goes through the s16_stats kernel.
+ *
+ * Tolerance: the kernels sum squares exactly in 64-bit integers, so the
+ * result is bit-identical to the scalar double-precision reference as long
+ * as a window holds fewer than 2^23 samples (where the reference's double
+ * accumulator is still exact). Past that the reference is the one that
+ * rounds; the two differ by less than 1e-15 relative.
+ *
+ * @return calloc'd array of `windows` floats, owned by the caller
+ */
+float *calculate_peaks(const int16_t *samples, int windows, int window_samples);
+float *calculate_rms(const int16_t *samples, int windows, int window_samples);